@@ -0,0 +1,217 @@
+#include "ActionMacro.h"
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QFile>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr char ActionMagic[8] = { 'C', 'R', 'A', 'C', 'T', 'N', '\0', '\0' };
+constexpr uint32_t ActionVersion = 1;
+
+struct ActionFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+};
+
+// Fixed part of a record; textLength UTF-16 units follow it.
+struct ActionRecordHeader {
+    uint32_t deltaUs;
+    uint8_t action;
+    uint8_t reserved;
+    uint16_t textLength;
+    int32_t argument;
+};
+static_assert(sizeof(ActionRecordHeader) == 12, "ActionRecordHeader is a fixed-size on-disk record");
+
+qint64 percentile(const std::vector<qint64>& sorted, double fraction) {
+    if (sorted.empty()) return 0;
+    const size_t index = static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+QString formatMicros(qint64 ns) {
+    return QString::number(static_cast<double>(ns) / 1000.0, 'f', 1);
+}
+
+}
+
+const char* macroActionName(MacroAction action) {
+    switch (action) {
+    case MacroAction::Numpad: return "numpad";
+    case MacroAction::Enter: return "enter";
+    case MacroAction::Clear: return "clear";
+    case MacroAction::DeleteItem: return "delete";
+    case MacroAction::Approve: return "approve";
+    case MacroAction::Decline: return "decline";
+    case MacroAction::SelectRow: return "select";
+    case MacroAction::Undo: return "undo";
+    case MacroAction::Redo: return "redo";
+    case MacroAction::Suspend: return "suspend";
+    case MacroAction::Resume: return "resume";
+    }
+    return "unknown";
+}
+
+bool ActionRecorder::start(const QString& filePath) {
+    if (m_recording) return false;
+    m_filePath = filePath;
+    m_records.clear();
+    m_lastUs = 0;
+    m_clock.start();
+    m_recording = true;
+    return true;
+}
+
+void ActionRecorder::record(MacroAction action, int32_t argument, const QString& text) {
+    if (!m_recording) return;
+
+    const qint64 nowUs = m_clock.nsecsElapsed() / 1000;
+    ActionRecord record;
+    record.deltaUs = static_cast<uint32_t>(std::min<qint64>(nowUs - m_lastUs, UINT32_MAX));
+    record.action = action;
+    record.argument = argument;
+    record.text = text.left(UINT16_MAX);
+    m_records.push_back(std::move(record));
+    m_lastUs = nowUs;
+}
+
+bool ActionRecorder::stop() {
+    if (!m_recording) return false;
+    m_recording = false;
+    const bool saved = saveActionMacro(m_filePath, m_records);
+    m_records.clear();
+    return saved;
+}
+
+bool saveActionMacro(const QString& filePath, const std::vector<ActionRecord>& records) {
+    QByteArray data;
+    ActionFileHeader header{};
+    std::memcpy(header.magic, ActionMagic, sizeof(ActionMagic));
+    header.version = ActionVersion;
+    header.count = static_cast<uint32_t>(records.size());
+    data.append(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    for (const ActionRecord& record : records) {
+        ActionRecordHeader fixed{};
+        fixed.deltaUs = record.deltaUs;
+        fixed.action = static_cast<uint8_t>(record.action);
+        fixed.textLength = static_cast<uint16_t>(record.text.size());
+        fixed.argument = record.argument;
+        data.append(reinterpret_cast<const char*>(&fixed), sizeof(fixed));
+        data.append(reinterpret_cast<const char*>(record.text.utf16()), fixed.textLength * sizeof(char16_t));
+    }
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+    return file.write(data) == data.size();
+}
+
+bool loadActionMacro(const QString& filePath, std::vector<ActionRecord>& records) {
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    const QByteArray data = file.readAll();
+
+    ActionFileHeader header{};
+    if (static_cast<size_t>(data.size()) < sizeof(header)) return false;
+    std::memcpy(&header, data.constData(), sizeof(header));
+    if (std::memcmp(header.magic, ActionMagic, sizeof(ActionMagic)) != 0 || header.version != ActionVersion) {
+        return false;
+    }
+
+    records.clear();
+    records.reserve(header.count);
+    size_t offset = sizeof(header);
+    const size_t size = static_cast<size_t>(data.size());
+    for (uint32_t i = 0; i < header.count; ++i) {
+        ActionRecordHeader fixed{};
+        if (size - offset < sizeof(fixed)) return false;
+        std::memcpy(&fixed, data.constData() + offset, sizeof(fixed));
+        offset += sizeof(fixed);
+
+        const size_t textBytes = fixed.textLength * sizeof(char16_t);
+        if (size - offset < textBytes || fixed.action >= MacroActionCount) return false;
+
+        ActionRecord record;
+        record.deltaUs = fixed.deltaUs;
+        record.action = static_cast<MacroAction>(fixed.action);
+        record.argument = fixed.argument;
+        if (fixed.textLength > 0) {
+            std::vector<char16_t> text(fixed.textLength);
+            std::memcpy(text.data(), data.constData() + offset, textBytes);
+            record.text = QString::fromUtf16(text.data(), fixed.textLength);
+        }
+        offset += textBytes;
+        records.push_back(std::move(record));
+    }
+    return true;
+}
+
+void ActionReplayReport::addSample(MacroAction action, qint64 ns) {
+    m_samples[static_cast<size_t>(action)].push_back(ns);
+}
+
+void ActionReplayReport::merge(const ActionReplayReport& other) {
+    for (size_t i = 0; i < m_samples.size(); ++i) {
+        m_samples[i].insert(m_samples[i].end(), other.m_samples[i].begin(), other.m_samples[i].end());
+    }
+}
+
+size_t ActionReplayReport::totalActions() const {
+    size_t total = 0;
+    for (const std::vector<qint64>& samples : m_samples) total += samples.size();
+    return total;
+}
+
+QString ActionReplayReport::toText() const {
+    const size_t total = totalActions();
+    const double seconds = static_cast<double>(m_elapsedNs) / 1e9;
+
+    QString text = QString("actions: %1, elapsed: %2 s, throughput: %3 actions/s\n")
+        .arg(static_cast<qulonglong>(total))
+        .arg(seconds, 0, 'f', 3)
+        .arg(seconds > 0 ? static_cast<double>(total) / seconds : 0.0, 0, 'f', 0);
+    text += QString("%1 %2 %3 %4 %5 %6\n")
+        .arg("action", -8).arg("count", 10).arg("mean us", 10)
+        .arg("p50 us", 10).arg("p99 us", 10).arg("max us", 10);
+
+    for (int i = 0; i < MacroActionCount; ++i) {
+        std::vector<qint64> sorted = m_samples[static_cast<size_t>(i)];
+        if (sorted.empty()) continue;
+        std::sort(sorted.begin(), sorted.end());
+
+        qint64 sum = 0;
+        for (qint64 ns : sorted) sum += ns;
+
+        text += QString("%1 %2 %3 %4 %5 %6\n")
+            .arg(macroActionName(static_cast<MacroAction>(i)), -8)
+            .arg(static_cast<qulonglong>(sorted.size()), 10)
+            .arg(formatMicros(sum / static_cast<qint64>(sorted.size())), 10)
+            .arg(formatMicros(percentile(sorted, 0.50)), 10)
+            .arg(formatMicros(percentile(sorted, 0.99)), 10)
+            .arg(formatMicros(sorted.back()), 10);
+    }
+    return text;
+}
+
+ActionReplayReport replayActions(const std::vector<ActionRecord>& records, int repeat,
+                                 const std::function<void(const ActionRecord&)>& apply) {
+    ActionReplayReport report;
+    QElapsedTimer total;
+    QElapsedTimer action;
+    total.start();
+
+    for (int pass = 0; pass < repeat; ++pass) {
+        for (const ActionRecord& record : records) {
+            action.start();
+            apply(record);
+            QCoreApplication::processEvents();
+            report.addSample(record.action, action.nsecsElapsed());
+        }
+    }
+
+    report.setElapsed(total.nsecsElapsed());
+    return report;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QString>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Application-level operations. Unlike raw evdev macros these replay straight
+// into the window, so they need neither root, uinput nor a real display.
+enum class MacroAction : uint8_t {
+    Numpad,
+    Enter,
+    Clear,
+    DeleteItem,
+    Approve,
+    Decline,
+    SelectRow,
+    Undo,
+    Redo,
+    Suspend,
+    Resume
+};
+
+constexpr int MacroActionCount = static_cast<int>(MacroAction::Resume) + 1;
+
+// argument is the numpad id, the selected row (-1 clears the selection) or
+// the position of the suspended receipt to resume;
+// text is the line edit contents at Enter, so typed input replays too.
+struct ActionRecord {
+    uint32_t deltaUs = 0;
+    MacroAction action = MacroAction::Numpad;
+    int32_t argument = 0;
+    QString text;
+};
+
+class ActionRecorder {
+public:
+    bool start(const QString& filePath);
+    void record(MacroAction action, int32_t argument = 0, const QString& text = QString());
+    bool stop();
+
+    [[nodiscard]] bool isRecording() const { return m_recording; }
+
+private:
+    QString m_filePath;
+    QElapsedTimer m_clock;
+    qint64 m_lastUs = 0;
+    std::vector<ActionRecord> m_records;
+    bool m_recording = false;
+};
+
+bool saveActionMacro(const QString& filePath, const std::vector<ActionRecord>& records);
+bool loadActionMacro(const QString& filePath, std::vector<ActionRecord>& records);
+
+// Per-action latency samples and overall throughput of a headless replay.
+class ActionReplayReport {
+public:
+    void addSample(MacroAction action, qint64 ns);
+    void setElapsed(qint64 ns) { m_elapsedNs = ns; }
+
+    // Adds other's samples; the elapsed time stays this report's.
+    void merge(const ActionReplayReport& other);
+
+    [[nodiscard]] size_t totalActions() const;
+    [[nodiscard]] QString toText() const;
+
+private:
+    std::array<std::vector<qint64>, MacroActionCount> m_samples;
+    qint64 m_elapsedNs = 0;
+};
+
+// Applies the recorded actions back to back, ignoring recorded delays, and
+// drains posted events after each one so deferred UI work is measured too.
+ActionReplayReport replayActions(const std::vector<ActionRecord>& records, int repeat,
+                                 const std::function<void(const ActionRecord&)>& apply);
+
+const char* macroActionName(MacroAction action);
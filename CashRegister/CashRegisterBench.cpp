@@ -0,0 +1,766 @@
+#include "CashRegisterWindow.h"
+#include "ActionMacro.h"
+#include "LaneHost.h"
+#include "LatencyMonitor.h"
+#include "MacroFile.h"
+#include "MoneyKernels.h"
+#include "ProductSearch.h"
+#include "PromotionEngine.h"
+#include "ReceiptItemDelegate.h"
+#include "ReceiptTableModel.h"
+#include "money.h"
+#include <QtWidgets/QApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QScrollBar>
+#include <QStringList>
+#include <QTableView>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <vector>
+
+// Micro and macro benchmarks for the register.
+//
+//   CashRegisterBench [--filter text] [--min-time ms] [--json out.json]
+//                     [--baseline old.json] [--threshold percent]
+//
+// Results are printed as a table and, with --json, saved in a format that a
+// later run can take as --baseline. A benchmark that got slower than the
+// baseline by more than the threshold makes the process exit with code 1.
+
+namespace {
+
+volatile int64_t g_sink = 0;
+
+struct BenchResult {
+    QString name;
+    double nsPerOp = 0.0;
+    qint64 iterations = 0;
+};
+
+struct BenchOptions {
+    QString filter;
+    qint64 minTimeNs = 200 * 1000000LL;
+    int samples = 5;
+};
+
+class BenchRunner {
+public:
+    explicit BenchRunner(const BenchOptions& options) : m_options(options) {}
+
+    // fn runs one iteration and returns how many operations it performed;
+    // the reported figure is the median ns/op over several timed samples.
+    // Lets a benchmark skip expensive set-up that --filter would discard.
+    [[nodiscard]] bool wants(const QString& name) const {
+        return m_options.filter.isEmpty() || name.contains(m_options.filter);
+    }
+
+    void run(const QString& name, const std::function<qint64()>& fn) {
+        if (!wants(name)) return;
+
+        qint64 iterations = 1;
+        QElapsedTimer timer;
+        for (;;) {
+            timer.start();
+            for (qint64 i = 0; i < iterations; ++i) fn();
+            const qint64 elapsed = timer.nsecsElapsed();
+            if (elapsed >= m_options.minTimeNs / m_options.samples || iterations >= (qint64(1) << 30)) break;
+            iterations *= elapsed > 0 ? std::clamp<qint64>(m_options.minTimeNs / m_options.samples / elapsed + 1, 2, 10) : 10;
+        }
+
+        std::vector<double> perOp;
+        for (int s = 0; s < m_options.samples; ++s) {
+            qint64 ops = 0;
+            timer.start();
+            for (qint64 i = 0; i < iterations; ++i) ops += fn();
+            perOp.push_back(static_cast<double>(timer.nsecsElapsed()) / static_cast<double>(std::max<qint64>(ops, 1)));
+        }
+        std::sort(perOp.begin(), perOp.end());
+
+        BenchResult result;
+        result.name = name;
+        result.nsPerOp = perOp[perOp.size() / 2];
+        result.iterations = iterations;
+        m_results.push_back(result);
+
+        QTextStream(stdout) << QString("%1 %2 ns/op\n").arg(name, -48).arg(result.nsPerOp, 12, 'f', 1);
+    }
+
+    [[nodiscard]] const std::vector<BenchResult>& results() const { return m_results; }
+
+private:
+    BenchOptions m_options;
+    std::vector<BenchResult> m_results;
+};
+
+QJsonDocument toJson(const std::vector<BenchResult>& results) {
+    QJsonArray benchmarks;
+    for (const BenchResult& result : results) {
+        QJsonObject entry;
+        entry["name"] = result.name;
+        entry["ns_per_op"] = result.nsPerOp;
+        entry["iterations"] = static_cast<double>(result.iterations);
+        benchmarks.append(entry);
+    }
+    QJsonObject root;
+    root["qt_version"] = QString(qVersion());
+    root["benchmarks"] = benchmarks;
+    return QJsonDocument(root);
+}
+
+// Prints the relative change per benchmark; returns false on any regression
+// beyond thresholdPercent.
+bool compareWithBaseline(const std::vector<BenchResult>& results, const QString& path, double thresholdPercent) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        QTextStream(stderr) << "Cannot read baseline " << path << "\n";
+        return false;
+    }
+
+    std::map<QString, double> baseline;
+    const QJsonArray benchmarks = QJsonDocument::fromJson(file.readAll()).object().value("benchmarks").toArray();
+    for (const QJsonValue& value : benchmarks) {
+        const QJsonObject entry = value.toObject();
+        baseline[entry.value("name").toString()] = entry.value("ns_per_op").toDouble();
+    }
+
+    bool ok = true;
+    QTextStream out(stdout);
+    out << "\nComparison with " << path << " (threshold " << thresholdPercent << "%)\n";
+    for (const BenchResult& result : results) {
+        const auto it = baseline.find(result.name);
+        if (it == baseline.end() || it->second <= 0.0) continue;
+
+        const double change = (result.nsPerOp - it->second) / it->second * 100.0;
+        const bool regressed = change > thresholdPercent;
+        ok = ok && !regressed;
+        out << QString("%1 %2 -> %3 ns/op %4%5%")
+            .arg(result.name, -48)
+            .arg(it->second, 12, 'f', 1)
+            .arg(result.nsPerOp, 12, 'f', 1)
+            .arg(change >= 0 ? "+" : "")
+            .arg(change, 0, 'f', 1)
+            << (regressed ? "  REGRESSION\n" : "\n");
+    }
+    return ok;
+}
+
+std::vector<ReceiptItem> makeItems(int count) {
+    std::vector<ReceiptItem> items;
+    items.reserve(static_cast<size_t>(count));
+    for (int i = 0; i < count; ++i) {
+        items.emplace_back(QString("Товар %1").arg(i), Money(1000 + (i % 977) * 13), 1 + i % 5);
+    }
+    return items;
+}
+
+void benchMoney(BenchRunner& runner) {
+    const Money a(123456);
+    const Money b(789);
+
+    runner.run("money/add", [&]() {
+        Money sum;
+        for (int i = 0; i < 1000; ++i) sum += a + b;
+        g_sink = g_sink + sum.amount();
+        return qint64(1000);
+    });
+
+    runner.run("money/multiply", [&]() {
+        int64_t total = 0;
+        for (int i = 1; i <= 1000; ++i) total += (a * i).amount();
+        g_sink = g_sink + total;
+        return qint64(1000);
+    });
+
+    runner.run("money/mulDiv", [&]() {
+        int64_t total = 0;
+        for (int grams = 1; grams <= 1000; ++grams) total += a.mulDiv(grams, 1000).amount();
+        g_sink = g_sink + total;
+        return qint64(1000);
+    });
+
+    runner.run("money/compare", [&]() {
+        int64_t less = 0;
+        for (int i = 0; i < 1000; ++i) less += Money(i) < b;
+        g_sink = g_sink + less;
+        return qint64(1000);
+    });
+
+    runner.run("money/toString", [&]() {
+        g_sink = g_sink + Money(g_sink & 0xFFFFFF).toString().size();
+        return qint64(1);
+    });
+
+    char16_t buffer[Money::MaxFormattedLength];
+    const MoneyFormat format;
+    runner.run("money/format", [&]() {
+        g_sink = g_sink + Money(g_sink & 0xFFFFFF).format(buffer, Money::MaxFormattedLength, format);
+        return qint64(1);
+    });
+
+    const QString text = "12345.67";
+    runner.run("money/fromString", [&]() {
+        g_sink = g_sink + Money::fromString(text).amount();
+        return qint64(1);
+    });
+
+    QByteArray column;
+    for (int i = 0; i < 10000; ++i) column += QByteArray::number(i) + "." + QByteArray::number(i % 100) + "\n";
+    std::vector<Money> parsed;
+    runner.run("money/parseColumn", [&]() {
+        parsed.clear();
+        Money::parseColumn(column.constData(), static_cast<size_t>(column.size()), parsed);
+        g_sink = g_sink + static_cast<int64_t>(parsed.size());
+        return qint64(10000);
+    });
+}
+
+void benchKernels(BenchRunner& runner) {
+    constexpr int Count = 100000;
+    std::vector<int64_t> prices(Count);
+    std::vector<int32_t> quantities(Count);
+    std::vector<uint32_t> keys(Count);
+    for (int i = 0; i < Count; ++i) {
+        prices[static_cast<size_t>(i)] = 1000 + (i % 977) * 13;
+        quantities[static_cast<size_t>(i)] = 1 + i % 5;
+        keys[static_cast<size_t>(i)] = static_cast<uint32_t>(i % 24);
+    }
+
+    QTextStream(stdout) << "kernels use " << MoneyKernels::activeInstructionSet() << "\n";
+
+    runner.run("kernels/sum/100000", [&]() {
+        int64_t total = 0;
+        MoneyKernels::sum(prices.data(), prices.size(), total);
+        g_sink = g_sink + total;
+        return qint64(Count);
+    });
+
+    runner.run("kernels/dot/100000", [&]() {
+        int64_t total = 0;
+        MoneyKernels::dot(prices.data(), quantities.data(), prices.size(), total);
+        g_sink = g_sink + total;
+        return qint64(Count);
+    });
+
+    runner.run("kernels/minMax/100000", [&]() {
+        int64_t min = 0;
+        int64_t max = 0;
+        MoneyKernels::minMax(prices.data(), prices.size(), min, max);
+        g_sink = g_sink + max - min;
+        return qint64(Count);
+    });
+
+    runner.run("kernels/groupedSum/100000", [&]() {
+        int64_t sums[24] = {};
+        MoneyKernels::groupedSum(prices.data(), keys.data(), prices.size(), sums, 24);
+        g_sink = g_sink + sums[0];
+        return qint64(Count);
+    });
+}
+
+// 1000 barcoded products in 20 categories under 500 multi-buy, 20 category and
+// 5 threshold rules; each scan should touch only its product's rules.
+void benchPromotions(BenchRunner& runner) {
+    constexpr int Products = 1000;
+    PromotionEngine promotions;
+    std::vector<ReceiptItem> items;
+    for (int i = 0; i < Products; ++i) {
+        const uint64_t barcode = 4820000000000ULL + static_cast<uint64_t>(i);
+        items.emplace_back(QString("Товар %1").arg(i), Money(1000 + (i % 977) * 13), 1, barcode);
+        promotions.setCategory(barcode, static_cast<uint32_t>(i % 20));
+        if (i % 2 == 0) {
+            PromotionRule rule;
+            rule.kind = PromotionKind::MultiBuy;
+            rule.name = QString("3 за ціною 2 #%1").arg(i);
+            rule.products = { barcode };
+            rule.bundleSize = 3;
+            rule.bundlePrice = items.back().price() * 2;
+            promotions.addRule(rule);
+        }
+    }
+    for (uint32_t category = 0; category < 20; ++category) {
+        PromotionRule rule;
+        rule.kind = PromotionKind::CategoryPercent;
+        rule.category = category;
+        rule.percentBp = 500;
+        promotions.addRule(rule);
+    }
+    for (int tier = 1; tier <= 5; ++tier) {
+        PromotionRule rule;
+        rule.kind = PromotionKind::ReceiptThreshold;
+        rule.minimumSpend = Money(tier * 100000);
+        rule.percentBp = tier * 100;
+        promotions.addRule(rule);
+    }
+
+    Receipt receipt;
+    receipt.setPromotions(&promotions);
+
+    runner.run("promotions/scan/1000", [&]() {
+        receipt.setItems({});
+        for (const ReceiptItem& item : items) receipt.addItem(item);
+        g_sink = g_sink + receipt.amountDue().amount();
+        return qint64(Products);
+    });
+
+    int next = 0;
+    runner.run("promotions/repeatScan", [&]() {
+        receipt.addItem(items[static_cast<size_t>(next)]);
+        next = (next + 1) % Products;
+        g_sink = g_sink + receipt.discount().amount();
+        return qint64(1);
+    });
+}
+
+// Every line change keeps the previous version as an undo snapshot, so these
+// measure the copy-on-write cost a change pays on a large receipt, and what
+// undoing it back costs.
+void benchHistory(BenchRunner& runner) {
+    constexpr int Lines = 100000;
+    Receipt receipt;
+    receipt.setItems(makeItems(Lines));
+
+    std::vector<ReceiptSnapshot> history;
+    int row = 0;
+    runner.run("history/snapshot+edit/100000", [&]() {
+        history.push_back(receipt.snapshot());
+        row = (row + 7919) % Lines;
+        receipt.updateQuantity(row, 1 + row % 5);
+        if (history.size() > 100) history.erase(history.begin());
+        return qint64(1);
+    });
+
+    const ReceiptSnapshot base = receipt.snapshot();
+    receipt.updateQuantity(0, 3);
+    const ReceiptSnapshot edited = receipt.snapshot();
+    bool toBase = true;
+    runner.run("history/restore/100000", [&]() {
+        receipt.restore(toBase ? base : edited);
+        toBase = !toBase;
+        g_sink = g_sink + receipt.subtotal().amount();
+        return qint64(1);
+    });
+}
+
+// A receipt rung up line by line and finished, as at the till; finishing
+// resets the receipt's arena in one step.
+void benchArena(BenchRunner& runner) {
+    for (int lines : { 50, 1000 }) {
+        const std::vector<ReceiptItem> items = makeItems(lines);
+        Receipt receipt;
+        runner.run(QString("arena/receipt/%1").arg(lines), [&]() {
+            for (const ReceiptItem& item : items) receipt.addItem(item);
+            g_sink = g_sink + receipt.subtotal().amount();
+            receipt.setItems({});
+            return qint64(lines);
+        });
+
+        const ReceiptMemoryUsage memory = receipt.memoryUsage();
+        if (memory.receipts == 0) continue;
+        QTextStream(stdout) << QString("arena/receipt/%1: peak %2 KiB, average %3 KiB, reserved %4 KiB\n")
+            .arg(lines)
+            .arg(memory.maxPeakBytes / 1024.0, 0, 'f', 1)
+            .arg(memory.averagePeakBytes / 1024.0, 0, 'f', 1)
+            .arg(memory.reservedBytes / 1024.0, 0, 'f', 1);
+    }
+}
+
+void benchModel(BenchRunner& runner, int rows) {
+    const QString suffix = "/" + QString::number(rows);
+    const std::vector<ReceiptItem> items = makeItems(rows);
+    const ReceiptItem extra("Додатковий товар", Money(4250), 1);
+
+    ReceiptTableModel model;
+    Receipt& receipt = model.receipt();
+
+    runner.run("model/addItem" + suffix, [&]() {
+        receipt.setItems({});
+        for (const ReceiptItem& item : items) receipt.addItem(item);
+        return qint64(rows);
+    });
+
+    receipt.setItems(items);
+    runner.run("model/addItem+removeItem" + suffix, [&]() {
+        receipt.addItem(extra);
+        receipt.removeItem(receipt.lineCount() - 1);
+        return qint64(1);
+    });
+
+    runner.run("model/removeItem+addItem(middle)" + suffix, [&]() {
+        const int row = receipt.lineCount() / 2;
+        const ReceiptItem item = receipt.getItem(row);
+        receipt.removeItem(row);
+        receipt.addItem(item);
+        return qint64(1);
+    });
+
+    int quantity = 1;
+    runner.run("model/updateQuantity" + suffix, [&]() {
+        quantity = quantity % 9 + 1;
+        receipt.updateQuantity(receipt.lineCount() / 2, quantity);
+        return qint64(1);
+    });
+
+    runner.run("model/calculateSubtotal" + suffix, [&]() {
+        g_sink = g_sink + receipt.subtotal().amount();
+        return qint64(1);
+    });
+
+    runner.run("model/recomputeSubtotal" + suffix, [&]() {
+        g_sink = g_sink + receipt.recomputeSubtotal().amount();
+        return qint64(1);
+    });
+
+    // A visible page of cells, as the view requests them on repaint.
+    while (model.canFetchMore(QModelIndex())) model.fetchMore(QModelIndex());
+    const int pageRows = std::min(rows, 30);
+    int firstRow = 0;
+    runner.run("model/data(page)" + suffix, [&]() {
+        for (int row = firstRow; row < firstRow + pageRows; ++row) {
+            for (int column = 0; column < model.columnCount(); ++column) {
+                g_sink = g_sink + model.data(model.index(row, column)).toString().size();
+            }
+        }
+        firstRow = (firstRow + pageRows) % (rows - pageRows + 1);
+        return qint64(pageRows * model.columnCount());
+    });
+}
+
+// A bulk receipt in the fast view mode: resetting it, and scrolling it a page
+// at a time with a synchronous repaint, which is one frame of scrolling.
+void benchView(BenchRunner& runner) {
+    constexpr int Rows = 100000;
+    const std::vector<ReceiptItem> items = makeItems(Rows);
+
+    ReceiptTableModel model;
+    QTableView view;
+    ReceiptItemDelegate::install(&view, &model);
+    view.resize(800, 600);
+    view.show();
+    QCoreApplication::processEvents();
+
+    runner.run("view/setItems/100000", [&]() {
+        model.receipt().setItems(items);
+        QCoreApplication::processEvents();
+        return qint64(1);
+    });
+
+    while (model.canFetchMore(QModelIndex())) model.fetchMore(QModelIndex());
+    QScrollBar* scrollBar = view.verticalScrollBar();
+    int position = 0;
+    runner.run("view/scrollPage/100000", [&]() {
+        position = (position + scrollBar->pageStep()) % std::max(scrollBar->maximum(), 1);
+        scrollBar->setValue(position);
+        view.viewport()->repaint();
+        return qint64(1);
+    });
+}
+
+void benchWindow(BenchRunner& runner) {
+    // Construction up to the first frame and the deferred start-up after it,
+    // the part of a reboot the cashier waits for.
+    runner.run("window/coldStart", []() {
+        CashRegisterWindow window;
+        window.show();
+        QCoreApplication::processEvents();
+        QCoreApplication::processEvents();
+        return qint64(1);
+    });
+
+    CashRegisterWindow window;
+    window.setConfirmationsEnabled(false);
+    window.show();
+    QCoreApplication::processEvents();
+
+    // Alternating tenders flip the change label between states, so every
+    // refresh rewrites text and re-polishes the style.
+    ActionRecord tender;
+    tender.action = MacroAction::Enter;
+    bool enough = false;
+    runner.run("window/updateFinancials(tender)", [&]() {
+        enough = !enough;
+        tender.text = enough ? "100000" : "1";
+        window.applyAction(tender);
+        QCoreApplication::processEvents();
+        return qint64(1);
+    });
+
+    ActionRecord digit;
+    digit.action = MacroAction::Numpad;
+    ActionRecord clear;
+    clear.action = MacroAction::Clear;
+    runner.run("window/numpad", [&]() {
+        for (int i = 0; i < 6; ++i) {
+            digit.argument = i + 1;
+            window.applyAction(digit);
+        }
+        window.applyAction(clear);
+        QCoreApplication::processEvents();
+        return qint64(7);
+    });
+}
+
+// Peak-hour traffic in a 40-lane store: every lane serves customers who scan
+// 20 products, tender and pay. The same work runs on one worker thread and on
+// all cores, so the two figures show how far throughput scales.
+void benchLanes(BenchRunner& runner, const QTemporaryDir& dir) {
+    constexpr int Lanes = 40;
+    constexpr int Products = 2000;
+    constexpr int Customers = 10;
+    constexpr int ScansPerCustomer = 20;
+
+    const QString csvPath = dir.filePath("lanes.csv");
+    const QString catalogPath = dir.filePath("lanes.bin");
+    {
+        QFile csv(csvPath);
+        csv.open(QIODevice::WriteOnly | QIODevice::Truncate);
+        for (int i = 0; i < Products; ++i) {
+            csv.write(QString("%1,%2.%3,Товар %4\n")
+                .arg(4820000000000ULL + static_cast<qulonglong>(i))
+                .arg(10 + i % 90).arg(i % 100, 2, 10, QChar('0')).arg(i).toUtf8());
+        }
+    }
+    ProductCatalog catalog;
+    if (!ProductCatalog::build(csvPath, catalogPath) || !catalog.open(catalogPath)) return;
+
+    std::vector<ActionRecord> records;
+    for (int customer = 0; customer < Customers; ++customer) {
+        ActionRecord scan;
+        scan.action = MacroAction::Enter;
+        for (int i = 0; i < ScansPerCustomer; ++i) {
+            const int product = (customer * 7919 + i * 104729) % Products;
+            scan.text = QString::number(4820000000000ULL + static_cast<qulonglong>(product));
+            records.push_back(scan);
+        }
+        ActionRecord tender;
+        tender.action = MacroAction::Enter;
+        tender.text = "9999";
+        records.push_back(tender);
+        ActionRecord approve;
+        approve.action = MacroAction::Approve;
+        records.push_back(approve);
+    }
+
+    // In memory the lanes measure the engines alone; without sync they also
+    // journal and record sales, minus the wait for the disk.
+    for (LaneHost::Storage storage : { LaneHost::Storage::Memory, LaneHost::Storage::NoSync }) {
+        const bool memory = storage == LaneHost::Storage::Memory;
+        LaneHost host(Lanes, &catalog);
+        if (!host.open(dir.filePath(memory ? "lanes" : "lanes-nosync"), storage)) return;
+        for (int threads : { 1, 0 }) {
+            host.setThreadCount(threads);
+            const QString name = QString("lanes/40/%1threads=%2")
+                .arg(memory ? QString() : QString("nosync/"))
+                .arg(threads == 1 ? "1" : "all");
+            runner.run(name, [&]() {
+                host.run(records);
+                return qint64(records.size() * Lanes);
+            });
+        }
+    }
+}
+
+// A cashier typing product names into a catalog of a million: every
+// keystroke of each query, backspaces included, refines the search. Besides
+// the mean, the latency of single keystrokes is reported, as that is what the
+// popup has to keep under a millisecond.
+void benchSearch(BenchRunner& runner, const QTemporaryDir& dir) {
+    constexpr int Products = 1000000;
+    const QString name = QString("search/keystroke/%1").arg(Products);
+    if (!runner.wants(name)) return;
+
+    static const char* const kinds[] = { "Молоко", "Кефір", "Йогурт", "Сир", "Масло", "Хліб", "Батон", "Ковбаса",
+                                         "Сосиски", "М'ясо", "Філе", "Сік", "Вода", "Чай", "Кава", "Печиво",
+                                         "Цукерки", "Шоколад", "Олія", "Борошно", "Цукор", "Рис", "Гречка", "Макарони" };
+    static const char* const traits[] = { "пастеризоване", "ультрапастеризоване", "фермерське", "домашній", "твердий",
+                                          "вершкове", "житній", "пшеничний", "варена", "копчена", "курячі", "свиняче",
+                                          "яблучний", "апельсиновий", "мінеральна", "газована", "чорний", "зелений",
+                                          "мелена", "розчинна", "вівсяне", "молочний", "гіркий", "соняшникова" };
+    static const char* const brands[] = { "Яготинське", "Галичина", "Простоквашино", "Ферма", "Глобино", "Наш Край",
+                                          "Моршинська", "Живчик", "Рошен", "Світоч", "Щедрий Лан", "Олейна",
+                                          "Київхліб", "Лубенський", "Торчин", "Premialle", "Organic Life", "Green Hills" };
+    static const char* const sizes[] = { "200 г", "250 г", "400 г", "500 г", "900 г", "1 кг", "0,5 л", "0,9 л", "1 л",
+                                         "1,5 л", "2,5%", "3,2%", "72%", "82,5%" };
+
+    const QString csvPath = dir.filePath("search.csv");
+    const QString catalogPath = dir.filePath("search.bin");
+    {
+        QFile csv(csvPath);
+        csv.open(QIODevice::WriteOnly | QIODevice::Truncate);
+        uint32_t seed = 12345;
+        auto pick = [&seed](const auto& words) {
+            seed = seed * 1664525u + 1013904223u;
+            return words[(seed >> 8) % std::size(words)];
+        };
+        QByteArray line;
+        for (int i = 0; i < Products; ++i) {
+            line = QByteArray::number(4820000000000ULL + static_cast<qulonglong>(i));
+            line += ',';
+            line += QByteArray::number(10 + i % 490);
+            line += ".99,";
+            line += pick(kinds);
+            line += ' ';
+            line += pick(traits);
+            line += ' ';
+            line += pick(brands);
+            line += ' ';
+            line += pick(sizes);
+            line += " #";
+            line += QByteArray::number(i);
+            line += '\n';
+            csv.write(line);
+        }
+    }
+    ProductCatalog catalog;
+    if (!ProductCatalog::build(csvPath, catalogPath) || !catalog.open(catalogPath)) return;
+
+    // Typos included: "молко" and "яготинскє" begin no word in the catalog.
+    const QStringList queries = { "молоко ягот 2,5", "сир твердий", "кава мелена", "молко", "яготинскє молоко",
+                                  "сік яблуч 1 л", "ковбаса копч галич", "м'ясо свин", "шоколад гіркий 72",
+                                  "organic", "хліб житній київ" };
+    std::vector<QString> keystrokes;
+    for (const QString& query : queries) {
+        for (int i = 1; i <= query.size(); ++i) keystrokes.push_back(query.left(i));
+        for (int i = query.size() - 1; i >= 0; --i) keystrokes.push_back(query.left(i));
+    }
+
+    ProductSearch search(&catalog);
+    runner.run(name, [&]() {
+        for (const QString& text : keystrokes) search.setQuery(text);
+        g_sink = g_sink + static_cast<int64_t>(search.results().size());
+        return static_cast<qint64>(keystrokes.size());
+    });
+
+    LatencyHistogram histogram;
+    QElapsedTimer timer;
+    for (int pass = 0; pass < 20; ++pass) {
+        for (const QString& text : keystrokes) {
+            timer.start();
+            search.setQuery(text);
+            histogram.record(static_cast<uint64_t>(timer.nsecsElapsed()));
+        }
+    }
+    QTextStream(stdout) << QString("%1: p50 %2 us, p99 %3 us, max %4 us over %5 keystrokes, %6 index words\n")
+        .arg(name)
+        .arg(histogram.percentile(0.50) / 1000.0, 0, 'f', 1)
+        .arg(histogram.percentile(0.99) / 1000.0, 0, 'f', 1)
+        .arg(histogram.max() / 1000.0, 0, 'f', 1)
+        .arg(static_cast<qulonglong>(histogram.count()))
+        .arg(catalog.searchWordCount());
+}
+
+void benchMacroFiles(BenchRunner& runner, const QTemporaryDir& dir) {
+    constexpr int EventCount = 100000;
+    const QString binaryPath = dir.filePath("bench.crm");
+    const QString textPath = dir.filePath("bench.txt");
+    const QString actionsPath = dir.filePath("bench.cra");
+
+    for (MacroFormat format : { MacroFormat::Binary, MacroFormat::Text }) {
+        MacroFileWriter writer;
+        writer.open(format == MacroFormat::Binary ? binaryPath : textPath, format);
+        for (int i = 0; i < EventCount; ++i) {
+            MacroEvent event{};
+            event.deltaUs = (i % 3) * 1000;
+            event.type = 1;
+            event.code = static_cast<uint16_t>(i % 200);
+            event.value = i % 2;
+            writer.append(event);
+        }
+        writer.close();
+    }
+
+    std::vector<ActionRecord> actions(EventCount);
+    for (int i = 0; i < EventCount; ++i) {
+        actions[static_cast<size_t>(i)].action = i % 8 == 7 ? MacroAction::Enter : MacroAction::Numpad;
+        actions[static_cast<size_t>(i)].argument = i % 10;
+        if (i % 8 == 7) actions[static_cast<size_t>(i)].text = "1234567";
+    }
+    saveActionMacro(actionsPath, actions);
+
+    std::vector<MacroEvent> events;
+    runner.run("macro/loadBinary", [&]() {
+        events.clear();
+        loadMacroFile(binaryPath, events);
+        g_sink = g_sink + static_cast<int64_t>(events.size());
+        return qint64(EventCount);
+    });
+
+    runner.run("macro/loadText", [&]() {
+        events.clear();
+        loadMacroFile(textPath, events);
+        g_sink = g_sink + static_cast<int64_t>(events.size());
+        return qint64(EventCount);
+    });
+
+    std::vector<ActionRecord> loaded;
+    runner.run("macro/loadActions", [&]() {
+        loadActionMacro(actionsPath, loaded);
+        g_sink = g_sink + static_cast<int64_t>(loaded.size());
+        return qint64(EventCount);
+    });
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    // The window restores and appends to the journal and ledger; keep the
+    // benchmark away from real sales data.
+    QTemporaryDir scratch;
+    qputenv("CASHREGISTER_JOURNAL", scratch.filePath("receipt.journal").toLocal8Bit());
+    qputenv("CASHREGISTER_LEDGER", scratch.filePath("ledger").toLocal8Bit());
+
+    QApplication app(argc, argv);
+
+    BenchOptions options;
+    QString jsonPath;
+    QString baselinePath;
+    double threshold = 10.0;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::strcmp(argv[i], "--filter") == 0) options.filter = QString::fromLocal8Bit(argv[++i]);
+        else if (std::strcmp(argv[i], "--min-time") == 0) options.minTimeNs = std::atoll(argv[++i]) * 1000000LL;
+        else if (std::strcmp(argv[i], "--json") == 0) jsonPath = QString::fromLocal8Bit(argv[++i]);
+        else if (std::strcmp(argv[i], "--baseline") == 0) baselinePath = QString::fromLocal8Bit(argv[++i]);
+        else if (std::strcmp(argv[i], "--threshold") == 0) threshold = std::atof(argv[++i]);
+    }
+
+    BenchRunner runner(options);
+    benchMoney(runner);
+    benchKernels(runner);
+    for (int rows : { 10, 1000, 100000 }) benchModel(runner, rows);
+    benchPromotions(runner);
+    benchHistory(runner);
+    benchArena(runner);
+    benchView(runner);
+    benchWindow(runner);
+    benchLanes(runner, scratch);
+    benchSearch(runner, scratch);
+    benchMacroFiles(runner, scratch);
+
+    if (!jsonPath.isEmpty()) {
+        QFile file(jsonPath);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            QTextStream(stderr) << "Cannot write " << jsonPath << "\n";
+            return 2;
+        }
+        file.write(toJson(runner.results()).toJson());
+    }
+
+    if (!baselinePath.isEmpty() && !compareWithBaseline(runner.results(), baselinePath, threshold)) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,815 @@
+#include "ProductCatalog.h"
+#include "ProductSearch.h"
+#include "PromotionEngine.h"
+#include "Receipt.h"
+#include "ReceiptArena.h"
+#include "ReceiptLines.h"
+#include "ReceiptJournal.h"
+#include "RegisterEngine.h"
+#include "SalesLedger.h"
+#include "money.h"
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <csignal>
+#include <sys/resource.h>
+#endif
+
+// Regression tests for the register core. Each test returns normally on
+// success; CHECK reports a failure and the run exits non-zero at the end.
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(condition)                                                                           \
+    do {                                                                                           \
+        if (!(condition)) {                                                                        \
+            ++g_failures;                                                                          \
+            QTextStream(stderr) << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed\n"; \
+        }                                                                                          \
+    } while (false)
+
+ReceiptLine makeLine(int i) {
+    ReceiptLine line;
+    line.nameId = static_cast<NamePool::Id>(i);
+    line.price = 100 + i;
+    line.quantity = 1;
+    line.barcode = static_cast<uint64_t>(i);
+    return line;
+}
+
+// Compares every row against a plain vector kept in step with the lines.
+bool sameLines(const ReceiptLines& lines, const std::vector<ReceiptLine>& expected) {
+    if (lines.size() != static_cast<int>(expected.size())) return false;
+    for (int row = 0; row < lines.size(); ++row) {
+        const ReceiptLine line = lines.line(row);
+        if (line.nameId != expected[static_cast<size_t>(row)].nameId
+            || line.price != expected[static_cast<size_t>(row)].price) {
+            return false;
+        }
+    }
+    int runRows = 0;
+    lines.forEachRun([&runRows](const ReceiptLines::Run& run) { runRows += run.count; });
+    return runRows == lines.size();
+}
+
+void testInsertSplitsFullChunk() {
+    for (int offset : { 10, 64, 100, 127 }) {
+        ReceiptArena arena;
+        ReceiptLines lines(&arena);
+        std::vector<ReceiptLine> expected;
+        for (int i = 0; i < ReceiptLines::ChunkCapacity; ++i) {
+            lines.append(makeLine(i));
+            expected.push_back(makeLine(i));
+        }
+        const ReceiptLines snapshot = lines;
+
+        lines.insert(offset, makeLine(1000));
+        expected.insert(expected.begin() + offset, makeLine(1000));
+        CHECK(sameLines(lines, expected));
+        CHECK(snapshot.size() == ReceiptLines::ChunkCapacity);
+    }
+}
+
+void testMoveAcrossChunks() {
+    ReceiptArena arena;
+    ReceiptLines lines(&arena);
+    std::vector<ReceiptLine> expected;
+    for (int i = 0; i < 2 * ReceiptLines::ChunkCapacity; ++i) {
+        lines.append(makeLine(i));
+        expected.push_back(makeLine(i));
+    }
+
+    const int moves[][2] = { { 10, 200 }, { 200, 10 }, { 0, 255 }, { 255, 0 }, { 127, 128 }, { 130, 5 } };
+    for (const auto& move : moves) {
+        lines.move(move[0], move[1]);
+        const ReceiptLine moved = expected[static_cast<size_t>(move[0])];
+        expected.erase(expected.begin() + move[0]);
+        expected.insert(expected.begin() + move[1], moved);
+        CHECK(sameLines(lines, expected));
+    }
+}
+
+// Random inserts and erases against a vector, with snapshots taken along the
+// way that must not change.
+void testRandomEdits() {
+    ReceiptArena arena;
+    ReceiptLines lines(&arena);
+    std::vector<ReceiptLine> expected;
+    std::vector<std::pair<ReceiptLines, std::vector<ReceiptLine>>> snapshots;
+    uint32_t seed = 1;
+    auto next = [&seed](int bound) {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<int>((seed >> 8) % static_cast<uint32_t>(bound));
+    };
+
+    for (int step = 0; step < 5000; ++step) {
+        const int size = static_cast<int>(expected.size());
+        if (size > 0 && next(3) == 0) {
+            const int first = next(size);
+            const int count = 1 + next(std::min(size - first, 40));
+            lines.erase(first, count);
+            expected.erase(expected.begin() + first, expected.begin() + first + count);
+        } else {
+            const int row = next(size + 1);
+            lines.insert(row, makeLine(step));
+            expected.insert(expected.begin() + row, makeLine(step));
+        }
+        if (step % 500 == 0) snapshots.emplace_back(lines, expected);
+    }
+    CHECK(sameLines(lines, expected));
+    for (const auto& [snapshot, contents] : snapshots) CHECK(sameLines(snapshot, contents));
+}
+
+// A line that would take the subtotal beyond int64 is refused, whether added,
+// merged into or resized, and leaves the receipt as it was.
+void testSubtotalOverflow() {
+    Receipt receipt;
+    const Money half(std::numeric_limits<int64_t>::max() / 2);
+    CHECK(receipt.addItem(ReceiptItem("Злиток", half, 1)));
+    CHECK(receipt.addItem(ReceiptItem("Злиток", half, 1)));
+    const Money subtotal = receipt.subtotal();
+    CHECK(!receipt.addItem(ReceiptItem("Злиток", half, 1)));
+    CHECK(!receipt.addItem(ReceiptItem("Хліб", Money(2550), 1)));
+    CHECK(!receipt.appendItem(ReceiptItem("Хліб", Money(2550), 1)));
+    CHECK(!receipt.updateQuantity(0, 3));
+    CHECK(receipt.lineCount() == 1 && receipt.quantity(0) == 2);
+    CHECK(receipt.subtotal() == subtotal);
+    CHECK(receipt.recomputeSubtotal() == subtotal);
+
+    receipt.setItems({ ReceiptItem("Злиток", half, 3), ReceiptItem("Хліб", Money(2550), 2) });
+    CHECK(receipt.lineCount() == 1 && receipt.subtotal() == Money(5100));
+    CHECK(receipt.recomputeSubtotal() == receipt.subtotal());
+}
+
+// Removals keep the line index in step: every key still finds its first
+// remaining line, including keys whose first line was removed.
+void testLineIndexAfterRemoval() {
+    Receipt receipt;
+    uint32_t seed = 7;
+    auto next = [&seed](int bound) {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<int>((seed >> 8) % static_cast<uint32_t>(bound));
+    };
+    auto item = [](int key) { return ReceiptItem("Товар", Money(100), 1, 4820000000000ULL + static_cast<uint64_t>(key)); };
+
+    for (int i = 0; i < 600; ++i) CHECK(receipt.appendItem(item(next(50))));
+    for (int step = 0; step < 200 && !receipt.isEmpty(); ++step) {
+        if (next(2) == 0) {
+            receipt.removeItem(next(receipt.lineCount()));
+        } else {
+            std::vector<int> rows;
+            for (int i = 0; i < 5; ++i) rows.push_back(next(receipt.lineCount()));
+            receipt.removeItems(rows);
+        }
+        if (next(4) == 0) CHECK(receipt.appendItem(item(next(50))));
+
+        for (int key = 0; key < 50; ++key) {
+            int first = -1;
+            for (int row = 0; row < receipt.lineCount() && first < 0; ++row) {
+                if (receipt.getItem(row).barcode() == item(key).barcode()) first = row;
+            }
+            CHECK(receipt.findLine(item(key)) == first);
+        }
+    }
+}
+
+// The two-word path MSVC builds use must agree with the 128-bit one.
+void testMulDivWide() {
+    static_assert(MoneyDetail::mulDivWide<SaturateOverflow>(12999, 250, 1000, RoundingMode::HalfUp) == 3250);
+    static_assert(MoneyDetail::mulDivWide<SaturateOverflow>(-12999, 250, 1000, RoundingMode::HalfUp) == -3250);
+
+    const int64_t max = std::numeric_limits<int64_t>::max();
+    const int64_t min = std::numeric_limits<int64_t>::min();
+    const int64_t edges[] = { 0, 1, -1, 2, 5, -5, 999, 1000, 1001, 12345, -98765, 1LL << 32, (1LL << 32) + 1,
+                              max / 1000, min / 1000, max / 3, max - 1, max, min + 1, min };
+    const int64_t denominators[] = { 1, 2, 3, 1000, 10000, 1LL << 33, max };
+    const RoundingMode modes[] = { RoundingMode::HalfUp, RoundingMode::HalfEven, RoundingMode::TowardZero,
+                                   RoundingMode::AwayFromZero };
+
+    uint64_t seed = 7;
+    auto random = [&seed]() {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<int64_t>(seed) >> (seed % 48);
+    };
+    std::vector<int64_t> values(std::begin(edges), std::end(edges));
+    for (int i = 0; i < 200; ++i) values.push_back(random());
+
+    for (int64_t a : values) {
+        for (int64_t b : values) {
+            for (int64_t denominator : denominators) {
+                for (RoundingMode mode : modes) {
+                    const int64_t exact = SaturatingMoney(a).mulDiv(b, denominator, mode).amount();
+                    CHECK(MoneyDetail::mulDivWide<SaturateOverflow>(a, b, denominator, mode) == exact);
+                }
+            }
+        }
+    }
+}
+
+void testFromString() {
+    CHECK(Money::fromString(QString("65.50")).amount() == 6550);
+    CHECK(Money::fromString(QString("-0,015")).amount() == -2);
+    CHECK(Money::fromString(QString("abc")).amount() == 0);
+}
+
+// 455 g at 129.99/kg is 59.14545 and 500 g at 10.01/kg a tie at 5.005; each
+// line is rounded once, with the receipt's mode.
+void testWeightRounding() {
+    struct Case {
+        RoundingMode mode;
+        int64_t cheese;
+        int64_t tie;
+    };
+    const Case cases[] = { { RoundingMode::HalfUp, 5915, 501 }, { RoundingMode::HalfEven, 5915, 500 },
+                           { RoundingMode::TowardZero, 5914, 500 }, { RoundingMode::AwayFromZero, 5915, 501 } };
+    for (const Case& c : cases) {
+        Receipt receipt;
+        receipt.setWeightRounding(c.mode);
+        receipt.addItem(ReceiptItem("Сир твердий", Money(12999), 455, 0, QuantityUnit::Gram));
+        receipt.addItem(ReceiptItem("Морква", Money(1001), 500, 0, QuantityUnit::Gram));
+        CHECK(receipt.lineTotal(0).amount() == c.cheese);
+        CHECK(receipt.lineTotal(1).amount() == c.tie);
+        CHECK(receipt.subtotal().amount() == c.cheese + c.tie);
+    }
+}
+
+void testScaleLabel() {
+    uint64_t code = 0;
+    int quantity = 0;
+    CHECK(ProductCatalog::parseScaleLabel(2123456004557ULL, code, quantity));
+    CHECK(code == 2123456000000ULL);
+    CHECK(quantity == 455);
+    // Wrong check digit, a regular EAN-13 and a label without weight.
+    CHECK(!ProductCatalog::parseScaleLabel(2123456004558ULL, code, quantity));
+    CHECK(!ProductCatalog::parseScaleLabel(4820000000017ULL, code, quantity));
+    CHECK(!ProductCatalog::parseScaleLabel(2123456000009ULL, code, quantity));
+}
+
+// Weighed products come from the catalog's per-kilogram prices and reach the
+// receipt through scale labels.
+void testWeighedEntry() {
+    QTemporaryDir dir;
+    const QString csvPath = dir.filePath("catalog.csv");
+    const QString catalogPath = dir.filePath("catalog.bin");
+    {
+        QFile csv(csvPath);
+        CHECK(csv.open(QIODevice::WriteOnly));
+        csv.write(QString("2123456000000,129.99/кг,Сир твердий\n4820000000017,25.50,Хліб\n").toUtf8());
+    }
+    QString error;
+    CHECK(ProductCatalog::build(csvPath, catalogPath, &error));
+    ProductCatalog catalog;
+    CHECK(catalog.open(catalogPath));
+
+    CatalogEntry entry;
+    CHECK(catalog.find(2123456000000ULL, entry) && entry.unit == QuantityUnit::Gram);
+    CHECK(catalog.find(4820000000017ULL, entry) && entry.unit == QuantityUnit::Piece);
+
+    RegisterEngine engine;
+    engine.setCatalog(&catalog);
+    CHECK(engine.enter("2123456000000") == RegisterEngine::EnterResult::WeightRequired);
+    CHECK(engine.enter("2123456004557") == RegisterEngine::EnterResult::ItemAdded);
+    CHECK(engine.addWeighed(2123456000000ULL, 545) == RegisterEngine::EnterResult::ItemAdded);
+    CHECK(engine.addWeighed(4820000000017ULL, 545) == RegisterEngine::EnterResult::UnknownBarcode);
+    CHECK(engine.enter("4820000000017") == RegisterEngine::EnterResult::ItemAdded);
+
+    const Receipt& receipt = engine.receipt();
+    CHECK(receipt.lineCount() == 2);
+    CHECK(receipt.unit(0) == QuantityUnit::Gram);
+    CHECK(receipt.quantity(0) == 1000);
+    CHECK(receipt.subtotal().amount() == 12999 + 2550);
+}
+
+}
+
+// A crash after the ledger recorded a sale but before the journal closed the
+// receipt must not reopen it, or approving it again would sell it twice.
+void testApproveAfterCrash() {
+    QTemporaryDir dir;
+    const QString journalPath = dir.filePath("receipt.journal");
+    const QString ledgerPath = dir.filePath("ledger");
+    const ReceiptItem item("Хліб", Money(2550), 2);
+
+    uint64_t recorded = 0;
+    {
+        SalesLedger ledger;
+        ReceiptJournal journal;
+        CHECK(ledger.open(ledgerPath) && journal.open(journalPath));
+        RegisterEngine engine;
+        engine.setLedger(&ledger);
+        engine.setJournal(&journal);
+        engine.receipt().addItem(item);
+        engine.tender(Money(10000));
+        // What approve() does up to the crash: the sale is on disk, the
+        // journal still holds the open receipt.
+        journal.close();
+        const std::vector<JournalEntry> entries = ReceiptJournal::readOpenReceipt(journalPath);
+        CHECK(entries.size() == 3 && entries.front().op == JournalOp::SaleId);
+        recorded = entries.front().saleId;
+        CHECK(ledger.appendSale(engine.receipt().items(), Money(10000), Money(0), RoundingMode::HalfUp, recorded));
+    }
+    {
+        SalesLedger ledger;
+        ReceiptJournal journal;
+        CHECK(ledger.open(ledgerPath));
+        CHECK(ledger.lastSaleId() == recorded);
+        const std::vector<JournalEntry> entries = ReceiptJournal::readOpenReceipt(journalPath);
+        CHECK(journal.open(journalPath));
+        RegisterEngine engine;
+        engine.setLedger(&ledger);
+        engine.setJournal(&journal);
+        CHECK(!engine.restore(entries));
+        CHECK(engine.receipt().isEmpty());
+        CHECK(ledger.dailyTotals(QDate::currentDate()).receiptCount == 1);
+
+        // A receipt the ledger does not hold comes back.
+        engine.receipt().addItem(item);
+        journal.close();
+    }
+    {
+        SalesLedger ledger;
+        ReceiptJournal journal;
+        CHECK(ledger.open(ledgerPath));
+        const std::vector<JournalEntry> entries = ReceiptJournal::readOpenReceipt(journalPath);
+        CHECK(journal.open(journalPath));
+        RegisterEngine engine;
+        engine.setLedger(&ledger);
+        engine.setJournal(&journal);
+        CHECK(engine.restore(entries));
+        CHECK(engine.receipt().lineCount() == 1);
+        engine.tender(Money(10000));
+        CHECK(engine.approve() == RegisterEngine::ApproveResult::Approved);
+        CHECK(ledger.lastSaleId() > recorded);
+        CHECK(ledger.dailyTotals(QDate::currentDate()).receiptCount == 2);
+    }
+}
+
+// P is in a multibuy and a later mix-and-match, Q in that mix-and-match, and
+// all three in a category with two percentages: each unit gets one discount.
+void testOverlappingPromotions() {
+    constexpr uint64_t P = 4820000000017ULL;
+    constexpr uint64_t Q = 4820000000024ULL;
+    constexpr uint64_t R = 4820000000031ULL;
+
+    PromotionEngine promotions;
+    for (uint64_t barcode : { P, Q, R }) promotions.setCategory(barcode, 1);
+    PromotionRule multiBuy;
+    multiBuy.kind = PromotionKind::MultiBuy;
+    multiBuy.products = { P };
+    multiBuy.bundleSize = 3;
+    multiBuy.bundlePrice = Money(5000);
+    promotions.addRule(multiBuy);
+    PromotionRule mix;
+    mix.kind = PromotionKind::MixAndMatch;
+    mix.products = { P, Q };
+    mix.bundleSize = 2;
+    mix.bundlePrice = Money(1500);
+    promotions.addRule(mix);
+    for (int percentBp : { 1000, 2000 }) {
+        PromotionRule percent;
+        percent.kind = PromotionKind::CategoryPercent;
+        percent.category = 1;
+        percent.percentBp = percentBp;
+        promotions.addRule(percent);
+    }
+
+    promotions.lineChanged(P, 2000, 3, Money(6000));
+    promotions.lineChanged(Q, 1000, 2, Money(2000));
+    promotions.lineChanged(R, 500, 1, Money(500));
+    // 60.00 - 50.00 for P, 20.00 - 15.00 for Q and 20% of 5.00 for R.
+    CHECK(promotions.discount().amount() == 1000 + 500 + 100);
+    CHECK(promotions.appliedDiscounts().size() == 3);
+
+    // A percentage never takes more than the line is worth.
+    PromotionEngine whole;
+    whole.setCategory(R, 2);
+    PromotionRule all;
+    all.kind = PromotionKind::CategoryPercent;
+    all.category = 2;
+    all.percentBp = 10000;
+    whole.addRule(all);
+    whole.addRule(all);
+    whole.lineChanged(R, 500, 2, Money(1000));
+    CHECK(whole.discount().amount() == 1000);
+    CHECK(whole.appliedDiscounts().size() == 1);
+}
+
+// Journals cut at an approve hold only state of the empty receipt.
+void testRestoreAfterTruncation() {
+    QTemporaryDir dir;
+    const QString journalPath = dir.filePath("receipt.journal");
+    {
+        ReceiptJournal journal;
+        CHECK(journal.open(journalPath));
+        journal.logAddItem(ReceiptItem("Хліб", Money(2550), 1));
+        journal.logApprove();
+        journal.logReset();
+        journal.logSaleId(42);
+        journal.logReset();
+    }
+    const std::vector<JournalEntry> entries = ReceiptJournal::readOpenReceipt(journalPath);
+    CHECK(entries.size() == 3);
+    RegisterEngine engine;
+    CHECK(!engine.restore(entries));
+    CHECK(engine.receipt().isEmpty());
+}
+
+// Bulk-loaded duplicates stay separate lines on replay, so the row-indexed
+// records after them still land on the lines they were made for.
+void testRestoreDuplicateLines() {
+    QTemporaryDir dir;
+    const QString journalPath = dir.filePath("receipt.journal");
+    std::vector<ReceiptItem> expected;
+    {
+        ReceiptJournal journal;
+        CHECK(journal.open(journalPath));
+        RegisterEngine engine;
+        engine.setJournal(&journal);
+        engine.receipt().setItems({ ReceiptItem("Хліб", Money(2550), 1), ReceiptItem("Хліб", Money(2550), 2),
+                                    ReceiptItem("Молоко", Money(4200), 1) });
+        engine.receipt().updateQuantity(1, 5);
+        engine.receipt().moveItem(2, 0);
+        CHECK(engine.removeLine(1));
+        expected = engine.receipt().items();
+    }
+    RegisterEngine engine;
+    CHECK(engine.restore(ReceiptJournal::readOpenReceipt(journalPath)));
+    const std::vector<ReceiptItem> restored = engine.receipt().items();
+    CHECK(restored.size() == expected.size());
+    for (size_t i = 0; i < std::min(restored.size(), expected.size()); ++i) {
+        CHECK(restored[i].name() == expected[i].name() && restored[i].quantity() == expected[i].quantity());
+    }
+}
+
+// Undo and redo journal only the lines that differ from the restored
+// snapshot, and the journal still replays to the same receipt.
+void testRestoreJournalsDiff() {
+    QTemporaryDir dir;
+    const QString journalPath = dir.filePath("receipt.journal");
+    std::vector<ReceiptItem> items;
+    for (int i = 0; i < 300; ++i) items.emplace_back(QString::number(i), Money(100 + i), 1, 1000000 + i);
+    std::vector<ReceiptItem> expected;
+    {
+        ReceiptJournal journal;
+        CHECK(journal.open(journalPath));
+        Receipt receipt;
+        receipt.setJournal(&journal);
+        receipt.setItems(items);
+        const ReceiptSnapshot loaded = receipt.snapshot();
+        receipt.updateQuantity(150, 7);
+        const ReceiptSnapshot changed = receipt.snapshot();
+        receipt.removeItem(10);
+        const ReceiptSnapshot removed = receipt.snapshot();
+        receipt.addItem(ReceiptItem("Хліб", Money(2550), 1));
+        receipt.moveItem(receipt.lineCount() - 1, 200);
+
+        receipt.restore(removed);
+        receipt.restore(changed);
+        receipt.restore(loaded);
+        receipt.restore(changed);
+        expected = receipt.items();
+    }
+    const std::vector<JournalEntry> entries = ReceiptJournal::readOpenReceipt(journalPath);
+    CHECK(entries.size() < items.size() + 20);
+
+    RegisterEngine engine;
+    CHECK(engine.restore(entries));
+    const std::vector<ReceiptItem> restored = engine.receipt().items();
+    CHECK(restored.size() == expected.size());
+    for (size_t i = 0; i < std::min(restored.size(), expected.size()); ++i) {
+        CHECK(restored[i].barcode() == expected[i].barcode() && restored[i].quantity() == expected[i].quantity());
+    }
+}
+
+// Each record is logged while the writer sleeps; a lost wakeup leaves it
+// uncommitted until the next one.
+void testJournalWakesWriter() {
+    QTemporaryDir dir;
+    ReceiptJournal journal(std::chrono::microseconds(0));
+    CHECK(journal.open(dir.filePath("receipt.journal")));
+    for (uint64_t i = 1; i <= 300; ++i) {
+        journal.logTender(Money(static_cast<int64_t>(i)));
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (journal.stats().records < i && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+        CHECK(journal.stats().records == i);
+    }
+}
+
+#ifdef __linux__
+// A batch the file size limit refuses is counted as lost, not committed, and
+// the engine reports the journal broken until a closed receipt restarts it.
+void testJournalWriteFailure() {
+    auto waitFor = [](const std::function<bool()>& condition) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (!condition() && std::chrono::steady_clock::now() < deadline) std::this_thread::yield();
+        return condition();
+    };
+
+    QTemporaryDir dir;
+    ReceiptJournal journal(std::chrono::microseconds(0));
+    CHECK(journal.open(dir.filePath("receipt.journal")));
+    RegisterEngine engine;
+    engine.setJournal(&journal);
+    CHECK(waitFor([&journal] { return journal.stats().records == 1; }));
+
+    rlimit limit{};
+    CHECK(getrlimit(RLIMIT_FSIZE, &limit) == 0);
+    const rlimit unlimited = limit;
+    std::signal(SIGXFSZ, SIG_IGN);
+    limit.rlim_cur = 16;
+    CHECK(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+    engine.receipt().addItem(ReceiptItem("Хліб", Money(2550), 1));
+    CHECK(waitFor([&journal] { return journal.stats().failedCommits == 1; }));
+    CHECK(setrlimit(RLIMIT_FSIZE, &unlimited) == 0);
+
+    CHECK(journal.stats().lostRecords == 1 && journal.stats().records == 1);
+    CHECK(!engine.paymentState().journalIntact);
+    engine.decline();
+    CHECK(waitFor([&journal] { return journal.isIntact(); }));
+    CHECK(engine.paymentState().journalIntact);
+}
+#endif
+
+// Removing more rows than one ring can hold used to spin forever; the
+// removal is split into records that replay to the same lines.
+void testLargeRemovalJournaled() {
+    QTemporaryDir dir;
+    const QString journalPath = dir.filePath("receipt.journal");
+    std::vector<ReceiptItem> items;
+    for (int i = 0; i < 300000; ++i) items.emplace_back(QString::number(i), Money(100), 1, 1000000 + i);
+    std::vector<int> rows;
+    for (int row = 0; row < static_cast<int>(items.size()); ++row) {
+        if (row % 10 != 0) rows.push_back(row);
+    }
+
+    Receipt receipt;
+    receipt.setItems(items);
+    {
+        ReceiptJournal journal;
+        CHECK(journal.open(journalPath));
+        receipt.setJournal(&journal);
+        receipt.removeItems(rows);
+        receipt.setJournal(nullptr);
+    }
+
+    const std::vector<JournalEntry> entries = ReceiptJournal::readOpenReceipt(journalPath);
+    CHECK(entries.size() > 1);
+    Receipt replayed;
+    replayed.setItems(items);
+    for (const JournalEntry& entry : entries) {
+        CHECK(entry.op == JournalOp::RemoveItems);
+        replayed.removeItems(entry.rows);
+    }
+    CHECK(replayed.lineCount() == receipt.lineCount());
+    CHECK(replayed.lineCount() == 30000);
+    CHECK(replayed.getItem(29999).barcode() == receipt.getItem(29999).barcode());
+}
+
+// A sidecar that missed a sale is rebuilt from the segments on open.
+void testStaleTotalsRebuilt() {
+    QTemporaryDir dir;
+    const QString ledgerPath = dir.filePath("ledger");
+    const std::vector<ReceiptItem> items = { ReceiptItem("Хліб", Money(2550), 2) };
+    const QDate today = QDate::currentDate();
+
+    QByteArray stale;
+    {
+        SalesLedger ledger;
+        CHECK(ledger.open(ledgerPath));
+        CHECK(ledger.appendSale(items, Money(10000), Money(0), RoundingMode::HalfUp, 1));
+        QFile totals(QDir(ledgerPath).filePath(QString("totals-%1.bin").arg(today.toString("yyyyMMdd"))));
+        CHECK(totals.open(QIODevice::ReadOnly));
+        stale = totals.readAll();
+        CHECK(ledger.appendSale(items, Money(10000), Money(0), RoundingMode::HalfUp, 2));
+    }
+    {
+        QFile totals(QDir(ledgerPath).filePath(QString("totals-%1.bin").arg(today.toString("yyyyMMdd"))));
+        CHECK(totals.open(QIODevice::WriteOnly | QIODevice::Truncate));
+        CHECK(totals.write(stale) == stale.size());
+    }
+    SalesLedger ledger;
+    CHECK(ledger.open(ledgerPath));
+    const DailyTotals totals = ledger.dailyTotals(today);
+    CHECK(totals.receiptCount == 2);
+    CHECK(totals.gross == 2 * 5100);
+    CHECK(totals.lastSaleId == 2);
+}
+
+// Gross stays the sum of the lines, so the Z-report can show discounts.
+void testLedgerDiscount() {
+    QTemporaryDir dir;
+    const QString ledgerPath = dir.filePath("ledger");
+    const std::vector<ReceiptItem> items = { ReceiptItem("Хліб", Money(2550), 2) };
+    const QDate today = QDate::currentDate();
+    {
+        SalesLedger ledger;
+        CHECK(ledger.open(ledgerPath));
+        CHECK(ledger.appendSale(items, Money(5000), Money(300), RoundingMode::HalfUp, 1));
+        const DailyTotals totals = ledger.dailyTotals(today);
+        CHECK(totals.gross == 5100 && totals.discount == 300 && totals.change == 200);
+    }
+    CHECK(QFile::remove(QDir(ledgerPath).filePath(QString("totals-%1.bin").arg(today.toString("yyyyMMdd")))));
+    SalesLedger ledger;
+    CHECK(ledger.open(ledgerPath));
+    const DailyTotals totals = ledger.dailyTotals(today);
+    CHECK(totals.gross == 5100 && totals.discount == 300 && totals.change == 200);
+    int sales = 0;
+    CHECK(ledger.forEachSale(today, [&sales](const LedgerSale& sale) {
+        ++sales;
+        CHECK(sale.gross.amount() == 5100 && sale.discount.amount() == 300);
+    }));
+    CHECK(sales == 1);
+}
+
+// Overwrites 32 bits of a built catalog at delta bytes past the section whose
+// offset is stored at headerField.
+void patchCatalog(const QString& path, qint64 headerField, qint64 delta, uint32_t value) {
+    QFile file(path);
+    CHECK(file.open(QIODevice::ReadWrite));
+    uint64_t section = 0;
+    CHECK(file.seek(headerField) && file.read(reinterpret_cast<char*>(&section), sizeof(section)) == sizeof(section));
+    CHECK(file.seek(static_cast<qint64>(section) + delta));
+    CHECK(file.write(reinterpret_cast<const char*>(&value), sizeof(value)) == sizeof(value));
+}
+
+// A record whose name runs past the names block reads with an empty name.
+void testCatalogNameBounds() {
+    QTemporaryDir dir;
+    const QString csvPath = dir.filePath("catalog.csv");
+    const QString catalogPath = dir.filePath("catalog.bin");
+    {
+        QFile csv(csvPath);
+        CHECK(csv.open(QIODevice::WriteOnly));
+        csv.write(QString("4820000000017,25.50,Хліб\n").toUtf8());
+    }
+    CHECK(ProductCatalog::build(csvPath, catalogPath));
+    // Header::recordsOffset, then Record::nameLength of the only record.
+    patchCatalog(catalogPath, 32, 20, 0x7FFFFFFF);
+
+    ProductCatalog catalog;
+    CHECK(catalog.open(catalogPath));
+    CatalogEntry entry;
+    CHECK(catalog.find(4820000000017ULL, entry));
+    CHECK(entry.name.isEmpty() && entry.price == Money(2550));
+}
+
+// A damaged search index entry is bounded when search reads it: the catalog
+// still opens in O(1), the entry matches nothing and barcodes keep working.
+void testCatalogSearchIndexChecked() {
+    QTemporaryDir dir;
+    const QString csvPath = dir.filePath("catalog.csv");
+    {
+        QFile csv(csvPath);
+        CHECK(csv.open(QIODevice::WriteOnly));
+        csv.write(QString("4820000000017,25.50,Хліб білий\n4820000000024,42.00,Молоко\n").toUtf8());
+    }
+    const QString intact = dir.filePath("intact.bin");
+    const QString badText = dir.filePath("text.bin");
+    const QString badWord = dir.filePath("word.bin");
+    for (const QString& path : { intact, badText, badWord }) {
+        CHECK(ProductCatalog::build(csvPath, path));
+    }
+    // Header::searchWordsOffset, then SearchWord::textLength of the first word.
+    patchCatalog(badText, 64, 4, 0x7FFFFFFF);
+    // Header::recordWordsOffset, then the first record word.
+    patchCatalog(badWord, 112, 0, 0x7FFFFFFF);
+
+    ProductCatalog catalog;
+    CHECK(catalog.open(intact) && catalog.hasSearchIndex());
+    for (const QString& path : { badText, badWord }) {
+        CHECK(catalog.open(path) && catalog.hasSearchIndex());
+        CatalogEntry entry;
+        CHECK(catalog.find(4820000000024ULL, entry) && entry.name.toString() == "Молоко");
+        ProductSearch search(&catalog);
+        for (const char* query : { "мол", "молко", "хліб білий", "білий", "бліий" }) {
+            search.setQuery(QString(query));
+            for (uint32_t record : search.results()) CHECK(record < catalog.size());
+        }
+        search.setQuery(QString("молоко"));
+        CHECK(search.results().size() == 1 && search.results()[0] == 1);
+    }
+    CHECK(catalog.open(badText) && catalog.searchWord(0).empty());
+}
+
+// Promotions that take the whole receipt off leave nothing to pay, and the
+// sale still goes through.
+void testFullyDiscountedReceipt() {
+    constexpr uint64_t Bread = 4820000000017ULL;
+    PromotionEngine promotions;
+    promotions.setCategory(Bread, 1);
+    PromotionRule free;
+    free.kind = PromotionKind::CategoryPercent;
+    free.category = 1;
+    free.percentBp = 10000;
+    promotions.addRule(free);
+
+    RegisterEngine engine;
+    engine.setPromotions(&promotions);
+    engine.receipt().addItem(ReceiptItem("Хліб", Money(2550), 2, Bread));
+    CHECK(engine.receipt().amountDue() == Money(0));
+
+    const PaymentState state = engine.paymentState();
+    CHECK(state.canApprove && state.changeState == ChangeState::Change && state.change == Money(0));
+    CHECK(engine.approve() == RegisterEngine::ApproveResult::Approved);
+    CHECK(engine.receipt().isEmpty());
+}
+
+// Approving an empty receipt records nothing, even with enough tendered.
+void testApproveEmptyReceipt() {
+    QTemporaryDir dir;
+    SalesLedger ledger;
+    CHECK(ledger.open(dir.filePath("ledger")));
+    RegisterEngine engine;
+    engine.setLedger(&ledger);
+    engine.tender(Money(10000));
+    CHECK(engine.approve() == RegisterEngine::ApproveResult::Empty);
+    CHECK(ledger.lastSaleId() == 0);
+    CHECK(ledger.dailyTotals(QDate::currentDate()).receiptCount == 0);
+}
+
+// Voids go to the ledger between the sales without counting in their totals.
+void testVoidsRecorded() {
+    QTemporaryDir dir;
+    const QDate today = QDate::currentDate();
+    SalesLedger ledger;
+    CHECK(ledger.open(dir.filePath("ledger")));
+    RegisterEngine engine;
+    engine.setLedger(&ledger);
+    engine.setSupervisor("Коваленко");
+
+    engine.receipt().addItems({ ReceiptItem("Хліб", Money(2550), 2), ReceiptItem("Молоко", Money(4200), 1) });
+    CHECK(engine.removeLine(1));
+    engine.decline();
+    engine.receipt().addItem(ReceiptItem("Сир", Money(12999), 1));
+    engine.tender(Money(13000));
+    CHECK(engine.approve() == RegisterEngine::ApproveResult::Approved);
+
+    CHECK(engine.voids().size() == 2);
+    std::vector<VoidRecord> voids;
+    CHECK(ledger.forEachVoid(today, [&voids](const VoidRecord& record) { voids.push_back(record); }));
+    CHECK(voids.size() == 2);
+    if (voids.size() == 2) {
+        CHECK(voids[0].kind == VoidKind::Line && voids[0].row == 1);
+        CHECK(voids[0].item.name() == "Молоко" && voids[0].item.price() == Money(4200));
+        CHECK(voids[0].supervisor == "Коваленко");
+        CHECK(voids[0].lineCount == 2 && voids[0].subtotal == Money(9300) && voids[0].itemCount == 3);
+        CHECK(voids[1].kind == VoidKind::Receipt && voids[1].row == -1);
+        CHECK(voids[1].lineCount == 1 && voids[1].subtotal == Money(5100));
+        CHECK(voids[1].saleId == voids[0].saleId);
+    }
+
+    const DailyTotals totals = ledger.recomputeDailyTotals(today);
+    CHECK(totals.receiptCount == 1 && totals.gross == 12999);
+}
+
+int main() {
+    testInsertSplitsFullChunk();
+    testMoveAcrossChunks();
+    testRandomEdits();
+    testSubtotalOverflow();
+    testLineIndexAfterRemoval();
+    testMulDivWide();
+    testFromString();
+    testWeightRounding();
+    testScaleLabel();
+    testWeighedEntry();
+    testCatalogNameBounds();
+    testCatalogSearchIndexChecked();
+    testApproveAfterCrash();
+    testStaleTotalsRebuilt();
+    testLedgerDiscount();
+    testApproveEmptyReceipt();
+    testVoidsRecorded();
+    testFullyDiscountedReceipt();
+    testOverlappingPromotions();
+    testRestoreAfterTruncation();
+    testRestoreDuplicateLines();
+    testRestoreJournalsDiff();
+    testJournalWakesWriter();
+#ifdef __linux__
+    testJournalWriteFailure();
+#endif
+    testLargeRemovalJournaled();
+
+    if (g_failures > 0) {
+        QTextStream(stderr) << g_failures << " check(s) failed\n";
+        return EXIT_FAILURE;
+    }
+    QTextStream(stdout) << "All tests passed\n";
+    return EXIT_SUCCESS;
+}
@@ -1,16 +1,156 @@
 #include "CashRegisterWindow.h"
+#include "ReceiptItemDelegate.h"
+#include "MacroManager.h"
+#include "StartupTrace.h"
+#include "ProductSearchModel.h"
 #include <QButtonGroup>
 #include <QMessageBox>
 #include <QRegularExpressionValidator>
 #include <QHBoxLayout>
+#include <QCoreApplication>
+#include <QDir>
+#include <QStyle>
+#include <QTimer>
+#include <QLabel>
+#include <QShortcut>
+#include <QKeySequence>
+#include <QEvent>
+#include <QKeyEvent>
+#include <QLineEdit>
+#include <QListView>
+#include <algorithm>
+
+namespace {
+
+// Applied once, to the whole window.
+const char* const registerStyleSheet = R"(
+    QMainWindow { background-color: #F5F5F7; }
+    QLabel { color: #1D1D1F; font-family: "Segoe UI", "Helvetica Neue", sans-serif; }
+    QTableView {
+        background-color: #FFFFFF;
+        alternate-background-color: #FAFAFA;
+        gridline-color: #EBEBEB;
+        border: 1px solid #D2D2D7;
+        border-radius: 8px;
+        color: #1D1D1F;
+        selection-background-color: #E8F0FE;
+        selection-color: #1D1D1F;
+    }
+    QHeaderView::section {
+        background-color: #FFFFFF;
+        padding: 8px;
+        border: none;
+        border-bottom: 1px solid #D2D2D7;
+        font-weight: 600;
+        color: #86868B;
+    }
+    QPushButton {
+        background-color: #FFFFFF;
+        border: 1px solid #D2D2D7;
+        border-radius: 8px;
+        padding: 4px;
+        color: #1D1D1F;
+        font-weight: 600;
+    }
+    QPushButton:hover { background-color: #F5F5F7; }
+    QPushButton:pressed { background-color: #EBEBEB; }
+    QPushButton[text="0"], QPushButton[text="1"], QPushButton[text="2"],
+    QPushButton[text="3"], QPushButton[text="4"], QPushButton[text="5"],
+    QPushButton[text="6"], QPushButton[text="7"], QPushButton[text="8"],
+    QPushButton[text="9"], QPushButton[text="."], QPushButton[text="<-"] {
+        font-size: 22px;
+        background-color: #FFFFFF;
+        border: 1px solid #E5E5EA;
+        padding: 0px;
+    }
+    QPushButton#btn_enter, QPushButton#btnApprove {
+        background-color: #007AFF;
+        color: white;
+        border: none;
+    }
+    QPushButton#btn_enter:hover, QPushButton#btnApprove:hover { background-color: #0062CC; }
+    QPushButton#btn_enter:pressed, QPushButton#btnApprove:pressed { background-color: #0051A8; }
+    QPushButton#btn_clear, QPushButton#btnDecline, QPushButton#btnDeleteItem {
+        background-color: transparent;
+        color: #FF3B30;
+        border: 1px solid #FF3B30;
+    }
+    QPushButton#btn_clear:hover, QPushButton#btnDecline:hover, QPushButton#btnDeleteItem:hover { background-color: #FFF0F0; }
+    QPushButton#btn_clear:pressed, QPushButton#btnDecline:pressed, QPushButton#btnDeleteItem:pressed { background-color: #FFE5E5; }
+    QLineEdit {
+        background-color: #FFFFFF;
+        border: 1px solid #D2D2D7;
+        border-radius: 8px;
+        padding: 8px;
+        font-size: 20px;
+        color: #1D1D1F;
+    }
+    QLineEdit:focus { border: 2px solid #007AFF; }
+
+    QLabel#labelChange[changeState="insufficient"] { color: red; font-weight: bold; }
+    QLabel#labelChange[changeState="change"] { color: #007AFF; font-weight: bold; }
+
+    QPushButton#btnMacro {
+        background-color: #E8F0FE;
+        color: #007AFF;
+        border: 1px solid #007AFF;
+        padding: 8px;
+    }
+    QPushButton#btnMacro:hover { background-color: #D2E3FC; }
+
+    QLineEdit#searchEdit { font-size: 16px; }
+    QListView#searchList {
+        background-color: #FFFFFF;
+        border: 1px solid #D2D2D7;
+        font-size: 16px;
+        color: #1D1D1F;
+        selection-background-color: #E8F0FE;
+        selection-color: #1D1D1F;
+    }
+
+    QLabel#latencyOverlay {
+        background-color: rgba(29, 29, 31, 200);
+        color: #FFFFFF;
+        font-family: "Consolas", "DejaVu Sans Mono", monospace;
+        font-size: 11px;
+        padding: 8px;
+        border-radius: 8px;
+    }
+)";
+
+}
 
 CashRegisterWindow::CashRegisterWindow(QWidget *parent)
     : QMainWindow(parent),
-    m_tableModel(new ReceiptTableModel(this)),
-    m_tenderedAmount(0),
-    m_macroManager(new MacroManager(this))
+    m_tableModel(new ReceiptTableModel(m_register.receipt(), this)),
+    m_macroManager(nullptr),
+    m_financialsTimer(new QTimer(this)),
+    m_panelRendered(false),
+    m_confirmations(true),
+    m_latencyOverlay(nullptr),
+    m_latencyOverlayTimer(nullptr),
+    m_latencyExportTimer(nullptr),
+    m_latencyFromEnvironment(false),
+    m_latencyPaintActive(false),
+    m_startupScheduled(false),
+    m_searchEdit(nullptr),
+    m_searchList(nullptr),
+    m_searchModel(nullptr)
 {
-    ui.setupUi(this);
+    // Styling the bare window first polishes each widget once as setupUi()
+    // creates it, instead of building the tree and re-polishing all of it.
+    {
+        StartupTrace::Phase phase("styleSheet");
+        setStyleSheet(registerStyleSheet);
+    }
+    {
+        StartupTrace::Phase phase("setupUi");
+        ui.setupUi(this);
+    }
+
+    m_financialsTimer->setSingleShot(true);
+    m_financialsTimer->setInterval(0);
+    connect(m_financialsTimer, &QTimer::timeout, this, &CashRegisterWindow::updateFinancials);
 
     std::vector<ReceiptItem> initialItems = {
         { "Еспресо", 35.00_UAH, 1 },
@@ -19,22 +159,42 @@ CashRegisterWindow::CashRegisterWindow(QWidget *parent)
         { "Сирник", 70.00_UAH, 1 }
     };
 
-    m_tableModel->setItems(initialItems);
-    ui.receiptTableView->setModel(m_tableModel);
-
-    ui.receiptTableView->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
-    ui.receiptTableView->setSelectionBehavior(QAbstractItemView::SelectRows);
-    ui.receiptTableView->setSelectionMode(QAbstractItemView::SingleSelection);
-    ui.receiptTableView->verticalHeader()->setVisible(false);
-    ui.receiptTableView->setEditTriggers(QAbstractItemView::NoEditTriggers);
-    ui.receiptTableView->setAlternatingRowColors(true);
+    // Recovery asks the ledger whether the journaled receipt was recorded.
+    {
+        StartupTrace::Phase phase("openLedger");
+        openLedger();
+    }
+    {
+        StartupTrace::Phase phase("restoreFromJournal");
+        if (!restoreFromJournal()) {
+            m_register.receipt().setItems(initialItems);
+        }
+    }
+    {
+        StartupTrace::Phase phase("receiptView");
+        setupReceiptView();
+    }
 
     connect(m_tableModel, &ReceiptTableModel::totalsChanged, this, &CashRegisterWindow::onTotalsChanged);
+    connect(ui.receiptTableView->selectionModel(), &QItemSelectionModel::selectionChanged, this, [this]() {
+        if (!m_macroManager || !m_macroManager->isRecordingActions()) return;
+        const bool selected = ui.receiptTableView->selectionModel()->hasSelection();
+        recordAction(MacroAction::SelectRow, selected ? ui.receiptTableView->currentIndex().row() : -1);
+    });
 
     setupNumpad();
-    setupMacroUI();
+    setupReceiptShortcuts();
+    {
+        StartupTrace::Phase phase("openCatalog");
+        openCatalog();
+    }
+    {
+        StartupTrace::Phase phase("openPromotions");
+        openPromotions();
+    }
 
-    QRegularExpression rx("^[0-9]{1,6}([.,][0-9]{1,2})?");
+    // Either a tender amount or a scanned EAN-8/EAN-13/UPC/GTIN-14 barcode.
+    QRegularExpression rx("^([0-9]{1,6}([.,][0-9]{1,2})?|[0-9]{8,14})$");
     QValidator *moneyValidator = new QRegularExpressionValidator(rx, this);
     ui.lineEdit->setValidator(moneyValidator);
 
@@ -44,84 +204,63 @@ CashRegisterWindow::CashRegisterWindow(QWidget *parent)
     ui.gridLayout->setContentsMargins(0, 20, 0, 20);
 
     updateFinancials();
+}
 
-    QString minimalistStyle = R"(
-        QMainWindow { background-color: #F5F5F7; }
-        QLabel { color: #1D1D1F; font-family: "Segoe UI", "Helvetica Neue", sans-serif; }
-        QTableView {
-            background-color: #FFFFFF;
-            alternate-background-color: #FAFAFA;
-            gridline-color: #EBEBEB;
-            border: 1px solid #D2D2D7;
-            border-radius: 8px;
-            color: #1D1D1F;
-            selection-background-color: #E8F0FE;
-            selection-color: #1D1D1F;
-        }
-        QHeaderView::section {
-            background-color: #FFFFFF;
-            padding: 8px;
-            border: none;
-            border-bottom: 1px solid #D2D2D7;
-            font-weight: 600;
-            color: #86868B;
-        }
-        QPushButton {
-            background-color: #FFFFFF;
-            border: 1px solid #D2D2D7;
-            border-radius: 8px;
-            padding: 4px;
-            color: #1D1D1F;
-            font-weight: 600;
-        }
-        QPushButton:hover { background-color: #F5F5F7; }
-        QPushButton:pressed { background-color: #EBEBEB; }
-        QPushButton[text="0"], QPushButton[text="1"], QPushButton[text="2"],
-        QPushButton[text="3"], QPushButton[text="4"], QPushButton[text="5"],
-        QPushButton[text="6"], QPushButton[text="7"], QPushButton[text="8"],
-        QPushButton[text="9"], QPushButton[text="."], QPushButton[text="<-"] {
-            font-size: 22px;
-            background-color: #FFFFFF;
-            border: 1px solid #E5E5EA;
-            padding: 0px;
-        }
-        QPushButton#btn_enter, QPushButton#btnApprove {
-            background-color: #007AFF;
-            color: white;
-            border: none;
-        }
-        QPushButton#btn_enter:hover, QPushButton#btnApprove:hover { background-color: #0062CC; }
-        QPushButton#btn_enter:pressed, QPushButton#btnApprove:pressed { background-color: #0051A8; }
-        QPushButton#btn_clear, QPushButton#btnDecline, QPushButton#btnDeleteItem {
-            background-color: transparent;
-            color: #FF3B30;
-            border: 1px solid #FF3B30;
-        }
-        QPushButton#btn_clear:hover, QPushButton#btnDecline:hover, QPushButton#btnDeleteItem:hover { background-color: #FFF0F0; }
-        QPushButton#btn_clear:pressed, QPushButton#btnDecline:pressed, QPushButton#btnDeleteItem:pressed { background-color: #FFE5E5; }
-        QLineEdit {
-            background-color: #FFFFFF;
-            border: 1px solid #D2D2D7;
-            border-radius: 8px;
-            padding: 8px;
-            font-size: 20px;
-            color: #1D1D1F;
-        }
-        QLineEdit:focus { border: 2px solid #007AFF; }
+CashRegisterWindow::~CashRegisterWindow() {
+    if (m_latency.isEnabled()) exportLatency();
+    // The model adapts m_register's receipt, so it must go before the
+    // members do rather than with the other children.
+    delete m_tableModel;
+}
 
-        QPushButton#btnMacro {
-            background-color: #E8F0FE;
-            color: #007AFF;
-            border: 1px solid #007AFF;
-            padding: 8px;
-        }
-        QPushButton#btnMacro:hover { background-color: #D2E3FC; }
-    )";
+// Bulk receipts run to 100k+ lines, so the table never measures rows: heights
+// are fixed, rows arrive through fetchMore() and the delegate paints cached
+// static text, alternating row colours included.
+void CashRegisterWindow::setupReceiptView() {
+    QTableView* view = ui.receiptTableView;
+    ReceiptItemDelegate::install(view, m_tableModel);
+    view->viewport()->installEventFilter(this);
+
+    view->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    view->verticalHeader()->setVisible(false);
+    view->setSelectionBehavior(QAbstractItemView::SelectRows);
+    view->setSelectionMode(QAbstractItemView::SingleSelection);
+    view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+}
+
+// The payment form and the receipt are all a cashier needs to start serving;
+// the macro and report bars and the latency overlay are built once the first
+// frame is on screen and the event loop is idle.
+void CashRegisterWindow::completeStartup() {
+    StartupTrace::mark("interactive");
+    {
+        StartupTrace::Phase phase("productSearch");
+        setupProductSearch();
+    }
+    {
+        StartupTrace::Phase phase("macroUI");
+        setupMacroUI();
+    }
+    {
+        StartupTrace::Phase phase("reportUI");
+        setupReportUI();
+    }
+    {
+        StartupTrace::Phase phase("latencyMonitor");
+        setupLatencyMonitor();
+    }
+    StartupTrace::finish();
+}
 
-    this->setStyleSheet(minimalistStyle);
+MacroManager& CashRegisterWindow::macros() {
+    if (!m_macroManager) m_macroManager = new MacroManager(this);
+    return *m_macroManager;
 }
 
-CashRegisterWindow::~CashRegisterWindow() = default;
+// Nothing is being recorded before the macro manager exists.
+void CashRegisterWindow::recordAction(MacroAction action, int32_t argument, const QString& text) {
+    if (m_macroManager) m_macroManager->recordAction(action, argument, text);
+}
 
 void CashRegisterWindow::setupMacroUI() {
     QHBoxLayout* macroLayout = new QHBoxLayout();
@@ -130,16 +269,19 @@ void CashRegisterWindow::setupMacroUI() {
     QPushButton* btnStop = new QPushButton("⏹ Зупинити", this);
     QPushButton* btnPlay = new QPushButton("▶️ Відтворити", this);
     QPushButton* btnPlayLoop = new QPushButton("🔁 Відтворити циклічно", this);
+    QPushButton* btnRecordActions = new QPushButton("📝 Запис дій", this);
 
     btnRecord->setObjectName("btnMacro");
     btnStop->setObjectName("btnMacro");
     btnPlay->setObjectName("btnMacro");
     btnPlayLoop->setObjectName("btnMacro");
+    btnRecordActions->setObjectName("btnMacro");
 
     macroLayout->addWidget(btnRecord);
     macroLayout->addWidget(btnStop);
     macroLayout->addWidget(btnPlay);
     macroLayout->addWidget(btnPlayLoop);
+    macroLayout->addWidget(btnRecordActions);
 
     if (QVBoxLayout* mainLayout = qobject_cast<QVBoxLayout*>(ui.centralWidget->layout())) {
         mainLayout->addLayout(macroLayout);
@@ -149,23 +291,262 @@ void CashRegisterWindow::setupMacroUI() {
     connect(btnStop, &QPushButton::clicked, this, &CashRegisterWindow::on_btnStopMacro_clicked);
     connect(btnPlay, &QPushButton::clicked, this, &CashRegisterWindow::on_btnPlayMacro_clicked);
     connect(btnPlayLoop, &QPushButton::clicked, this, &CashRegisterWindow::on_btnPlayLoopMacro_clicked);
+    connect(btnRecordActions, &QPushButton::clicked, this, &CashRegisterWindow::onRecordActionsClicked);
 }
 
 void CashRegisterWindow::on_btnRecordMacro_clicked() {
-    m_macroManager->startRecording("macro.txt");
+    macros().startRecording("macro.crm");
 }
 
 void CashRegisterWindow::on_btnStopMacro_clicked() {
+    if (!m_macroManager) return;
     m_macroManager->stopRecording();
     m_macroManager->stopPlaying();
 }
 
 void CashRegisterWindow::on_btnPlayMacro_clicked() {
-    m_macroManager->startPlaying("macro.txt", false);
+    macros().startPlaying("macro.crm", false, macroPlaybackSpeed());
 }
 
 void CashRegisterWindow::on_btnPlayLoopMacro_clicked() {
-    m_macroManager->startPlaying("macro.txt", true);
+    macros().startPlaying("macro.crm", true, macroPlaybackSpeed());
+}
+
+void CashRegisterWindow::onRecordActionsClicked() {
+    macros().startActionRecording("actions.cra");
+}
+
+void CashRegisterWindow::applyAction(const ActionRecord& record) {
+    switch (record.action) {
+    case MacroAction::Numpad:
+        onNumpadClicked(record.argument);
+        break;
+    case MacroAction::Enter:
+        ui.lineEdit->setText(record.text);
+        on_btn_enter_clicked();
+        break;
+    case MacroAction::Clear:
+        on_btn_clear_clicked();
+        break;
+    case MacroAction::DeleteItem:
+        on_btnDeleteItem_clicked();
+        break;
+    case MacroAction::Approve:
+        on_btnApprove_clicked();
+        break;
+    case MacroAction::Decline:
+        on_btnDecline_clicked();
+        break;
+    case MacroAction::SelectRow:
+        if (record.argument >= 0 && record.argument < m_tableModel->rowCount()) {
+            ui.receiptTableView->selectRow(record.argument);
+        } else {
+            ui.receiptTableView->clearSelection();
+        }
+        break;
+    case MacroAction::Undo:
+        onUndo();
+        break;
+    case MacroAction::Redo:
+        onRedo();
+        break;
+    case MacroAction::Suspend:
+        onSuspendReceipt();
+        break;
+    case MacroAction::Resume:
+        resumeReceipt(record.argument);
+        break;
+    }
+}
+
+void CashRegisterWindow::setConfirmationsEnabled(bool enabled) {
+    m_confirmations = enabled;
+}
+
+bool CashRegisterWindow::confirm(const QString& title, const QString& text) {
+    if (!m_confirmations) return true;
+    return QMessageBox::question(this, title, text, QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes;
+}
+
+// CASHREGISTER_MACRO_SPEED scales playback for stress runs: "0.5", "10" or "max".
+double CashRegisterWindow::macroPlaybackSpeed() const {
+    const QString value = qEnvironmentVariable("CASHREGISTER_MACRO_SPEED");
+    if (value == "max") return MacroManager::AsFastAsPossible;
+
+    bool ok = false;
+    const double speed = value.toDouble(&ok);
+    return ok && speed > 0.0 ? speed : 1.0;
+}
+
+// Rebuilds the receipt that was open when the register last stopped, then
+// starts journaling new mutations. Returns false if there was nothing to restore.
+bool CashRegisterWindow::restoreFromJournal() {
+    QString path = qEnvironmentVariable("CASHREGISTER_JOURNAL");
+    if (path.isEmpty()) {
+        path = QDir(QCoreApplication::applicationDirPath()).filePath("receipt.journal");
+    }
+
+    // Read before open() trims a torn tail; the journal is attached first so
+    // a receipt the ledger already holds is closed in it.
+    const std::vector<JournalEntry> entries = ReceiptJournal::readOpenReceipt(path);
+    if (m_journal.open(path)) {
+        m_register.setJournal(&m_journal);
+    }
+    return m_register.restore(entries);
+}
+
+void CashRegisterWindow::openPromotions() {
+    QString path = qEnvironmentVariable("CASHREGISTER_PROMOTIONS");
+    if (path.isEmpty()) {
+        path = QDir(QCoreApplication::applicationDirPath()).filePath("promotions.csv");
+    }
+    if (!QFile::exists(path)) return;
+
+    // A file that fails part way would leave only the rules before the error,
+    // which can discount differently from the whole set; run without any.
+    QString error;
+    if (!m_promotions.load(path, &error)) {
+        m_promotions.clearRules();
+        qWarning("Promotions disabled: %s", qPrintable(error));
+    }
+    m_register.setPromotions(&m_promotions);
+}
+
+void CashRegisterWindow::openLedger() {
+    QString path = qEnvironmentVariable("CASHREGISTER_LEDGER");
+    if (path.isEmpty()) {
+        path = QDir(QCoreApplication::applicationDirPath()).filePath("ledger");
+    }
+    m_ledger.open(path);
+    m_register.setLedger(&m_ledger);
+}
+
+void CashRegisterWindow::setupReportUI() {
+    QPushButton* btnZReport = new QPushButton("📊 Z-звіт", this);
+    btnZReport->setObjectName("btnMacro");
+
+    if (QVBoxLayout* mainLayout = qobject_cast<QVBoxLayout*>(ui.centralWidget->layout())) {
+        QHBoxLayout* reportLayout = new QHBoxLayout();
+        reportLayout->addStretch();
+        reportLayout->addWidget(btnZReport);
+        mainLayout->addLayout(reportLayout);
+    }
+
+    connect(btnZReport, &QPushButton::clicked, this, &CashRegisterWindow::onZReportClicked);
+}
+
+// F12 toggles a live latency overlay. Histograms are collected only while it
+// is visible, or for the whole session when CASHREGISTER_LATENCY=1, in which
+// case they are also exported periodically to CASHREGISTER_LATENCY_LOG.
+void CashRegisterWindow::setupLatencyMonitor() {
+    m_latencyOverlay = new QLabel(this);
+    m_latencyOverlay->setObjectName("latencyOverlay");
+    m_latencyOverlay->setAttribute(Qt::WA_TransparentForMouseEvents);
+    m_latencyOverlay->hide();
+
+    m_latencyOverlayTimer = new QTimer(this);
+    m_latencyOverlayTimer->setInterval(500);
+    connect(m_latencyOverlayTimer, &QTimer::timeout, this, &CashRegisterWindow::refreshLatencyOverlay);
+
+    QShortcut* toggle = new QShortcut(QKeySequence(Qt::Key_F12), this);
+    connect(toggle, &QShortcut::activated, this, &CashRegisterWindow::toggleLatencyOverlay);
+
+    m_latencyExportPath = qEnvironmentVariable("CASHREGISTER_LATENCY_LOG");
+    if (m_latencyExportPath.isEmpty()) {
+        m_latencyExportPath = QDir(QCoreApplication::applicationDirPath()).filePath("latency.json");
+    }
+
+    m_latencyExportTimer = new QTimer(this);
+    m_latencyExportTimer->setInterval(60 * 1000);
+    connect(m_latencyExportTimer, &QTimer::timeout, this, &CashRegisterWindow::exportLatency);
+
+    m_latencyFromEnvironment = qEnvironmentVariableIntValue("CASHREGISTER_LATENCY") != 0;
+    if (m_latencyFromEnvironment) {
+        m_latency.setEnabled(true);
+        m_latencyExportTimer->start();
+    }
+}
+
+void CashRegisterWindow::toggleLatencyOverlay() {
+    const bool show = !m_latencyOverlay->isVisible();
+    m_latency.setEnabled(show || m_latencyFromEnvironment);
+
+    if (show) {
+        refreshLatencyOverlay();
+        m_latencyOverlay->show();
+        m_latencyOverlay->raise();
+        m_latencyOverlayTimer->start();
+    } else {
+        m_latencyOverlayTimer->stop();
+        m_latencyOverlay->hide();
+    }
+}
+
+void CashRegisterWindow::refreshLatencyOverlay() {
+    m_latencyOverlay->setText(m_latency.summary());
+    m_latencyOverlay->adjustSize();
+    m_latencyOverlay->move(width() - m_latencyOverlay->width() - 12, 12);
+}
+
+void CashRegisterWindow::exportLatency() {
+    m_latency.exportTo(m_latencyExportPath);
+}
+
+// The receipt table paints inside its viewport's paint event; re-dispatching
+// that event from here is the only way to time it without subclassing the view.
+// Its first paint also finishes start-up on the next turn of the event loop.
+bool CashRegisterWindow::eventFilter(QObject* watched, QEvent* event) {
+    if (event->type() == QEvent::KeyPress && watched == m_searchEdit
+        && handleSearchKey(static_cast<QKeyEvent*>(event)->key())) {
+        return true;
+    }
+    if (event->type() == QEvent::Paint && !m_startupScheduled && watched == ui.receiptTableView->viewport()) {
+        m_startupScheduled = true;
+        StartupTrace::mark("firstPaint");
+        QTimer::singleShot(0, this, &CashRegisterWindow::completeStartup);
+    }
+    if (event->type() == QEvent::Paint && !m_latencyPaintActive && m_latency.isEnabled()
+        && watched == ui.receiptTableView->viewport()) {
+        LatencyScope latency(m_latency, LatencyProbe::TablePaint);
+        m_latencyPaintActive = true;
+        QCoreApplication::sendEvent(watched, event);
+        m_latencyPaintActive = false;
+        return true;
+    }
+    return QMainWindow::eventFilter(watched, event);
+}
+
+void CashRegisterWindow::onZReportClicked() {
+    // The report closes the day, so its totals are rebuilt from the segments
+    // through the batch kernels instead of read from the running ones.
+    const DailyTotals totals = m_ledger.recomputeDailyTotals(QDate::currentDate());
+    QString report = QString("Чеків: %1\nТоварів: %2\nПродажі: %3\nЗнижки: %4\nВиручка: %5\nГотівкою: %6\nРешта: %7")
+        .arg(static_cast<qulonglong>(totals.receiptCount))
+        .arg(static_cast<qulonglong>(totals.itemCount))
+        .arg(Money(totals.gross).toString())
+        .arg(Money(totals.discount).toString())
+        .arg(Money(SaturatingMoney(totals.gross) - SaturatingMoney(totals.discount)).toString())
+        .arg(Money(totals.tendered).toString())
+        .arg(Money(totals.change).toString());
+
+    // Arena memory of the receipts rung up since start-up.
+    const ReceiptMemoryUsage memory = m_register.receipt().memoryUsage();
+    if (memory.receipts > 0) {
+        report += QString("\n\nПам'ять чека: пік %1 КіБ, середньо %2 КіБ, зарезервовано %3 КіБ")
+            .arg(memory.maxPeakBytes / 1024.0, 0, 'f', 1)
+            .arg(memory.averagePeakBytes / 1024.0, 0, 'f', 1)
+            .arg(memory.reservedBytes / 1024.0, 0, 'f', 1);
+    }
+    QMessageBox::information(this, "Z-звіт", report);
+}
+
+void CashRegisterWindow::openCatalog() {
+    QString path = qEnvironmentVariable("CASHREGISTER_CATALOG");
+    if (path.isEmpty()) {
+        path = QDir(QCoreApplication::applicationDirPath()).filePath("catalog.bin");
+    }
+    m_catalog.open(path);
+    m_register.setCatalog(&m_catalog);
 }
 
 void CashRegisterWindow::setupNumpad() {
@@ -180,117 +561,299 @@ void CashRegisterWindow::setupNumpad() {
     numpadGroup->addButton(ui.btnNumpad_7, 7);
     numpadGroup->addButton(ui.btnNumpad_8, 8);
     numpadGroup->addButton(ui.btnNumpad_9, 9);
-    numpadGroup->addButton(ui.btnNumpadBackspace, KeyBackspace);
-    numpadGroup->addButton(ui.btnNumpadPoint, KeyPoint);
+    numpadGroup->addButton(ui.btnNumpadBackspace, RegisterEngine::KeyBackspace);
+    numpadGroup->addButton(ui.btnNumpadPoint, RegisterEngine::KeyPoint);
 
     connect(numpadGroup, &QButtonGroup::idClicked, this, &CashRegisterWindow::onNumpadClicked);
 }
 
-void CashRegisterWindow::onNumpadClicked(int id) {
-    QString currentText = ui.lineEdit->text();
+// Function keys rather than Ctrl+Z/Ctrl+Y, which the focused input line keeps
+// for its own text. F7/F8 step through line changes, F9 parks the open receipt
+// and F10 brings back the oldest parked one.
+void CashRegisterWindow::setupReceiptShortcuts() {
+    connect(new QShortcut(QKeySequence(Qt::Key_F7), this), &QShortcut::activated, this, &CashRegisterWindow::onUndo);
+    connect(new QShortcut(QKeySequence(Qt::Key_F8), this), &QShortcut::activated, this, &CashRegisterWindow::onRedo);
+    connect(new QShortcut(QKeySequence(Qt::Key_F9), this), &QShortcut::activated,
+            this, &CashRegisterWindow::onSuspendReceipt);
+    connect(new QShortcut(QKeySequence(Qt::Key_F10), this), &QShortcut::activated, this, [this]() {
+        resumeReceipt(0);
+    });
+}
 
-    if (id == KeyBackspace) {
-        if (!currentText.isEmpty()) currentText.chop(1);
+// F3 or a click on the search line finds products by name; the matches drop
+// down below it as the cashier types, and Enter or a click adds one to the
+// receipt exactly as if its barcode had been scanned.
+void CashRegisterWindow::setupProductSearch() {
+    m_searchEdit = new QLineEdit(this);
+    m_searchEdit->setObjectName("searchEdit");
+    m_searchEdit->setPlaceholderText("Пошук товару за назвою (F3)");
+    m_searchEdit->setClearButtonEnabled(true);
+    m_searchEdit->setEnabled(m_catalog.hasSearchIndex());
+    m_searchEdit->installEventFilter(this);
+    if (QVBoxLayout* mainLayout = qobject_cast<QVBoxLayout*>(ui.centralWidget->layout())) {
+        mainLayout->insertWidget(0, m_searchEdit);
     }
-    else if (id == KeyPoint) {
-        if (!currentText.contains(".") && !currentText.contains(",")) {
-            currentText += (currentText.isEmpty() ? "0." : ".");
-        }
+
+    m_searchModel = new ProductSearchModel(this);
+    m_searchModel->setCatalog(&m_catalog);
+
+    m_searchList = new QListView(this);
+    m_searchList->setObjectName("searchList");
+    m_searchList->setModel(m_searchModel);
+    m_searchList->setFocusPolicy(Qt::NoFocus);
+    m_searchList->setUniformItemSizes(true);
+    m_searchList->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_searchList->hide();
+
+    connect(m_searchEdit, &QLineEdit::textChanged, this, &CashRegisterWindow::onSearchEdited);
+    connect(m_searchList, &QListView::clicked, this, &CashRegisterWindow::addSearchResult);
+    connect(new QShortcut(QKeySequence(Qt::Key_F3), this), &QShortcut::activated, this, [this]() {
+        m_searchEdit->setFocus();
+        m_searchEdit->selectAll();
+    });
+}
+
+void CashRegisterWindow::onSearchEdited(const QString& text) {
+    {
+        LatencyScope latency(m_latency, LatencyProbe::Search);
+        m_searchModel->setQuery(text);
+    }
+
+    const int rows = m_searchModel->rowCount();
+    if (rows == 0) {
+        m_searchList->hide();
+        return;
+    }
+
+    constexpr int VisibleRows = 8;
+    const int height = std::min(rows, VisibleRows) * m_searchList->sizeHintForRow(0) + 2 * m_searchList->frameWidth();
+    m_searchList->setGeometry(QRect(m_searchEdit->mapTo(this, QPoint(0, m_searchEdit->height())),
+                                    QSize(m_searchEdit->width(), height)));
+    m_searchList->setCurrentIndex(m_searchModel->index(0));
+    m_searchList->show();
+    m_searchList->raise();
+}
+
+// Up and Down walk the list, Enter adds the current match and Escape gives
+// the keyboard back to the payment line; other keys edit the query.
+bool CashRegisterWindow::handleSearchKey(int key) {
+    switch (key) {
+    case Qt::Key_Up:
+    case Qt::Key_Down: {
+        const int rows = m_searchModel->rowCount();
+        if (rows == 0) return false;
+        const int row = m_searchList->currentIndex().row() + (key == Qt::Key_Down ? 1 : -1);
+        m_searchList->setCurrentIndex(m_searchModel->index(std::clamp(row, 0, rows - 1)));
+        return true;
     }
-    else {
-        if (currentText == "0") currentText = QString::number(id);
-        else currentText += QString::number(id);
+    case Qt::Key_Return:
+    case Qt::Key_Enter:
+        addSearchResult(m_searchList->currentIndex());
+        return true;
+    case Qt::Key_Escape:
+        closeSearch();
+        return true;
+    default:
+        return false;
     }
+}
+
+void CashRegisterWindow::addSearchResult(const QModelIndex& index) {
+    if (!index.isValid()) return;
+    const qulonglong barcode = index.data(ProductSearchModel::BarcodeRole).toULongLong();
+
+    // Entered as a scan: a selected row would take it as a quantity, and
+    // RegisterEngine reads anything under eight digits as a tender amount.
+    ui.receiptTableView->clearSelection();
+    ui.lineEdit->setText(QString::number(barcode).rightJustified(8, '0'));
+    on_btn_enter_clicked();
+    closeSearch();
+}
 
-    ui.lineEdit->setText(currentText);
+void CashRegisterWindow::closeSearch() {
+    m_searchEdit->clear();
+    m_searchList->hide();
+    ui.lineEdit->setFocus();
+}
+
+void CashRegisterWindow::onUndo() {
+    recordAction(MacroAction::Undo);
+    m_register.undo();
+}
+
+void CashRegisterWindow::onRedo() {
+    recordAction(MacroAction::Redo);
+    m_register.redo();
+}
+
+void CashRegisterWindow::onSuspendReceipt() {
+    recordAction(MacroAction::Suspend);
+    if (m_register.suspend()) resetInput();
+}
+
+void CashRegisterWindow::resumeReceipt(int index) {
+    recordAction(MacroAction::Resume, index);
+    if (m_register.resume(index)) resetInput();
+}
+
+void CashRegisterWindow::onNumpadClicked(int id) {
+    LatencyScope latency(m_latency, LatencyProbe::Numpad);
+    recordAction(MacroAction::Numpad, id);
+    ui.lineEdit->setText(RegisterEngine::numpadInput(ui.lineEdit->text(), id));
 }
 
 void CashRegisterWindow::onTotalsChanged() {
-    updateFinancials();
+    LatencyScope latency(m_latency, LatencyProbe::TotalsChanged);
+    scheduleFinancialsUpdate();
+}
+
+void CashRegisterWindow::scheduleFinancialsUpdate() {
+    if (!m_financialsTimer->isActive()) {
+        m_financialsTimer->start();
+    }
 }
 
 void CashRegisterWindow::updateFinancials() {
-    Money subtotal = m_tableModel->calculateSubtotal();
+    LatencyScope latency(m_latency, LatencyProbe::UpdateFinancials);
+    m_financialsTimer->stop();
 
-    ui.labelSubtotal->setText(subtotal.toString());
-    ui.labelAmountDue->setText(subtotal.toString());
-    ui.labelTendered->setText(m_tenderedAmount.toString());
+    const PaymentState state = m_register.paymentState();
+    const PaymentState& last = m_renderedPanel;
+    const bool force = !m_panelRendered;
 
-    if (m_tableModel->isEmpty() || subtotal.amount() == 0) {
-        ui.labelChange->setText("0.00 ₴");
-        ui.labelChange->setStyleSheet("");
-        ui.btnApprove->setEnabled(false);
-        return;
+    if (force || state.subtotal != last.subtotal) {
+        ui.labelSubtotal->setText(state.subtotal.toString());
     }
 
-    if (m_tenderedAmount < subtotal) {
-        Money missing = subtotal - m_tenderedAmount;
-        if (m_tenderedAmount.amount() > 0) {
-            ui.labelChange->setText("Недостатньо коштів (-" + missing.toString() + ")");
-            ui.labelChange->setStyleSheet("color: red; font-weight: bold;");
-        } else {
+    if (force || state.amountDue != last.amountDue) {
+        ui.labelAmountDue->setText(state.amountDue.toString());
+        // The discount lines behind the amount due, one per applied promotion.
+        QString discounts;
+        for (const AppliedDiscount& applied : m_register.receipt().appliedDiscounts()) {
+            if (!discounts.isEmpty()) discounts += '\n';
+            discounts += applied.name + ": -" + applied.amount.toString();
+        }
+        ui.labelAmountDue->setToolTip(discounts);
+    }
+
+    if (force || state.tendered != last.tendered) {
+        ui.labelTendered->setText(state.tendered.toString());
+    }
+
+    if (force || state.changeState != last.changeState || state.change != last.change) {
+        switch (state.changeState) {
+        case ChangeState::Neutral:
             ui.labelChange->setText("0.00 ₴");
-            ui.labelChange->setStyleSheet("");
+            break;
+        case ChangeState::Insufficient:
+            ui.labelChange->setText("Недостатньо коштів (-" + state.change.toString() + ")");
+            break;
+        case ChangeState::Change:
+            ui.labelChange->setText(state.change.toString());
+            break;
+        }
+    }
+
+    if (force || state.changeState != last.changeState) {
+        static const char* const styleStates[] = { "", "insufficient", "change" };
+        ui.labelChange->setProperty("changeState", styleStates[static_cast<int>(state.changeState)]);
+        ui.labelChange->style()->unpolish(ui.labelChange);
+        ui.labelChange->style()->polish(ui.labelChange);
+    }
+
+    if (force || state.canApprove != last.canApprove) {
+        ui.btnApprove->setEnabled(state.canApprove);
+    }
+
+    // Warned once per failure: the journal recovers at the next closed receipt.
+    if (!state.journalIntact && (force || last.journalIntact)) {
+        if (m_confirmations) {
+            QMessageBox::warning(this, "Помилка", "Не вдалося записати журнал чека. Якщо каса зараз зупиниться, "
+                                                  "поточний чек не відновиться. Перевірте місце на диску.");
+        } else {
+            qWarning("Failed to write the receipt journal; the open receipt cannot be recovered");
         }
-        ui.btnApprove->setEnabled(false);
-    } else {
-        Money change = m_tenderedAmount - subtotal;
-        ui.labelChange->setText(change.toString());
-        ui.labelChange->setStyleSheet("color: #007AFF; font-weight: bold;");
-        ui.btnApprove->setEnabled(true);
     }
+
+    m_renderedPanel = state;
+    m_panelRendered = true;
 }
 
-void CashRegisterWindow::resetPaymentState() {
-    m_tenderedAmount = Money(0);
+void CashRegisterWindow::resetInput() {
     ui.lineEdit->clear();
+    ui.receiptTableView->clearSelection();
+    scheduleFinancialsUpdate();
 }
 
 void CashRegisterWindow::on_btn_enter_clicked() {
-    if (ui.lineEdit->text().isEmpty()) return;
-
-    if (ui.receiptTableView->selectionModel()->hasSelection()) {
-        int newQuantity = ui.lineEdit->text().toInt();
-        if (newQuantity > 0) {
-            int selectedRow = ui.receiptTableView->currentIndex().row();
-            m_tableModel->updateQuantity(selectedRow, newQuantity);
+    LatencyScope latency(m_latency, LatencyProbe::Enter);
+    const QString text = ui.lineEdit->text();
+    if (text.isEmpty()) return;
+    recordAction(MacroAction::Enter, 0, text);
+
+    const bool selected = ui.receiptTableView->selectionModel()->hasSelection();
+    const int selectedRow = selected ? ui.receiptTableView->currentIndex().row() : -1;
+    switch (m_register.enter(text, selectedRow)) {
+    case RegisterEngine::EnterResult::ItemAdded:
+        ui.receiptTableView->scrollToBottom();
+        break;
+    case RegisterEngine::EnterResult::Tendered:
+        scheduleFinancialsUpdate();
+        break;
+    case RegisterEngine::EnterResult::TotalTooLarge:
+        if (m_confirmations) {
+            QMessageBox::warning(this, "Помилка", "Сума чека перевищила б допустиму; рядок не додано.");
+        } else {
+            qWarning("Receipt total would overflow; line refused");
         }
-        ui.receiptTableView->clearSelection();
-    } else {
-        m_tenderedAmount = Money::fromString(ui.lineEdit->text());
-        updateFinancials();
+        break;
+    case RegisterEngine::EnterResult::Ignored:
+    case RegisterEngine::EnterResult::QuantityChanged:
+    case RegisterEngine::EnterResult::UnknownBarcode:
+    case RegisterEngine::EnterResult::WeightRequired:
+        break;
     }
+    if (selected) ui.receiptTableView->clearSelection();
     ui.lineEdit->clear();
 }
 
 void CashRegisterWindow::on_btn_clear_clicked() {
+    recordAction(MacroAction::Clear);
     ui.lineEdit->clear();
     ui.receiptTableView->clearSelection();
 }
 
 void CashRegisterWindow::on_btnDeleteItem_clicked() {
     if (ui.receiptTableView->selectionModel()->hasSelection()) {
-        int selectedRow = ui.receiptTableView->currentIndex().row();
-        m_tableModel->removeItem(selectedRow);
+        recordAction(MacroAction::DeleteItem);
+        m_register.removeLine(ui.receiptTableView->currentIndex().row());
         ui.receiptTableView->clearSelection();
     }
 }
 
 void CashRegisterWindow::on_btnApprove_clicked() {
-    Money subtotal = m_tableModel->calculateSubtotal();
-    if (m_tenderedAmount < subtotal) return;
-
-    if (QMessageBox::question(this, "Підтвердження", "Підтвердити оплату?", QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes) {
-        m_tableModel->setItems({});
-        resetPaymentState();
-        updateFinancials();
+    if (m_register.receipt().isEmpty() || m_register.tendered() < m_register.receipt().amountDue()) return;
+
+    if (confirm("Підтвердження", "Підтвердити оплату?")) {
+        // Timed after the dialog so the cashier's reaction is not counted.
+        LatencyScope latency(m_latency, LatencyProbe::Approve);
+        recordAction(MacroAction::Approve);
+        if (m_register.approve() != RegisterEngine::ApproveResult::Approved) {
+            if (m_confirmations) {
+                QMessageBox::warning(this, "Помилка", "Не вдалося записати чек у журнал продажів.");
+            } else {
+                qWarning("Failed to append the receipt to the sales ledger");
+            }
+            return;
+        }
+        resetInput();
     }
 }
 
 void CashRegisterWindow::on_btnDecline_clicked() {
-    if (QMessageBox::question(this, "Відміна", "Скасувати поточний чек?", QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes) {
-        m_tableModel->setItems({});
-        resetPaymentState();
-        updateFinancials();
+    if (confirm("Відміна", "Скасувати поточний чек?")) {
+        recordAction(MacroAction::Decline);
+        m_register.decline();
+        resetInput();
     }
 }
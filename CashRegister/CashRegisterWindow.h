@@ -3,9 +3,20 @@
 #include <QtWidgets/QMainWindow>
 #include "ui_CashRegisterWindow.h"
 #include "ReceiptTableModel.h"
-#include "MacroManager.h"
+#include "RegisterEngine.h"
+#include "ProductCatalog.h"
+#include "PromotionEngine.h"
+#include "ReceiptJournal.h"
+#include "SalesLedger.h"
+#include "LatencyMonitor.h"
 
+class MacroManager;
+class ProductSearchModel;
 class QButtonGroup;
+class QLabel;
+class QLineEdit;
+class QListView;
+class QTimer;
 
 class CashRegisterWindow : public QMainWindow
 {
@@ -15,6 +26,14 @@ public:
     explicit CashRegisterWindow(QWidget *parent = nullptr);
     ~CashRegisterWindow() override;
 
+    // Headless replay support: applies one recorded action as if the cashier
+    // had performed it. Confirmation dialogs are answered "Yes" when disabled.
+    void applyAction(const ActionRecord& record);
+    void setConfirmationsEnabled(bool enabled);
+
+protected:
+    bool eventFilter(QObject* watched, QEvent* event) override;
+
 private slots:
     void on_btn_enter_clicked();
     void on_btn_clear_clicked();
@@ -23,25 +42,72 @@ private slots:
     void on_btnDecline_clicked();
     void onTotalsChanged();
     void onNumpadClicked(int id);
+    void onUndo();
+    void onRedo();
+    void onSuspendReceipt();
 
     void on_btnRecordMacro_clicked();
     void on_btnStopMacro_clicked();
     void on_btnPlayMacro_clicked();
     void on_btnPlayLoopMacro_clicked();
+    void onRecordActionsClicked();
+    void onZReportClicked();
 
 private:
     void setupNumpad();
+    void setupReceiptView();
+    void setupReceiptShortcuts();
+    void setupProductSearch();
+    void onSearchEdited(const QString& text);
+    bool handleSearchKey(int key);
+    void addSearchResult(const QModelIndex& index);
+    void closeSearch();
+    void resumeReceipt(int index);
+    void completeStartup();
+    MacroManager& macros();
+    void recordAction(MacroAction action, int32_t argument = 0, const QString& text = QString());
+    void scheduleFinancialsUpdate();
     void updateFinancials();
-    void resetPaymentState();
+    void resetInput();
     void setupMacroUI();
+    void openCatalog();
+    void openPromotions();
+    void openLedger();
+    double macroPlaybackSpeed() const;
+    void setupReportUI();
+    bool confirm(const QString& title, const QString& text);
+    void setupLatencyMonitor();
+    void toggleLatencyOverlay();
+    void refreshLatencyOverlay();
+    void exportLatency();
+    bool restoreFromJournal();
 
     Ui::CashRegisterWindowClass ui;
+    RegisterEngine m_register;
     ReceiptTableModel* m_tableModel;
-    Money m_tenderedAmount;
+    // Created on first use; most registers never record or play a macro.
     MacroManager* m_macroManager;
-
-    enum NumpadKeys {
-        KeyBackspace = 10,
-        KeyPoint = 11
-    };
+    ProductCatalog m_catalog;
+    PromotionEngine m_promotions;
+    ReceiptJournal m_journal;
+    SalesLedger m_ledger;
+    QTimer* m_financialsTimer;
+    // The last payment state shown; updateFinancials() diffs against it and
+    // touches only the labels that changed.
+    PaymentState m_renderedPanel;
+    bool m_panelRendered;
+    bool m_confirmations;
+    LatencyMonitor m_latency;
+    QLabel* m_latencyOverlay;
+    QTimer* m_latencyOverlayTimer;
+    QTimer* m_latencyExportTimer;
+    QString m_latencyExportPath;
+    bool m_latencyFromEnvironment;
+    bool m_latencyPaintActive;
+    bool m_startupScheduled;
+    QLineEdit* m_searchEdit;
+    // A child of the window rather than a popup so the search line keeps the
+    // keyboard while the list shows.
+    QListView* m_searchList;
+    ProductSearchModel* m_searchModel;
 };
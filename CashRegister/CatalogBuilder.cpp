@@ -0,0 +1,33 @@
+#include "ProductCatalog.h"
+#include <QElapsedTimer>
+#include <cstdio>
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3) {
+        std::fprintf(stderr, "Usage: %s <catalog.csv> <catalog.bin>\n", argv[0]);
+        return 2;
+    }
+
+    const QString csvPath = QString::fromLocal8Bit(argv[1]);
+    const QString outputPath = QString::fromLocal8Bit(argv[2]);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QString error;
+    if (!ProductCatalog::build(csvPath, outputPath, &error)) {
+        std::fprintf(stderr, "%s\n", qPrintable(error));
+        return 1;
+    }
+
+    ProductCatalog catalog;
+    if (!catalog.open(outputPath)) {
+        std::fprintf(stderr, "Written catalog failed validation\n");
+        return 1;
+    }
+
+    std::printf("%u products, %u search words compiled in %lld ms\n", catalog.size(), catalog.searchWordCount(),
+                static_cast<long long>(timer.elapsed()));
+    return 0;
+}
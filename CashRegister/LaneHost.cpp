@@ -0,0 +1,192 @@
+#include "LaneHost.h"
+#include "PromotionEngine.h"
+#include "ReceiptJournal.h"
+#include "SalesLedger.h"
+#include <QDir>
+#include <QElapsedTimer>
+#include <QThread>
+#include <algorithm>
+#include <atomic>
+
+struct LaneHost::Lane {
+    RegisterEngine engine;
+    PromotionEngine promotions;
+    ReceiptJournal journal;
+    SalesLedger ledger;
+    ActionReplayReport report;
+
+    // Claimed by one worker per pass; kept off the engine's cache lines since
+    // idle workers poll them.
+    alignas(64) std::atomic<bool> busy{false};
+    std::atomic<int> remaining{0};
+};
+
+class LaneHost::Worker : public QThread {
+public:
+    Worker(LaneHost* host, int index, uint64_t generation)
+        : m_host(host), m_index(index), m_generation(generation) {}
+
+    void run() override {
+        m_host->work(m_index, m_generation);
+    }
+
+private:
+    LaneHost* m_host;
+    int m_index;
+    uint64_t m_generation;
+};
+
+LaneHost::LaneHost(int lanes, const ProductCatalog* catalog, const PromotionEngine* promotions)
+    : m_records(nullptr), m_generation(0), m_busyWorkers(0), m_stopping(false) {
+    m_lanes.reserve(static_cast<size_t>(std::max(lanes, 1)));
+    for (int i = 0; i < std::max(lanes, 1); ++i) {
+        auto lane = std::make_unique<Lane>();
+        lane->engine.setCatalog(catalog);
+        if (promotions) {
+            lane->promotions = *promotions;
+            lane->engine.setPromotions(&lane->promotions);
+        }
+        m_lanes.push_back(std::move(lane));
+    }
+    startWorkers(0);
+}
+
+LaneHost::~LaneHost() {
+    stopWorkers();
+}
+
+bool LaneHost::open(const QString& directory, Storage storage) {
+    if (storage == Storage::Memory) return true;
+
+    const bool sync = storage == Storage::Durable;
+    bool ok = true;
+    for (int i = 0; i < laneCount(); ++i) {
+        Lane& lane = *m_lanes[i];
+        const QString path = QDir(directory).filePath(QString("lane-%1").arg(i + 1, 2, 10, QChar('0')));
+        if (!QDir().mkpath(path) || !lane.journal.open(QDir(path).filePath("receipt.journal"), sync)
+            || !lane.ledger.open(QDir(path).filePath("ledger"), sync)) {
+            ok = false;
+            continue;
+        }
+        lane.engine.setJournal(&lane.journal);
+        lane.engine.setLedger(&lane.ledger);
+    }
+    return ok;
+}
+
+int LaneHost::laneCount() const {
+    return static_cast<int>(m_lanes.size());
+}
+
+int LaneHost::threadCount() const {
+    return static_cast<int>(m_workers.size());
+}
+
+RegisterEngine& LaneHost::lane(int index) {
+    return m_lanes[index]->engine;
+}
+
+void LaneHost::setThreadCount(int threads) {
+    stopWorkers();
+    startWorkers(threads);
+}
+
+// More workers than lanes would only wait for a lane to come free.
+void LaneHost::startWorkers(int threads) {
+    if (threads <= 0) threads = QThread::idealThreadCount();
+    threads = std::clamp(threads, 1, laneCount());
+
+    // Workers wait for the run after the last one; a run may start before
+    // their threads do, so the generation is read here rather than by them.
+    uint64_t generation = 0;
+    {
+        QMutexLocker lock(&m_mutex);
+        m_stopping = false;
+        generation = m_generation;
+    }
+    m_workers.reserve(static_cast<size_t>(threads));
+    for (int i = 0; i < threads; ++i) {
+        m_workers.push_back(std::make_unique<Worker>(this, i, generation));
+        m_workers.back()->start();
+    }
+}
+
+void LaneHost::stopWorkers() {
+    {
+        QMutexLocker lock(&m_mutex);
+        m_stopping = true;
+        m_started.wakeAll();
+    }
+    for (auto& worker : m_workers) worker->wait();
+    m_workers.clear();
+}
+
+ActionReplayReport LaneHost::run(const std::vector<ActionRecord>& records, int repeat) {
+    for (auto& lane : m_lanes) {
+        lane->report = ActionReplayReport();
+        lane->remaining.store(records.empty() ? 0 : std::max(repeat, 1), std::memory_order_relaxed);
+    }
+
+    QElapsedTimer total;
+    total.start();
+    {
+        QMutexLocker lock(&m_mutex);
+        m_records = &records;
+        m_busyWorkers = threadCount();
+        ++m_generation;
+        m_started.wakeAll();
+        while (m_busyWorkers > 0) m_finished.wait(&m_mutex);
+        m_records = nullptr;
+    }
+
+    ActionReplayReport report;
+    for (const auto& lane : m_lanes) report.merge(lane->report);
+    report.setElapsed(total.nsecsElapsed());
+    return report;
+}
+
+void LaneHost::work(int worker, uint64_t generation) {
+    for (;;) {
+        {
+            QMutexLocker lock(&m_mutex);
+            while (!m_stopping && m_generation == generation) m_started.wait(&m_mutex);
+            if (m_stopping) return;
+            generation = m_generation;
+        }
+
+        // Scan from this worker's home slice, rescanning after each pass so it
+        // returns to the same lane; stop once nothing is left to claim.
+        const int lanes = laneCount();
+        const int home = worker * lanes / threadCount();
+        bool claimed = true;
+        while (claimed) {
+            claimed = false;
+            for (int i = 0; i < lanes && !claimed; ++i) {
+                Lane& lane = *m_lanes[(home + i) % lanes];
+                if (lane.remaining.load(std::memory_order_relaxed) <= 0
+                    || lane.busy.load(std::memory_order_relaxed)
+                    || lane.busy.exchange(true, std::memory_order_acquire)) {
+                    continue;
+                }
+                if (lane.remaining.load(std::memory_order_relaxed) > 0) {
+                    runPass(lane);
+                    lane.remaining.fetch_sub(1, std::memory_order_relaxed);
+                    claimed = true;
+                }
+                lane.busy.store(false, std::memory_order_release);
+            }
+        }
+
+        QMutexLocker lock(&m_mutex);
+        if (--m_busyWorkers == 0) m_finished.wakeAll();
+    }
+}
+
+void LaneHost::runPass(Lane& lane) {
+    QElapsedTimer action;
+    for (const ActionRecord& record : *m_records) {
+        action.start();
+        lane.engine.applyAction(record);
+        lane.report.addSample(record.action, action.nsecsElapsed());
+    }
+}
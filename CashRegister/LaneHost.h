@@ -0,0 +1,76 @@
+#pragma once
+
+#include <QMutex>
+#include <QString>
+#include <QWaitCondition>
+#include <memory>
+#include <vector>
+#include "ActionMacro.h"
+#include "RegisterEngine.h"
+
+class ProductCatalog;
+class PromotionEngine;
+
+// Runs many independent registers ("lanes") side by side on a fixed pool of
+// worker threads. Lanes share only the read-only catalog; each has its own
+// receipt, promotion state and, once opened, journal and ledger, so lanes never
+// contend on a lock while serving customers.
+//
+// A run is split into passes over the recorded actions, one pass per lane at
+// a time. Workers start at their own slice of lanes and come back to the same
+// lane while it has passes left, which keeps a lane's data in one core's cache,
+// and steal passes from other lanes only when their own are done.
+class LaneHost {
+public:
+    // Every lane starts with its own copy of promotions (may be null).
+    LaneHost(int lanes, const ProductCatalog* catalog, const PromotionEngine* promotions = nullptr);
+    ~LaneHost();
+
+    LaneHost(const LaneHost&) = delete;
+    LaneHost& operator=(const LaneHost&) = delete;
+
+    // Where lanes keep their journals and ledgers. Durable syncs every commit
+    // as a register does; NoSync writes the same files without syncing them,
+    // and Memory keeps neither, so a run measures the engines alone.
+    enum class Storage {
+        Durable,
+        NoSync,
+        Memory
+    };
+
+    // Opens a journal and a ledger per lane under directory/lane-NN, unless
+    // storage is Memory.
+    bool open(const QString& directory, Storage storage = Storage::Durable);
+
+    [[nodiscard]] int laneCount() const;
+    [[nodiscard]] int threadCount() const;
+    [[nodiscard]] RegisterEngine& lane(int index);
+
+    // Sizes the worker pool; 0 means one thread per core, at most one per lane.
+    void setThreadCount(int threads);
+
+    // Replays records repeat times on every lane and returns the latencies of
+    // all lanes together, with the wall-clock time of the whole run.
+    ActionReplayReport run(const std::vector<ActionRecord>& records, int repeat = 1);
+
+private:
+    struct Lane;
+    class Worker;
+
+    void startWorkers(int threads);
+    void stopWorkers();
+    void work(int worker, uint64_t generation);
+    void runPass(Lane& lane);
+
+    std::vector<std::unique_ptr<Lane>> m_lanes;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+
+    // The current run, published under m_mutex by bumping m_generation.
+    QMutex m_mutex;
+    QWaitCondition m_started;
+    QWaitCondition m_finished;
+    const std::vector<ActionRecord>* m_records;
+    uint64_t m_generation;
+    int m_busyWorkers;
+    bool m_stopping;
+};
@@ -0,0 +1,153 @@
+#include "LatencyMonitor.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <algorithm>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+int highestBit(uint64_t value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<int>(index);
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+QString formatMicros(uint64_t ns) {
+    return QString::number(static_cast<double>(ns) / 1000.0, 'f', 1);
+}
+
+}
+
+int LatencyHistogram::bucketIndex(uint64_t value) {
+    if (value < SubBuckets) return static_cast<int>(value);
+
+    const int shift = highestBit(value) - SubBucketBits;
+    return (shift + 1) * SubBuckets + static_cast<int>((value >> shift) & (SubBuckets - 1));
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(int index) {
+    if (index < SubBuckets) return static_cast<uint64_t>(index);
+
+    const int shift = index / SubBuckets - 1;
+    const uint64_t lower = static_cast<uint64_t>(SubBuckets + index % SubBuckets) << shift;
+    return lower + ((uint64_t(1) << shift) - 1);
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+    m_counts[static_cast<size_t>(bucketIndex(ns))].fetch_add(1, std::memory_order_relaxed);
+    m_total.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t currentMax = m_max.load(std::memory_order_relaxed);
+    while (ns > currentMax && !m_max.compare_exchange_weak(currentMax, ns, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::reset() {
+    for (std::atomic<uint64_t>& count : m_counts) count.store(0, std::memory_order_relaxed);
+    m_total.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const {
+    return m_total.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::max() const {
+    return m_max.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::bucketCount(int index) const {
+    return m_counts[static_cast<size_t>(index)].load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const {
+    const uint64_t total = count();
+    if (total == 0) return 0;
+
+    const uint64_t target = static_cast<uint64_t>(fraction * static_cast<double>(total - 1)) + 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        seen += bucketCount(i);
+        if (seen >= target) return std::min(bucketUpperBound(i), max());
+    }
+    return max();
+}
+
+const char* LatencyMonitor::probeName(LatencyProbe probe) {
+    switch (probe) {
+    case LatencyProbe::Enter: return "enter";
+    case LatencyProbe::Numpad: return "numpad";
+    case LatencyProbe::Approve: return "approve";
+    case LatencyProbe::TotalsChanged: return "totalsChanged";
+    case LatencyProbe::UpdateFinancials: return "updateFinancials";
+    case LatencyProbe::TablePaint: return "tablePaint";
+    case LatencyProbe::Search: return "search";
+    }
+    return "unknown";
+}
+
+void LatencyMonitor::record(LatencyProbe probe, uint64_t ns) {
+    m_histograms[static_cast<size_t>(probe)].record(ns);
+}
+
+void LatencyMonitor::reset() {
+    for (LatencyHistogram& histogram : m_histograms) histogram.reset();
+}
+
+const LatencyHistogram& LatencyMonitor::histogram(LatencyProbe probe) const {
+    return m_histograms[static_cast<size_t>(probe)];
+}
+
+QString LatencyMonitor::summary() const {
+    QString text = QString("%1 %2 %3 %4 %5").arg("µs", -16).arg("p50", 8).arg("p99", 8).arg("max", 8).arg("n", 8);
+    for (int i = 0; i < LatencyProbeCount; ++i) {
+        const LatencyHistogram& h = m_histograms[static_cast<size_t>(i)];
+        text += QString("\n%1 %2 %3 %4 %5")
+            .arg(probeName(static_cast<LatencyProbe>(i)), -16)
+            .arg(formatMicros(h.percentile(0.50)), 8)
+            .arg(formatMicros(h.percentile(0.99)), 8)
+            .arg(formatMicros(h.max()), 8)
+            .arg(static_cast<qulonglong>(h.count()), 8);
+    }
+    return text;
+}
+
+// Writes percentiles plus the non-empty buckets (upper bound in ns, count) per
+// probe, so histograms from several runs can be merged offline.
+bool LatencyMonitor::exportTo(const QString& filePath) const {
+    QJsonObject probes;
+    for (int i = 0; i < LatencyProbeCount; ++i) {
+        const LatencyHistogram& h = m_histograms[static_cast<size_t>(i)];
+
+        QJsonArray buckets;
+        for (int b = 0; b < LatencyHistogram::BucketCount; ++b) {
+            const uint64_t count = h.bucketCount(b);
+            if (count == 0) continue;
+            buckets.append(QJsonArray{ static_cast<double>(LatencyHistogram::bucketUpperBound(b)), static_cast<double>(count) });
+        }
+
+        QJsonObject probe;
+        probe["count"] = static_cast<double>(h.count());
+        probe["p50_ns"] = static_cast<double>(h.percentile(0.50));
+        probe["p90_ns"] = static_cast<double>(h.percentile(0.90));
+        probe["p99_ns"] = static_cast<double>(h.percentile(0.99));
+        probe["p999_ns"] = static_cast<double>(h.percentile(0.999));
+        probe["max_ns"] = static_cast<double>(h.max());
+        probe["buckets"] = buckets;
+        probes[probeName(static_cast<LatencyProbe>(i))] = probe;
+    }
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    file.write(QJsonDocument(probes).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
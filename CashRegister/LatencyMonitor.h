@@ -0,0 +1,90 @@
+#pragma once
+
+#include <QString>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+enum class LatencyProbe : int {
+    Enter,
+    Numpad,
+    Approve,
+    TotalsChanged,
+    UpdateFinancials,
+    TablePaint,
+    Search
+};
+
+constexpr int LatencyProbeCount = static_cast<int>(LatencyProbe::Search) + 1;
+
+// Log-linear (HDR-style) histogram of nanosecond durations: every power of
+// two is split into 16 sub-buckets, so any reported value is within 6.25% of
+// the recorded one. Recording is a couple of relaxed atomic operations and
+// never blocks, so it is safe from any thread.
+class LatencyHistogram {
+public:
+    static constexpr int SubBucketBits = 4;
+    static constexpr int SubBuckets = 1 << SubBucketBits;
+    static constexpr int BucketCount = (64 - SubBucketBits + 1) * SubBuckets;
+
+    void record(uint64_t ns);
+    void reset();
+
+    [[nodiscard]] uint64_t count() const;
+    [[nodiscard]] uint64_t max() const;
+    [[nodiscard]] uint64_t percentile(double fraction) const;
+    [[nodiscard]] uint64_t bucketCount(int index) const;
+
+    [[nodiscard]] static int bucketIndex(uint64_t value);
+    [[nodiscard]] static uint64_t bucketUpperBound(int index);
+
+private:
+    std::array<std::atomic<uint64_t>, BucketCount> m_counts{};
+    std::atomic<uint64_t> m_total{0};
+    std::atomic<uint64_t> m_max{0};
+};
+
+class LatencyMonitor {
+public:
+    void setEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+    [[nodiscard]] bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    void record(LatencyProbe probe, uint64_t ns);
+    void reset();
+
+    [[nodiscard]] const LatencyHistogram& histogram(LatencyProbe probe) const;
+    [[nodiscard]] QString summary() const;
+    bool exportTo(const QString& filePath) const;
+
+    static const char* probeName(LatencyProbe probe);
+
+private:
+    std::atomic<bool> m_enabled{false};
+    std::array<LatencyHistogram, LatencyProbeCount> m_histograms;
+};
+
+// Times the enclosing block. With the monitor disabled the cost is one relaxed
+// load and a branch; the clock is not read at all.
+class LatencyScope {
+public:
+    LatencyScope(LatencyMonitor& monitor, LatencyProbe probe)
+        : m_monitor(monitor), m_probe(probe), m_start(monitor.isEnabled() ? now() : 0) {}
+
+    ~LatencyScope() {
+        if (m_start != 0) m_monitor.record(m_probe, now() - m_start);
+    }
+
+    LatencyScope(const LatencyScope&) = delete;
+    LatencyScope& operator=(const LatencyScope&) = delete;
+
+private:
+    static uint64_t now() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    LatencyMonitor& m_monitor;
+    LatencyProbe m_probe;
+    uint64_t m_start;
+};
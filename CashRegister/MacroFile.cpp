@@ -0,0 +1,117 @@
+#include "MacroFile.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+namespace {
+
+constexpr char MacroMagic[8] = { 'C', 'R', 'M', 'A', 'C', 'R', 'O', '\0' };
+constexpr uint32_t MacroVersion = 1;
+
+struct MacroFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+};
+
+bool loadTextMacro(const QByteArray& data, std::vector<MacroEvent>& events) {
+    const char* p = data.constData();
+    const char* const end = p + data.size();
+    while (p < end) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        if (!lineEnd) lineEnd = end;
+
+        long long delay = 0;
+        unsigned type = 0;
+        unsigned code = 0;
+        int value = 0;
+        const std::string line(p, lineEnd);
+        if (std::sscanf(line.c_str(), "%lld %u %u %d", &delay, &type, &code, &value) == 4) {
+            MacroEvent event{};
+            event.deltaUs = static_cast<uint32_t>(delay * 1000);
+            event.type = static_cast<uint16_t>(type);
+            event.code = static_cast<uint16_t>(code);
+            event.value = value;
+            events.push_back(event);
+        }
+        p = lineEnd + 1;
+    }
+    return true;
+}
+
+}
+
+MacroFileWriter::~MacroFileWriter() {
+    close();
+}
+
+bool MacroFileWriter::open(const QString& filePath, MacroFormat format) {
+    close();
+    m_format = format;
+    m_buffer.clear();
+    m_buffer.reserve(BufferBytes);
+
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+
+    if (m_format == MacroFormat::Binary) {
+        MacroFileHeader header{};
+        std::memcpy(header.magic, MacroMagic, sizeof(MacroMagic));
+        header.version = MacroVersion;
+        header.recordSize = sizeof(MacroEvent);
+        const char* bytes = reinterpret_cast<const char*>(&header);
+        m_buffer.insert(m_buffer.end(), bytes, bytes + sizeof(header));
+    }
+    return true;
+}
+
+void MacroFileWriter::append(const MacroEvent& event) {
+    if (m_format == MacroFormat::Binary) {
+        const char* bytes = reinterpret_cast<const char*>(&event);
+        m_buffer.insert(m_buffer.end(), bytes, bytes + sizeof(event));
+    } else {
+        char line[64];
+        const int length = std::snprintf(line, sizeof(line), "%u %u %u %d\n",
+            event.deltaUs / 1000, unsigned(event.type), unsigned(event.code), event.value);
+        m_buffer.insert(m_buffer.end(), line, line + length);
+    }
+
+    if (m_buffer.size() >= BufferBytes) flushBuffer();
+}
+
+bool MacroFileWriter::close() {
+    if (!m_file.isOpen()) return true;
+    const bool ok = flushBuffer();
+    m_file.close();
+    return ok;
+}
+
+bool MacroFileWriter::flushBuffer() {
+    if (m_buffer.empty()) return true;
+    const qint64 size = static_cast<qint64>(m_buffer.size());
+    const bool ok = m_file.write(m_buffer.data(), size) == size;
+    m_buffer.clear();
+    return ok;
+}
+
+bool loadMacroFile(const QString& filePath, std::vector<MacroEvent>& events) {
+    events.clear();
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    const QByteArray data = file.readAll();
+
+    MacroFileHeader header{};
+    if (static_cast<size_t>(data.size()) >= sizeof(header)) {
+        std::memcpy(&header, data.constData(), sizeof(header));
+    }
+    if (std::memcmp(header.magic, MacroMagic, sizeof(MacroMagic)) != 0) {
+        return loadTextMacro(data, events);
+    }
+    if (header.version != MacroVersion || header.recordSize != sizeof(MacroEvent)) return false;
+
+    const size_t count = (static_cast<size_t>(data.size()) - sizeof(header)) / sizeof(MacroEvent);
+    events.resize(count);
+    std::memcpy(events.data(), data.constData() + sizeof(header), count * sizeof(MacroEvent));
+    return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <QFile>
+#include <QString>
+#include <cstdint>
+#include <vector>
+
+enum class MacroFormat {
+    Text,
+    Binary
+};
+
+// One recorded input event. deltaUs is the kernel-timestamp distance to the
+// previous record, so files stay compact and independent of wall-clock time.
+struct MacroEvent {
+    uint32_t deltaUs;
+    uint16_t type;
+    uint16_t code;
+    int32_t value;
+    uint8_t device;
+    uint8_t reserved[3];
+};
+static_assert(sizeof(MacroEvent) == 16, "MacroEvent is a fixed-size on-disk record");
+
+// Buffered macro writer: events are collected in memory and written in large
+// blocks instead of one syscall per event.
+class MacroFileWriter {
+public:
+    static constexpr size_t BufferBytes = 64 * 1024;
+
+    ~MacroFileWriter();
+
+    bool open(const QString& filePath, MacroFormat format);
+    void append(const MacroEvent& event);
+    bool close();
+
+private:
+    bool flushBuffer();
+
+    QFile m_file;
+    MacroFormat m_format = MacroFormat::Binary;
+    std::vector<char> m_buffer;
+};
+
+// Reads a macro in either format; binary files are recognised by their header.
+bool loadMacroFile(const QString& filePath, std::vector<MacroEvent>& events);
@@ -1,8 +1,7 @@
 #include "MacroManager.h"
-#include <QFile>
-#include <QTextStream>
-#include <QElapsedTimer>
 #include <QDir>
+#include <algorithm>
+#include <bitset>
 #include <vector>
 
 #ifdef Q_OS_LINUX
@@ -10,72 +9,116 @@
 #include <linux/uinput.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
 #include <sys/time.h>
+#include <time.h>
 #endif
 
 class MacroManager::RecorderThread : public QThread {
 public:
     QString filePath;
+    MacroRecordOptions options;
     std::atomic<bool> running{false};
 
     void run() override {
 #ifdef Q_OS_LINUX
-        std::vector<int> fds;
-        QDir dir("/dev/input");
-        QStringList entries = dir.entryList(QStringList() << "event*", QDir::System);
+        QStringList paths = options.devices;
+        if (paths.isEmpty()) {
+            QDir dir("/dev/input");
+            for (const QString& entry : dir.entryList(QStringList() << "event*", QDir::System)) {
+                paths << "/dev/input/" + entry;
+            }
+        }
 
-        for (const QString& entry : entries) {
-            QString path = "/dev/input/" + entry;
-            int fd = open(path.toStdString().c_str(), O_RDONLY | O_NONBLOCK);
-            if (fd >= 0) fds.push_back(fd);
+        std::bitset<EV_CNT> allowedTypes;
+        if (options.eventTypes.empty()) allowedTypes.set();
+        for (uint16_t type : options.eventTypes) {
+            if (type < EV_CNT) allowedTypes.set(type);
         }
 
-        if (fds.empty()) return;
+        int epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (epollFd < 0) return;
+
+        std::vector<int> fds;
+        for (const QString& path : paths) {
+            if (fds.size() > UINT8_MAX) break;
+
+            int fd = open(path.toStdString().c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+            if (fd < 0) continue;
+
+            // Monotonic kernel timestamps keep deltas immune to clock changes.
+            int clockId = CLOCK_MONOTONIC;
+            ioctl(fd, EVIOCSCLOCKID, &clockId);
+
+            struct epoll_event reg = {};
+            reg.events = EPOLLIN;
+            reg.data.u32 = static_cast<uint32_t>(fds.size());
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &reg) < 0) {
+                close(fd);
+                continue;
+            }
+            fds.push_back(fd);
+        }
 
-        QFile file(filePath);
-        if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        MacroFileWriter writer;
+        if (fds.empty() || !writer.open(filePath, options.format)) {
             for (int fd : fds) close(fd);
+            close(epollFd);
             return;
         }
-        QTextStream out(&file);
 
-        QElapsedTimer timer;
-        timer.start();
-        qint64 lastTime = 0;
+        struct TimedEvent {
+            int64_t timeUs;
+            MacroEvent event;
+        };
+        std::vector<TimedEvent> batch;
+        struct input_event buffer[64];
+        struct epoll_event ready[16];
+        int64_t lastTimeUs = -1;
 
         running = true;
         while (running) {
-            fd_set readSet;
-            FD_ZERO(&readSet);
-            int maxFd = -1;
-
-            for (int fd : fds) {
-                FD_SET(fd, &readSet);
-                if (fd > maxFd) maxFd = fd;
-            }
-
-            struct timeval tv{0, 50000};
-            int ret = select(maxFd + 1, &readSet, nullptr, nullptr, &tv);
-
-            if (ret > 0) {
-                for (int fd : fds) {
-                    if (FD_ISSET(fd, &readSet)) {
-                        struct input_event ev;
-                        while (read(fd, &ev, sizeof(ev)) == sizeof(ev)) {
-                            qint64 currentTime = timer.elapsed();
-                            qint64 delay = (lastTime == 0) ? 0 : (currentTime - lastTime);
-                            lastTime = currentTime;
-
-                            out << delay << " " << ev.type << " " << ev.code << " " << ev.value << "\n";
-                            out.flush();
-                        }
+            const int count = epoll_wait(epollFd, ready, 16, 50);
+            if (count <= 0) continue;
+
+            batch.clear();
+            for (int i = 0; i < count; ++i) {
+                const uint32_t device = ready[i].data.u32;
+                ssize_t bytes;
+                while ((bytes = read(fds[device], buffer, sizeof(buffer))) > 0) {
+                    const size_t events = static_cast<size_t>(bytes) / sizeof(struct input_event);
+                    for (size_t e = 0; e < events; ++e) {
+                        const struct input_event& ev = buffer[e];
+                        if (!allowedTypes.test(ev.type)) continue;
+
+                        TimedEvent timed = {};
+                        timed.timeUs = static_cast<int64_t>(ev.input_event_sec) * 1000000 + ev.input_event_usec;
+                        timed.event.type = ev.type;
+                        timed.event.code = ev.code;
+                        timed.event.value = ev.value;
+                        timed.event.device = static_cast<uint8_t>(device);
+                        batch.push_back(timed);
                     }
                 }
             }
+
+            // Devices are drained one after another; restore global time order.
+            std::stable_sort(batch.begin(), batch.end(), [](const TimedEvent& a, const TimedEvent& b) {
+                return a.timeUs < b.timeUs;
+            });
+
+            for (TimedEvent& timed : batch) {
+                const int64_t delta = lastTimeUs < 0 ? 0 : std::max<int64_t>(0, timed.timeUs - lastTimeUs);
+                lastTimeUs = timed.timeUs;
+                timed.event.deltaUs = static_cast<uint32_t>(std::min<int64_t>(delta, UINT32_MAX));
+                writer.append(timed.event);
+            }
         }
 
+        writer.close();
         for (int fd : fds) close(fd);
-        file.close();
+        close(epollFd);
 #endif
     }
 };
@@ -84,10 +127,48 @@ class MacroManager::PlayerThread : public QThread {
 public:
     QString filePath;
     bool loop{false};
+    double speed{1.0};
     std::atomic<bool> running{false};
 
+#ifdef Q_OS_LINUX
+    static int64_t monotonicNs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    // Sleeps in short absolute slices so stopPlaying() is not held up by long pauses.
+    bool sleepUntil(int64_t deadlineNs) {
+        constexpr int64_t SliceNs = 50 * 1000000;
+        while (running) {
+            const int64_t now = monotonicNs();
+            if (now >= deadlineNs) return true;
+
+            const int64_t wakeNs = std::min(deadlineNs, now + SliceNs);
+            struct timespec ts;
+            ts.tv_sec = static_cast<time_t>(wakeNs / 1000000000);
+            ts.tv_nsec = static_cast<long>(wakeNs % 1000000000);
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+        }
+        return false;
+    }
+#endif
+
     void run() override {
 #ifdef Q_OS_LINUX
+        std::vector<MacroEvent> events;
+        if (!loadMacroFile(filePath, events) || events.empty()) return;
+
+        // Offsets are precomputed once, so each event is scheduled against the
+        // start of the pass and write time never accumulates as drift.
+        const bool unpaced = speed <= 0.0;
+        std::vector<int64_t> offsetsNs(events.size());
+        int64_t elapsedUs = 0;
+        for (size_t i = 0; i < events.size(); ++i) {
+            elapsedUs += events[i].deltaUs;
+            offsetsNs[i] = unpaced ? 0 : static_cast<int64_t>(elapsedUs * 1000.0 / speed);
+        }
+
         int fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
         if (fd < 0) return;
 
@@ -117,35 +198,31 @@ public:
         usleep(100000);
 
         running = true;
+        std::vector<struct input_event> batch;
+        batch.reserve(64);
+        int64_t passStartNs = monotonicNs();
         do {
-            QFile file(filePath);
-            if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) break;
-            QTextStream in(&file);
-
-            while (!in.atEnd() && running) {
-                QString line = in.readLine();
-                QStringList parts = line.split(" ", Qt::SkipEmptyParts);
-
-                if (parts.size() == 4) {
-                    qint64 delay = parts[0].toLongLong();
-                    uint16_t type = parts[1].toUShort();
-                    uint16_t code = parts[2].toUShort();
-                    int32_t value = parts[3].toInt();
-
-                    if (delay > 0) {
-                        QThread::msleep(delay);
-                    }
-
+            size_t i = 0;
+            while (i < events.size() && running) {
+                if (!unpaced && !sleepUntil(passStartNs + offsetsNs[i])) break;
+
+                // Events recorded at the same instant go to uinput in one write.
+                struct timeval now;
+                gettimeofday(&now, nullptr);
+                batch.clear();
+                do {
                     struct input_event ev = {};
-                    ev.type = type;
-                    ev.code = code;
-                    ev.value = value;
-                    gettimeofday(&ev.time, nullptr);
-
-                    write(fd, &ev, sizeof(ev));
-                }
+                    ev.type = events[i].type;
+                    ev.code = events[i].code;
+                    ev.value = events[i].value;
+                    ev.time = now;
+                    batch.push_back(ev);
+                    ++i;
+                } while (i < events.size() && events[i].deltaUs == 0);
+
+                write(fd, batch.data(), batch.size() * sizeof(struct input_event));
             }
-            file.close();
+            passStartNs += offsetsNs.back();
 
         } while (loop && running);
 
@@ -167,9 +244,10 @@ MacroManager::~MacroManager() {
     delete m_playerThread;
 }
 
-void MacroManager::startRecording(const QString& filePath) {
+void MacroManager::startRecording(const QString& filePath, const MacroRecordOptions& options) {
     if (m_recorderThread->isRunning()) return;
     m_recorderThread->filePath = filePath;
+    m_recorderThread->options = options;
     m_recorderThread->start();
 }
 
@@ -178,12 +256,24 @@ void MacroManager::stopRecording() {
         m_recorderThread->running = false;
         m_recorderThread->wait();
     }
+    if (m_actionRecorder.isRecording() && !m_actionRecorder.stop()) {
+        emit errorOccurred("Не вдалося зберегти макрос дій.");
+    }
+}
+
+void MacroManager::startActionRecording(const QString& filePath) {
+    m_actionRecorder.start(filePath);
+}
+
+void MacroManager::recordAction(MacroAction action, int32_t argument, const QString& text) {
+    m_actionRecorder.record(action, argument, text);
 }
 
-void MacroManager::startPlaying(const QString& filePath, bool loop) {
+void MacroManager::startPlaying(const QString& filePath, bool loop, double speed) {
     if (m_playerThread->isRunning()) return;
     m_playerThread->filePath = filePath;
     m_playerThread->loop = loop;
+    m_playerThread->speed = speed;
     m_playerThread->start();
 }
 
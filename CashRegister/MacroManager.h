@@ -3,7 +3,20 @@
 #include <QObject>
 #include <QThread>
 #include <QString>
+#include <QStringList>
 #include <atomic>
+#include <cstdint>
+#include <vector>
+#include "ActionMacro.h"
+#include "MacroFile.h"
+
+struct MacroRecordOptions {
+    MacroFormat format = MacroFormat::Binary;
+    // Device nodes to record, e.g. "/dev/input/event3"; empty records all.
+    QStringList devices;
+    // EV_* types to keep, e.g. EV_KEY and EV_SYN; empty keeps every type.
+    std::vector<uint16_t> eventTypes;
+};
 
 class MacroManager : public QObject {
     Q_OBJECT
@@ -12,9 +25,19 @@ public:
     explicit MacroManager(QObject* parent = nullptr);
     ~MacroManager() override;
 
-    void startRecording(const QString& filePath);
+    void startRecording(const QString& filePath, const MacroRecordOptions& options = MacroRecordOptions());
     void stopRecording();
-    void startPlaying(const QString& filePath, bool loop);
+
+    // Semantic recording: the window reports its own operations instead of
+    // the recorder capturing device input.
+    void startActionRecording(const QString& filePath);
+    void recordAction(MacroAction action, int32_t argument = 0, const QString& text = QString());
+    [[nodiscard]] bool isRecordingActions() const { return m_actionRecorder.isRecording(); }
+
+    // Speed scales recorded timing: 0.5 is half speed, 10 is ten times faster.
+    static constexpr double AsFastAsPossible = 0.0;
+
+    void startPlaying(const QString& filePath, bool loop, double speed = 1.0);
     void stopPlaying();
 
 signals:
@@ -26,4 +49,5 @@ private:
 
     RecorderThread* m_recorderThread;
     PlayerThread* m_playerThread;
+    ActionRecorder m_actionRecorder;
 };
@@ -0,0 +1,338 @@
+#include "MoneyKernels.h"
+#include <limits>
+#include <vector>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define MONEY_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr int64_t Int64Max = std::numeric_limits<int64_t>::max();
+constexpr int64_t Int64Min = std::numeric_limits<int64_t>::min();
+constexpr int64_t Int32Max = std::numeric_limits<int32_t>::max();
+constexpr int64_t Int32Min = std::numeric_limits<int32_t>::min();
+constexpr uint64_t LowMask = 0xFFFFFFFFu;
+
+int64_t saturate(bool positive) {
+    return positive ? Int64Max : Int64Min;
+}
+
+// Exact accumulator: the value is high * 2^32 + low. Every term is split into
+// its signed upper and unsigned lower 32 bits, so neither half can overflow
+// for any realistic number of terms (fewer than 2^31).
+struct WideSum {
+    int64_t high = 0;
+    uint64_t low = 0;
+    bool overflow = false;
+
+    void add(int64_t value) {
+        low += static_cast<uint64_t>(value) & LowMask;
+        high += value >> 32;
+    }
+
+    // Adds value * 2^32, for the upper half of a wide product.
+    void addHigh(int64_t value) {
+        if ((value > 0 && high > Int64Max - value) || (value < 0 && high < Int64Min - value)) {
+            overflow = true;
+            high = saturate(value > 0);
+            return;
+        }
+        high += value;
+    }
+
+    bool result(int64_t& out) const {
+        if (overflow) {
+            out = saturate(high > 0);
+            return false;
+        }
+        const int64_t top = high + static_cast<int64_t>(low >> 32);
+        if (top > Int32Max || top < Int32Min) {
+            out = saturate(top > 0);
+            return false;
+        }
+        out = static_cast<int64_t>((static_cast<uint64_t>(top) << 32) | (low & LowMask));
+        return true;
+    }
+};
+
+void sumScalar(const int64_t* values, size_t first, size_t count, WideSum& acc) {
+    for (size_t i = first; i < count; ++i) acc.add(values[i]);
+}
+
+// price = high * 2^32 + low, so price * q = (high * q) * 2^32 + low * q, and
+// both partial products fit in int64 for any int64 price and int32 quantity.
+void dotScalar(const int64_t* prices, const int32_t* quantities, size_t first, size_t count, WideSum& acc) {
+    for (size_t i = first; i < count; ++i) {
+        const int64_t q = quantities[i];
+        const int64_t low = static_cast<int64_t>(static_cast<uint64_t>(prices[i]) & LowMask);
+        acc.add(low * q);
+        acc.addHigh((prices[i] >> 32) * q);
+    }
+}
+
+void minMaxScalar(const int64_t* values, size_t first, size_t count, int64_t& min, int64_t& max) {
+    for (size_t i = first; i < count; ++i) {
+        if (values[i] < min) min = values[i];
+        if (values[i] > max) max = values[i];
+    }
+}
+
+enum class InstructionSet {
+    Scalar,
+    Sse42,
+    Avx2
+};
+
+InstructionSet detectInstructionSet() {
+#ifdef MONEY_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return InstructionSet::Avx2;
+    if (__builtin_cpu_supports("sse4.2")) return InstructionSet::Sse42;
+#endif
+    return InstructionSet::Scalar;
+}
+
+InstructionSet instructionSet() {
+    static const InstructionSet isa = detectInstructionSet();
+    return isa;
+}
+
+#ifdef MONEY_KERNELS_X86
+
+// Lane accumulators are folded into WideSum as: low halves, unsigned high
+// halves, and the count of negative terms (each of which borrowed 2^32 from
+// its unsigned high half).
+void foldLanes(const uint64_t* low, const uint64_t* high, const uint64_t* negatives, int lanes, WideSum& acc) {
+    for (int lane = 0; lane < lanes; ++lane) {
+        acc.low += low[lane];
+        acc.high += static_cast<int64_t>(high[lane]) - static_cast<int64_t>(negatives[lane] << 32);
+    }
+}
+
+__attribute__((target("avx2")))
+size_t sumAvx2(const int64_t* values, size_t count, WideSum& acc) {
+    const __m256i mask = _mm256_set1_epi64x(static_cast<long long>(LowMask));
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i low = zero;
+    __m256i high = zero;
+    __m256i negatives = zero;
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+        low = _mm256_add_epi64(low, _mm256_and_si256(x, mask));
+        high = _mm256_add_epi64(high, _mm256_srli_epi64(x, 32));
+        negatives = _mm256_sub_epi64(negatives, _mm256_cmpgt_epi64(zero, x));
+    }
+
+    alignas(32) uint64_t l[4], h[4], n[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(l), low);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(h), high);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(n), negatives);
+    foldLanes(l, h, n, 4, acc);
+    return i;
+}
+
+__attribute__((target("sse4.2")))
+size_t sumSse42(const int64_t* values, size_t count, WideSum& acc) {
+    const __m128i mask = _mm_set1_epi64x(static_cast<long long>(LowMask));
+    const __m128i zero = _mm_setzero_si128();
+    __m128i low = zero;
+    __m128i high = zero;
+    __m128i negatives = zero;
+
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+        low = _mm_add_epi64(low, _mm_and_si128(x, mask));
+        high = _mm_add_epi64(high, _mm_srli_epi64(x, 32));
+        negatives = _mm_sub_epi64(negatives, _mm_cmpgt_epi64(zero, x));
+    }
+
+    alignas(16) uint64_t l[2], h[2], n[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(l), low);
+    _mm_store_si128(reinterpret_cast<__m128i*>(h), high);
+    _mm_store_si128(reinterpret_cast<__m128i*>(n), negatives);
+    foldLanes(l, h, n, 2, acc);
+    return i;
+}
+
+// Requires every price to fit in int32, so _mm*_mul_epi32 yields the exact
+// 64-bit product; the products are then accumulated like sumAvx2.
+__attribute__((target("avx2")))
+size_t dotAvx2(const int64_t* prices, const int32_t* quantities, size_t count, WideSum& acc) {
+    const __m256i mask = _mm256_set1_epi64x(static_cast<long long>(LowMask));
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i low = zero;
+    __m256i high = zero;
+    __m256i negatives = zero;
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prices + i));
+        const __m256i q = _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(quantities + i)));
+        const __m256i x = _mm256_mul_epi32(p, q);
+        low = _mm256_add_epi64(low, _mm256_and_si256(x, mask));
+        high = _mm256_add_epi64(high, _mm256_srli_epi64(x, 32));
+        negatives = _mm256_sub_epi64(negatives, _mm256_cmpgt_epi64(zero, x));
+    }
+
+    alignas(32) uint64_t l[4], h[4], n[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(l), low);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(h), high);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(n), negatives);
+    foldLanes(l, h, n, 4, acc);
+    return i;
+}
+
+__attribute__((target("sse4.2")))
+size_t dotSse42(const int64_t* prices, const int32_t* quantities, size_t count, WideSum& acc) {
+    const __m128i mask = _mm_set1_epi64x(static_cast<long long>(LowMask));
+    const __m128i zero = _mm_setzero_si128();
+    __m128i low = zero;
+    __m128i high = zero;
+    __m128i negatives = zero;
+
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prices + i));
+        const __m128i q = _mm_cvtepi32_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(quantities + i)));
+        const __m128i x = _mm_mul_epi32(p, q);
+        low = _mm_add_epi64(low, _mm_and_si128(x, mask));
+        high = _mm_add_epi64(high, _mm_srli_epi64(x, 32));
+        negatives = _mm_sub_epi64(negatives, _mm_cmpgt_epi64(zero, x));
+    }
+
+    alignas(16) uint64_t l[2], h[2], n[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(l), low);
+    _mm_store_si128(reinterpret_cast<__m128i*>(h), high);
+    _mm_store_si128(reinterpret_cast<__m128i*>(n), negatives);
+    foldLanes(l, h, n, 2, acc);
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t minMaxAvx2(const int64_t* values, size_t count, int64_t& min, int64_t& max) {
+    __m256i lo = _mm256_set1_epi64x(min);
+    __m256i hi = _mm256_set1_epi64x(max);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+        lo = _mm256_blendv_epi8(lo, x, _mm256_cmpgt_epi64(lo, x));
+        hi = _mm256_blendv_epi8(hi, x, _mm256_cmpgt_epi64(x, hi));
+    }
+
+    alignas(32) int64_t l[4], h[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(l), lo);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(h), hi);
+    minMaxScalar(l, 0, 4, min, max);
+    minMaxScalar(h, 0, 4, min, max);
+    return i;
+}
+
+__attribute__((target("sse4.2")))
+size_t minMaxSse42(const int64_t* values, size_t count, int64_t& min, int64_t& max) {
+    __m128i lo = _mm_set1_epi64x(min);
+    __m128i hi = _mm_set1_epi64x(max);
+
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+        lo = _mm_blendv_epi8(lo, x, _mm_cmpgt_epi64(lo, x));
+        hi = _mm_blendv_epi8(hi, x, _mm_cmpgt_epi64(x, hi));
+    }
+
+    alignas(16) int64_t l[2], h[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(l), lo);
+    _mm_store_si128(reinterpret_cast<__m128i*>(h), hi);
+    minMaxScalar(l, 0, 2, min, max);
+    minMaxScalar(h, 0, 2, min, max);
+    return i;
+}
+
+#endif
+
+}
+
+namespace MoneyKernels {
+
+bool sum(const int64_t* values, size_t count, int64_t& out) {
+    WideSum acc;
+    size_t done = 0;
+#ifdef MONEY_KERNELS_X86
+    switch (instructionSet()) {
+    case InstructionSet::Avx2: done = sumAvx2(values, count, acc); break;
+    case InstructionSet::Sse42: done = sumSse42(values, count, acc); break;
+    case InstructionSet::Scalar: break;
+    }
+#endif
+    sumScalar(values, done, count, acc);
+    return acc.result(out);
+}
+
+bool dot(const int64_t* prices, const int32_t* quantities, size_t count, int64_t& out) {
+    WideSum acc;
+    size_t done = 0;
+#ifdef MONEY_KERNELS_X86
+    int64_t minPrice = 0;
+    int64_t maxPrice = 0;
+    const bool narrowPrices = instructionSet() != InstructionSet::Scalar
+        && minMax(prices, count, minPrice, maxPrice)
+        && minPrice >= Int32Min && maxPrice <= Int32Max;
+    if (narrowPrices) {
+        done = instructionSet() == InstructionSet::Avx2
+            ? dotAvx2(prices, quantities, count, acc)
+            : dotSse42(prices, quantities, count, acc);
+    }
+#endif
+    dotScalar(prices, quantities, done, count, acc);
+    return acc.result(out);
+}
+
+bool minMax(const int64_t* values, size_t count, int64_t& min, int64_t& max) {
+    if (count == 0) return false;
+
+    min = values[0];
+    max = values[0];
+    size_t done = 0;
+#ifdef MONEY_KERNELS_X86
+    switch (instructionSet()) {
+    case InstructionSet::Avx2: done = minMaxAvx2(values, count, min, max); break;
+    case InstructionSet::Sse42: done = minMaxSse42(values, count, min, max); break;
+    case InstructionSet::Scalar: break;
+    }
+#endif
+    minMaxScalar(values, done, count, min, max);
+    return true;
+}
+
+// Scatter-adds do not vectorise without AVX-512 conflict detection, so this
+// stays scalar but keeps exact per-group accumulators.
+bool groupedSum(const int64_t* values, const uint32_t* keys, size_t count,
+                int64_t* sums, size_t groupCount) {
+    std::vector<WideSum> groups(groupCount);
+    for (size_t i = 0; i < count; ++i) {
+        if (keys[i] < groupCount) groups[keys[i]].add(values[i]);
+    }
+
+    bool ok = true;
+    for (size_t g = 0; g < groupCount; ++g) {
+        groups[g].add(sums[g]);
+        ok = groups[g].result(sums[g]) && ok;
+    }
+    return ok;
+}
+
+const char* activeInstructionSet() {
+    switch (instructionSet()) {
+    case InstructionSet::Avx2: return "avx2";
+    case InstructionSet::Sse42: return "sse4.2";
+    case InstructionSet::Scalar: return "scalar";
+    }
+    return "scalar";
+}
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Batch kernels over contiguous kopeck (and quantity) columns. Intermediate
+// sums are exact: the SIMD paths accumulate 32-bit halves in separate lanes
+// and combine them in 128 bits. A result that does not fit in int64 is
+// saturated and the kernel returns false.
+//
+// The instruction set is picked once at runtime (AVX2, SSE4.2 or scalar);
+// builds without GCC/Clang x86-64 intrinsics always use the scalar path.
+namespace MoneyKernels {
+
+bool sum(const int64_t* values, size_t count, int64_t& out);
+
+// sum(prices[i] * quantities[i]); the receipt subtotal.
+bool dot(const int64_t* prices, const int32_t* quantities, size_t count, int64_t& out);
+
+// Returns false for an empty range.
+bool minMax(const int64_t* values, size_t count, int64_t& min, int64_t& max);
+
+// sums[keys[i]] += values[i] for keys below groupCount; other keys are
+// skipped. sums is added to, not cleared.
+bool groupedSum(const int64_t* values, const uint32_t* keys, size_t count,
+                int64_t* sums, size_t groupCount);
+
+// "avx2", "sse4.2" or "scalar".
+const char* activeInstructionSet();
+
+}
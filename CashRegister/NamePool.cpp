@@ -0,0 +1,57 @@
+#include "NamePool.h"
+
+NamePool::Id NamePool::acquire(const QString& name) {
+    auto it = m_index.constFind(name);
+    if (it != m_index.constEnd()) {
+        ++m_entries[it.value()].refs;
+        return it.value();
+    }
+
+    Id id;
+    if (!m_freeIds.empty()) {
+        id = m_freeIds.back();
+        m_freeIds.pop_back();
+    } else {
+        id = static_cast<Id>(m_entries.size());
+        m_entries.emplace_back();
+    }
+
+    m_entries[id].name = name;
+    m_entries[id].refs = 1;
+    m_index.insert(name, id);
+    return id;
+}
+
+bool NamePool::find(const QString& name, Id& id) const {
+    auto it = m_index.constFind(name);
+    if (it == m_index.constEnd()) return false;
+    id = it.value();
+    return true;
+}
+
+void NamePool::retain(Id id) {
+    ++m_entries[id].refs;
+}
+
+void NamePool::release(Id id) {
+    Entry& entry = m_entries[id];
+    if (--entry.refs > 0) return;
+
+    m_index.remove(entry.name);
+    entry.name.clear();
+    m_freeIds.push_back(id);
+}
+
+void NamePool::clear() {
+    m_entries.clear();
+    m_freeIds.clear();
+    m_index.clear();
+}
+
+const QString& NamePool::name(Id id) const {
+    return m_entries[id].name;
+}
+
+int NamePool::uniqueCount() const {
+    return static_cast<int>(m_index.size());
+}
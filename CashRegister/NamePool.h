@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <cstdint>
+#include <vector>
+
+// Interned, reference-counted string table. Each distinct name is stored once
+// and addressed by a stable 32-bit id until its last reference is released.
+class NamePool {
+public:
+    using Id = uint32_t;
+
+    Id acquire(const QString& name);
+    bool find(const QString& name, Id& id) const;
+    void retain(Id id);
+    void release(Id id);
+    void clear();
+
+    [[nodiscard]] const QString& name(Id id) const;
+    [[nodiscard]] int uniqueCount() const;
+
+private:
+    struct Entry {
+        QString name;
+        uint32_t refs = 0;
+    };
+
+    std::vector<Entry> m_entries;
+    std::vector<Id> m_freeIds;
+    QHash<QString, Id> m_index;
+};
@@ -0,0 +1,452 @@
+#include "ProductCatalog.h"
+#include "ProductSearch.h"
+#include <QSaveFile>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct ProductCatalog::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordCount;
+    uint64_t bucketCount;
+    uint64_t bucketsOffset;
+    uint64_t recordsOffset;
+    uint64_t namesOffset;
+    uint64_t namesLength;
+    // Version 2 and later.
+    uint64_t searchWordCount;
+    uint64_t searchWordsOffset;
+    uint64_t searchTextOffset;
+    uint64_t searchTextLength;
+    uint64_t postingsOffset;
+    uint64_t postingCount;
+    // recordCount + 1 offsets into the record words, which list the index
+    // words of each record's name in ascending order.
+    uint64_t recordWordsBeginOffset;
+    uint64_t recordWordsOffset;
+    uint64_t recordWordCount;
+    // Version 3 and later: a QuantityUnit byte per record.
+    uint64_t unitsOffset;
+};
+
+struct ProductCatalog::Bucket {
+    uint64_t barcode;
+    uint32_t recordIndex;
+    uint32_t reserved;
+};
+
+struct ProductCatalog::Record {
+    uint64_t barcode;
+    int64_t price;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+};
+
+// searchWordCount entries and a sentinel whose postingsBegin is postingCount.
+struct ProductCatalog::SearchWord {
+    uint32_t textOffset;
+    uint32_t textLength;
+    uint32_t postingsBegin;
+};
+
+namespace {
+
+constexpr char CatalogMagic[8] = { 'C', 'R', 'C', 'A', 'T', 'L', 'G', '\0' };
+constexpr uint32_t CatalogVersion = 3;
+
+uint64_t hashBarcode(uint64_t barcode) {
+    barcode ^= barcode >> 33;
+    barcode *= 0xff51afd7ed558ccdULL;
+    barcode ^= barcode >> 33;
+    barcode *= 0xc4ceb9fe1a85ec53ULL;
+    barcode ^= barcode >> 33;
+    return barcode;
+}
+
+uint64_t alignTo8(uint64_t offset) {
+    return (offset + 7) & ~uint64_t(7);
+}
+
+// The unit after the slash of a "129.99/кг" price.
+bool parseUnit(QStringView text, QuantityUnit& unit) {
+    text = text.trimmed();
+    if (text.compare(u"кг", Qt::CaseInsensitive) == 0 || text.compare(u"kg", Qt::CaseInsensitive) == 0) {
+        unit = QuantityUnit::Gram;
+        return true;
+    }
+    if (text.compare(u"л", Qt::CaseInsensitive) == 0 || text.compare(u"l", Qt::CaseInsensitive) == 0) {
+        unit = QuantityUnit::Milliliter;
+        return true;
+    }
+    return false;
+}
+
+}
+
+ProductCatalog::~ProductCatalog() {
+    close();
+}
+
+bool ProductCatalog::open(const QString& filePath) {
+    close();
+
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::ReadOnly)) return false;
+
+    // Version 1 headers end where the search index fields begin.
+    const qint64 fileSize = m_file.size();
+    if (fileSize < static_cast<qint64>(offsetof(Header, searchWordCount))) {
+        close();
+        return false;
+    }
+
+    m_data = m_file.map(0, fileSize);
+    if (!m_data) {
+        close();
+        return false;
+    }
+
+    const auto* header = reinterpret_cast<const Header*>(m_data);
+    const uint64_t size = static_cast<uint64_t>(fileSize);
+    const bool valid = std::memcmp(header->magic, CatalogMagic, sizeof(CatalogMagic)) == 0
+        && header->version >= 1 && header->version <= CatalogVersion
+        && header->bucketCount != 0
+        && (header->bucketCount & (header->bucketCount - 1)) == 0
+        && header->bucketsOffset + header->bucketCount * sizeof(Bucket) <= size
+        && header->recordsOffset + uint64_t(header->recordCount) * sizeof(Record) <= size
+        && header->namesOffset + header->namesLength * sizeof(char16_t) <= size;
+    if (!valid) {
+        close();
+        return false;
+    }
+
+    m_header = header;
+    m_buckets = reinterpret_cast<const Bucket*>(m_data + header->bucketsOffset);
+    m_records = reinterpret_cast<const Record*>(m_data + header->recordsOffset);
+    m_names = reinterpret_cast<const char16_t*>(m_data + header->namesOffset);
+
+    // A version 1 catalog still serves barcodes, just without name search.
+    const bool searchable = header->version >= 2
+        && fileSize >= static_cast<qint64>(offsetof(Header, unitsOffset))
+        && header->searchWordCount < UINT32_MAX
+        && header->searchWordsOffset + (header->searchWordCount + 1) * sizeof(SearchWord) <= size
+        && header->searchTextOffset + header->searchTextLength * sizeof(char16_t) <= size
+        && header->postingsOffset + header->postingCount * sizeof(uint32_t) <= size
+        && header->recordWordsBeginOffset + (uint64_t(header->recordCount) + 1) * sizeof(uint32_t) <= size
+        && header->recordWordsOffset + header->recordWordCount * sizeof(uint32_t) <= size;
+    // Only the sentinels are checked here, so opening stays O(1); the entries
+    // between them are bounded as search reads them.
+    const auto* words = reinterpret_cast<const SearchWord*>(m_data + header->searchWordsOffset);
+    const auto* recordWordsBegin = reinterpret_cast<const uint32_t*>(m_data + header->recordWordsBeginOffset);
+    if (searchable && words[header->searchWordCount].postingsBegin == header->postingCount
+        && recordWordsBegin[header->recordCount] == header->recordWordCount) {
+        m_searchWords = reinterpret_cast<const SearchWord*>(m_data + header->searchWordsOffset);
+        m_searchText = reinterpret_cast<const char16_t*>(m_data + header->searchTextOffset);
+        m_postings = reinterpret_cast<const uint32_t*>(m_data + header->postingsOffset);
+        m_recordWordsBegin = reinterpret_cast<const uint32_t*>(m_data + header->recordWordsBeginOffset);
+        m_recordWords = reinterpret_cast<const uint32_t*>(m_data + header->recordWordsOffset);
+    }
+
+    // Before version 3 every product is sold by the piece.
+    if (header->version >= 3 && fileSize >= static_cast<qint64>(sizeof(Header))
+        && header->unitsOffset + header->recordCount <= size) {
+        m_units = m_data + header->unitsOffset;
+    }
+    return true;
+}
+
+void ProductCatalog::close() {
+    if (m_data) {
+        m_file.unmap(const_cast<uchar*>(m_data));
+    }
+    m_file.close();
+    m_data = nullptr;
+    m_header = nullptr;
+    m_buckets = nullptr;
+    m_records = nullptr;
+    m_names = nullptr;
+    m_searchWords = nullptr;
+    m_searchText = nullptr;
+    m_postings = nullptr;
+    m_recordWordsBegin = nullptr;
+    m_recordWords = nullptr;
+    m_units = nullptr;
+}
+
+bool ProductCatalog::isOpen() const {
+    return m_header != nullptr;
+}
+
+uint32_t ProductCatalog::size() const {
+    return m_header ? m_header->recordCount : 0;
+}
+
+bool ProductCatalog::find(uint64_t barcode, CatalogEntry& entry) const {
+    if (!m_header || barcode == 0) return false;
+
+    const uint64_t mask = m_header->bucketCount - 1;
+    uint64_t slot = hashBarcode(barcode) & mask;
+    for (uint64_t probe = 0; probe <= mask; ++probe, slot = (slot + 1) & mask) {
+        const Bucket& bucket = m_buckets[slot];
+        if (bucket.barcode == 0) return false;
+        if (bucket.barcode == barcode) {
+            if (bucket.recordIndex >= m_header->recordCount) return false;
+            entry = entryAt(bucket.recordIndex);
+            return true;
+        }
+    }
+    return false;
+}
+
+CatalogEntry ProductCatalog::entryAt(uint32_t index) const {
+    const Record& record = m_records[index];
+    CatalogEntry entry;
+    entry.barcode = record.barcode;
+    entry.price = Money(record.price);
+    // A name outside the names block reads as empty rather than past the map.
+    if (uint64_t(record.nameOffset) + record.nameLength <= m_header->namesLength) {
+        entry.name = QStringView(m_names + record.nameOffset, record.nameLength);
+    }
+    if (m_units && m_units[index] <= static_cast<uint8_t>(QuantityUnit::Milliliter)) {
+        entry.unit = static_cast<QuantityUnit>(m_units[index]);
+    }
+    return entry;
+}
+
+bool ProductCatalog::hasSearchIndex() const {
+    return m_searchWords != nullptr;
+}
+
+uint32_t ProductCatalog::searchWordCount() const {
+    return m_searchWords ? static_cast<uint32_t>(m_header->searchWordCount) : 0;
+}
+
+// A word whose text runs past the text block reads as empty.
+std::u16string_view ProductCatalog::searchWord(uint32_t index) const {
+    const SearchWord& word = m_searchWords[index];
+    if (uint64_t(word.textOffset) + word.textLength > m_header->searchTextLength) return {};
+    return std::u16string_view(m_searchText + word.textOffset, word.textLength);
+}
+
+// Offsets past the postings are clamped to their end.
+uint32_t ProductCatalog::postingsBegin(uint32_t wordIndex) const {
+    return static_cast<uint32_t>(std::min<uint64_t>(m_searchWords[wordIndex].postingsBegin, m_header->postingCount));
+}
+
+const uint32_t* ProductCatalog::postings() const {
+    return m_postings;
+}
+
+// Offsets that run backwards or past the end read as an empty list rather
+// than outside the file.
+const uint32_t* ProductCatalog::recordWords(uint32_t record, uint32_t& count) const {
+    const uint32_t first = m_recordWordsBegin[record];
+    const uint32_t last = m_recordWordsBegin[record + 1];
+    count = first <= last && last <= m_header->recordWordCount ? last - first : 0;
+    return m_recordWords + first;
+}
+
+// 2 + a six-digit product code + five digits of weight + the EAN-13 check
+// digit. The product is listed in the catalog under its code with the weight
+// and check digit zeroed, e.g. 2123456000000.
+bool ProductCatalog::parseScaleLabel(uint64_t barcode, uint64_t& productCode, int& quantity) {
+    if (barcode < 2000000000000ULL || barcode > 2999999999999ULL) return false;
+
+    int digits[13] = {};
+    uint64_t rest = barcode;
+    for (int i = 12; i >= 0; --i, rest /= 10) digits[i] = static_cast<int>(rest % 10);
+    int sum = 0;
+    for (int i = 0; i < 12; ++i) sum += digits[i] * (i % 2 == 0 ? 1 : 3);
+    if ((10 - sum % 10) % 10 != digits[12]) return false;
+
+    productCode = barcode / 1000000 * 1000000;
+    quantity = static_cast<int>(barcode / 10 % 100000);
+    return quantity > 0;
+}
+
+bool ProductCatalog::parseBarcode(QStringView text, uint64_t& barcode) {
+    text = text.trimmed();
+    if (text.isEmpty() || text.size() > 14) return false;
+
+    uint64_t value = 0;
+    for (QChar c : text) {
+        const char16_t ch = c.unicode();
+        if (ch < u'0' || ch > u'9') return false;
+        value = value * 10 + static_cast<uint64_t>(ch - u'0');
+    }
+    if (value == 0) return false;
+
+    barcode = value;
+    return true;
+}
+
+bool ProductCatalog::build(const QString& csvPath, const QString& outputPath, QString* error) {
+    auto fail = [error](const QString& message) {
+        if (error) *error = message;
+        return false;
+    };
+
+    QFile input(csvPath);
+    if (!input.open(QIODevice::ReadOnly)) return fail("Cannot open " + csvPath);
+
+    std::vector<Record> records;
+    std::vector<uint8_t> units;
+    std::u16string names;
+    // Words are numbered as first seen and renumbered once sorted.
+    std::unordered_map<std::u16string, uint32_t> wordIds;
+    std::vector<std::vector<uint32_t>> wordRecords;
+    std::vector<uint32_t> recordWordsBegin;
+    std::vector<uint32_t> recordWords;
+    std::vector<std::u16string> words;
+
+    int lineNumber = 0;
+    while (!input.atEnd()) {
+        const QByteArray line = input.readLine();
+        ++lineNumber;
+
+        const QString text = QString::fromUtf8(line).trimmed();
+        if (text.isEmpty() || text.startsWith('#')) continue;
+
+        const qsizetype firstComma = text.indexOf(',');
+        const qsizetype secondComma = firstComma < 0 ? -1 : text.indexOf(',', firstComma + 1);
+        if (secondComma < 0) return fail(QString("Line %1: expected barcode,price,name").arg(lineNumber));
+
+        Record record{};
+        if (!parseBarcode(QStringView(text).mid(0, firstComma), record.barcode)) {
+            return fail(QString("Line %1: invalid barcode").arg(lineNumber));
+        }
+
+        QStringView priceText = QStringView(text).mid(firstComma + 1, secondComma - firstComma - 1);
+        QuantityUnit unit = QuantityUnit::Piece;
+        const qsizetype slash = priceText.indexOf(u'/');
+        if (slash >= 0) {
+            if (!parseUnit(priceText.mid(slash + 1), unit)) {
+                return fail(QString("Line %1: unknown unit, expected /кг or /л").arg(lineNumber));
+            }
+            priceText = priceText.first(slash);
+        }
+        Money price;
+        if (Money::parse(priceText.utf16(), priceText.utf16() + priceText.size(), price) != ParseStatus::Ok) {
+            return fail(QString("Line %1: invalid price").arg(lineNumber));
+        }
+        record.price = price.amount();
+
+        QStringView name = QStringView(text).mid(secondComma + 1).trimmed();
+        if (name.size() >= 2 && name.front().unicode() == u'"' && name.back().unicode() == u'"') {
+            name = name.mid(1, name.size() - 2);
+        }
+        record.nameOffset = static_cast<uint32_t>(names.size());
+        record.nameLength = static_cast<uint32_t>(name.size());
+        names.append(name.utf16(), static_cast<size_t>(name.size()));
+
+        const auto recordIndex = static_cast<uint32_t>(records.size());
+        recordWordsBegin.push_back(static_cast<uint32_t>(recordWords.size()));
+        words.clear();
+        ProductSearch::foldWords(name, words);
+        for (std::u16string& word : words) {
+            const auto [it, added] = wordIds.try_emplace(std::move(word), static_cast<uint32_t>(wordRecords.size()));
+            if (added) wordRecords.emplace_back();
+            std::vector<uint32_t>& list = wordRecords[it->second];
+            if (!list.empty() && list.back() == recordIndex) continue;
+            list.push_back(recordIndex);
+            recordWords.push_back(it->second);
+        }
+
+        records.push_back(record);
+        units.push_back(static_cast<uint8_t>(unit));
+    }
+
+    uint64_t bucketCount = 16;
+    while (bucketCount < records.size() * 2) bucketCount <<= 1;
+
+    const uint64_t mask = bucketCount - 1;
+    std::vector<Bucket> buckets(bucketCount, Bucket{0, 0, 0});
+    for (uint32_t i = 0; i < records.size(); ++i) {
+        const uint64_t barcode = records[i].barcode;
+        uint64_t slot = hashBarcode(barcode) & mask;
+        while (buckets[slot].barcode != 0) {
+            if (buckets[slot].barcode == barcode) {
+                return fail(QString("Duplicate barcode %1").arg(static_cast<qulonglong>(barcode)));
+            }
+            slot = (slot + 1) & mask;
+        }
+        buckets[slot] = Bucket{barcode, i, 0};
+    }
+
+    // Words in code unit order, as ProductSearch binary-searches them.
+    std::vector<const std::pair<const std::u16string, uint32_t>*> sortedWords;
+    sortedWords.reserve(wordIds.size());
+    for (const auto& entry : wordIds) sortedWords.push_back(&entry);
+    std::sort(sortedWords.begin(), sortedWords.end(), [](const auto* a, const auto* b) { return a->first < b->first; });
+
+    std::vector<SearchWord> searchWords;
+    std::vector<uint32_t> sortedIds(sortedWords.size());
+    std::u16string searchText;
+    std::vector<uint32_t> postings;
+    searchWords.reserve(sortedWords.size() + 1);
+    for (const auto* entry : sortedWords) {
+        sortedIds[entry->second] = static_cast<uint32_t>(searchWords.size());
+        searchWords.push_back(SearchWord{ static_cast<uint32_t>(searchText.size()), static_cast<uint32_t>(entry->first.size()),
+                                          static_cast<uint32_t>(postings.size()) });
+        searchText += entry->first;
+        const std::vector<uint32_t>& list = wordRecords[entry->second];
+        postings.insert(postings.end(), list.begin(), list.end());
+    }
+    searchWords.push_back(SearchWord{ static_cast<uint32_t>(searchText.size()), 0, static_cast<uint32_t>(postings.size()) });
+
+    recordWordsBegin.push_back(static_cast<uint32_t>(recordWords.size()));
+    for (size_t r = 0; r < records.size(); ++r) {
+        const auto first = recordWords.begin() + recordWordsBegin[r];
+        const auto last = recordWords.begin() + recordWordsBegin[r + 1];
+        for (auto it = first; it != last; ++it) *it = sortedIds[*it];
+        std::sort(first, last);
+    }
+
+    Header header{};
+    std::memcpy(header.magic, CatalogMagic, sizeof(CatalogMagic));
+    header.version = CatalogVersion;
+    header.recordCount = static_cast<uint32_t>(records.size());
+    header.bucketCount = bucketCount;
+    header.bucketsOffset = alignTo8(sizeof(Header));
+    header.recordsOffset = alignTo8(header.bucketsOffset + bucketCount * sizeof(Bucket));
+    header.namesOffset = alignTo8(header.recordsOffset + records.size() * sizeof(Record));
+    header.namesLength = names.size();
+    header.searchWordCount = sortedWords.size();
+    header.searchWordsOffset = alignTo8(header.namesOffset + names.size() * sizeof(char16_t));
+    header.searchTextOffset = alignTo8(header.searchWordsOffset + searchWords.size() * sizeof(SearchWord));
+    header.searchTextLength = searchText.size();
+    header.postingsOffset = alignTo8(header.searchTextOffset + searchText.size() * sizeof(char16_t));
+    header.postingCount = postings.size();
+    header.recordWordsBeginOffset = alignTo8(header.postingsOffset + postings.size() * sizeof(uint32_t));
+    header.recordWordsOffset = alignTo8(header.recordWordsBeginOffset + recordWordsBegin.size() * sizeof(uint32_t));
+    header.recordWordCount = recordWords.size();
+    header.unitsOffset = alignTo8(header.recordWordsOffset + recordWords.size() * sizeof(uint32_t));
+
+    QSaveFile output(outputPath);
+    if (!output.open(QIODevice::WriteOnly)) return fail("Cannot write " + outputPath);
+
+    auto writeAt = [&output](uint64_t offset, const void* data, uint64_t size) {
+        static const char padding[8] = {};
+        const qint64 gap = static_cast<qint64>(offset) - output.pos();
+        if (gap > 0) output.write(padding, gap);
+        return output.write(static_cast<const char*>(data), static_cast<qint64>(size)) == static_cast<qint64>(size);
+    };
+
+    const bool written = writeAt(0, &header, sizeof(header))
+        && writeAt(header.bucketsOffset, buckets.data(), buckets.size() * sizeof(Bucket))
+        && writeAt(header.recordsOffset, records.data(), records.size() * sizeof(Record))
+        && writeAt(header.namesOffset, names.data(), names.size() * sizeof(char16_t))
+        && writeAt(header.searchWordsOffset, searchWords.data(), searchWords.size() * sizeof(SearchWord))
+        && writeAt(header.searchTextOffset, searchText.data(), searchText.size() * sizeof(char16_t))
+        && writeAt(header.postingsOffset, postings.data(), postings.size() * sizeof(uint32_t))
+        && writeAt(header.recordWordsBeginOffset, recordWordsBegin.data(), recordWordsBegin.size() * sizeof(uint32_t))
+        && writeAt(header.recordWordsOffset, recordWords.data(), recordWords.size() * sizeof(uint32_t))
+        && writeAt(header.unitsOffset, units.data(), units.size());
+    if (!written || !output.commit()) return fail("Failed to write " + outputPath);
+
+    return true;
+}
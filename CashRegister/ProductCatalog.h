@@ -0,0 +1,85 @@
+#pragma once
+
+#include <QFile>
+#include <QString>
+#include <QStringView>
+#include <cstdint>
+#include <string_view>
+#include "money.h"
+#include "QuantityUnit.h"
+
+struct CatalogEntry {
+    uint64_t barcode = 0;
+    Money price;
+    QStringView name;
+    // Weighed products are priced per kilogram or litre.
+    QuantityUnit unit = QuantityUnit::Piece;
+};
+
+// Read-only product catalog backed by a memory-mapped binary file. Lookups by
+// EAN/UPC go through a precomputed open-addressing table inside the file, so
+// they neither parse nor allocate; opening costs a single mmap. Version 2
+// files also carry the name search index read by ProductSearch, and version 3
+// files the unit of weighed products.
+class ProductCatalog {
+public:
+    ProductCatalog() = default;
+    ~ProductCatalog();
+
+    ProductCatalog(const ProductCatalog&) = delete;
+    ProductCatalog& operator=(const ProductCatalog&) = delete;
+
+    bool open(const QString& filePath);
+    void close();
+
+    [[nodiscard]] bool isOpen() const;
+    [[nodiscard]] uint32_t size() const;
+    [[nodiscard]] bool find(uint64_t barcode, CatalogEntry& entry) const;
+    [[nodiscard]] CatalogEntry entryAt(uint32_t index) const;
+
+    // Name search index: the distinct case-folded words of all product names
+    // in code unit order, each with the ascending indices of the records whose
+    // names contain it. The postings of consecutive words are consecutive, so
+    // the words in [first, last) own postings [postingsBegin(first),
+    // postingsBegin(last)). Only the sentinels are checked on open: a damaged
+    // entry reads as an empty word, postings offsets are clamped to the
+    // postings and may run backwards, and record words may name no word.
+    [[nodiscard]] bool hasSearchIndex() const;
+    [[nodiscard]] uint32_t searchWordCount() const;
+    [[nodiscard]] std::u16string_view searchWord(uint32_t index) const;
+    [[nodiscard]] uint32_t postingsBegin(uint32_t wordIndex) const;
+    [[nodiscard]] const uint32_t* postings() const;
+    // The index words in record's name, ascending; count receives how many.
+    [[nodiscard]] const uint32_t* recordWords(uint32_t record, uint32_t& count) const;
+
+    // Compiles a UTF-8 CSV with "barcode,price,name" lines into the binary
+    // format read by open(); a price such as "129.99/кг" or "45.00/л" marks a
+    // weighed product. Returns false and fills error on failure.
+    static bool build(const QString& csvPath, const QString& outputPath, QString* error = nullptr);
+
+    static bool parseBarcode(QStringView text, uint64_t& barcode);
+
+    // Decodes the EAN-13 label a deli or produce scale prints: the catalog
+    // code of the weighed product and its weight in grams or millilitres.
+    // False for anything else, including a wrong check digit.
+    static bool parseScaleLabel(uint64_t barcode, uint64_t& productCode, int& quantity);
+
+private:
+    struct Header;
+    struct Bucket;
+    struct Record;
+    struct SearchWord;
+
+    QFile m_file;
+    const uchar* m_data = nullptr;
+    const Header* m_header = nullptr;
+    const Bucket* m_buckets = nullptr;
+    const Record* m_records = nullptr;
+    const char16_t* m_names = nullptr;
+    const SearchWord* m_searchWords = nullptr;
+    const char16_t* m_searchText = nullptr;
+    const uint32_t* m_postings = nullptr;
+    const uint32_t* m_recordWordsBegin = nullptr;
+    const uint32_t* m_recordWords = nullptr;
+    const uchar* m_units = nullptr;
+};
@@ -0,0 +1,296 @@
+#include "ProductSearch.h"
+#include "ProductCatalog.h"
+#include <QChar>
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+// ', ’, ʼ, ` and ´ all stand for the apostrophe in Ukrainian names.
+bool isApostrophe(char16_t c) {
+    return c == u'\'' || c == u'\u2019' || c == u'\u02BC' || c == u'`' || c == u'\u00B4';
+}
+
+// Case folding covers Cyrillic; ё is further folded into е.
+char16_t foldChar(char16_t c) {
+    if (isApostrophe(c)) return u'\'';
+    if (c == u',') return u'.';
+    c = QChar(c).toCaseFolded().unicode();
+    return c == u'\u0451' ? u'\u0435' : c;
+}
+
+bool isWordChar(QStringView text, qsizetype i) {
+    const QChar c = text[i];
+    if (c.isLetterOrNumber()) return true;
+    if (i == 0 || i + 1 >= text.size()) return false;
+    const QChar before = text[i - 1];
+    const QChar after = text[i + 1];
+    if (isApostrophe(c.unicode())) return before.isLetter() && after.isLetter();
+    if (c == u'.' || c == u',') return before.isDigit() && after.isDigit();
+    return false;
+}
+
+bool startsWith(std::u16string_view text, std::u16string_view prefix) {
+    return text.size() >= prefix.size() && text.compare(0, prefix.size(), prefix) == 0;
+}
+
+}
+
+ProductSearch::ProductSearch(const ProductCatalog* catalog) : m_catalog(catalog) {}
+
+void ProductSearch::setCatalog(const ProductCatalog* catalog) {
+    m_catalog = catalog;
+    m_states.clear();
+}
+
+void ProductSearch::clear() {
+    m_states.clear();
+}
+
+const std::vector<uint32_t>& ProductSearch::results() const {
+    static const std::vector<uint32_t> none;
+    return m_states.empty() ? none : m_states.back().results;
+}
+
+bool ProductSearch::isComplete() const {
+    return m_states.empty() || m_states.back().complete;
+}
+
+bool ProductSearch::isFuzzy() const {
+    if (m_states.empty()) return false;
+    const std::vector<Term>& terms = m_states.back().terms;
+    return std::any_of(terms.begin(), terms.end(), [](const Term& term) { return term.fuzzy; });
+}
+
+void ProductSearch::foldWords(QStringView text, std::vector<std::u16string>& words) {
+    qsizetype i = 0;
+    while (i < text.size()) {
+        if (!isWordChar(text, i)) {
+            ++i;
+            continue;
+        }
+        std::u16string& word = words.emplace_back();
+        for (; i < text.size() && isWordChar(text, i); ++i) word.push_back(foldChar(text[i].unicode()));
+    }
+}
+
+// Earlier states serve as the base of any query that extends them, so typing
+// narrows the top state and deleting pops back to one.
+void ProductSearch::setQuery(QStringView query) {
+    std::vector<std::u16string> words;
+    foldWords(query, words);
+    if (words.empty() || !m_catalog || !m_catalog->hasSearchIndex()) {
+        m_states.clear();
+        return;
+    }
+
+    while (!m_states.empty() && !refines(m_states.back(), words)) m_states.pop_back();
+    if (!m_states.empty()) {
+        const std::vector<Term>& terms = m_states.back().terms;
+        const bool same = terms.size() == words.size()
+            && std::equal(terms.begin(), terms.end(), words.begin(), [](const Term& term, const std::u16string& word) {
+                   return term.text == word;
+               });
+        if (same) return;
+    }
+
+    State next = search(words, m_states.empty() ? nullptr : &m_states.back());
+    if (m_states.size() == MaxStates) m_states.erase(m_states.begin());
+    m_states.push_back(std::move(next));
+}
+
+// Every product matching words also matches state's query: the words are the
+// same but for more of them or a longer last one.
+bool ProductSearch::refines(const State& state, const std::vector<std::u16string>& words) {
+    const size_t count = state.terms.size();
+    if (count > words.size()) return false;
+    for (size_t i = 0; i + 1 < count; ++i) {
+        if (state.terms[i].text != words[i]) return false;
+    }
+    return startsWith(words[count - 1], state.terms[count - 1].text);
+}
+
+ProductSearch::State ProductSearch::search(const std::vector<std::u16string>& words, const State* base) const {
+    const Range everything{ 0, m_catalog->searchWordCount() };
+
+    State state;
+    state.terms.resize(words.size());
+    for (size_t i = 0; i < words.size(); ++i) {
+        Term& term = state.terms[i];
+        const Term* previous = base && i < base->terms.size() ? &base->terms[i] : nullptr;
+        if (previous && previous->text == words[i]) {
+            term = *previous;
+            continue;
+        }
+        term.text = words[i];
+        // A longer prefix lies within the range of a shorter one.
+        Range within = everything;
+        if (previous && !previous->fuzzy) within = previous->ranges.empty() ? Range{ 0, 0 } : previous->ranges.front();
+        matchTerm(term, within);
+    }
+
+    // The base's results are a superset unless a word has just fallen back
+    // from exact to fuzzy matching.
+    bool narrowing = base && base->complete;
+    for (size_t i = 0; narrowing && i < base->terms.size(); ++i) {
+        narrowing = base->terms[i].fuzzy || !state.terms[i].fuzzy;
+    }
+    if (narrowing) {
+        for (uint32_t record : base->results) {
+            if (recordMatches(record, state.terms, nullptr)) state.results.push_back(record);
+        }
+        return state;
+    }
+
+    enumerate(state);
+    return state;
+}
+
+void ProductSearch::matchTerm(Term& term, Range within) const {
+    const Range exact = prefixRange(term.text, within);
+    if (exact.first < exact.last) {
+        term.ranges.push_back(exact);
+        return;
+    }
+    if (term.text.size() < MinFuzzyLength || term.text.size() > MaxFuzzyLength) return;
+
+    term.fuzzy = true;
+    std::vector<int> row(term.text.size() + 1);
+    for (size_t j = 0; j < row.size(); ++j) row[j] = static_cast<int>(j);
+    collectFuzzy(term.text, Range{ 0, m_catalog->searchWordCount() }, 0, row, term.ranges);
+}
+
+ProductSearch::Range ProductSearch::prefixRange(std::u16string_view prefix, Range within) const {
+    uint32_t first = within.first;
+    uint32_t last = within.last;
+    while (first < last) {
+        const uint32_t mid = first + (last - first) / 2;
+        if (m_catalog->searchWord(mid) < prefix) first = mid + 1;
+        else last = mid;
+    }
+
+    uint32_t end = within.last;
+    last = first;
+    while (last < end) {
+        const uint32_t mid = last + (end - last) / 2;
+        if (startsWith(m_catalog->searchWord(mid), prefix)) last = mid + 1;
+        else end = mid;
+    }
+    return Range{ first, last };
+}
+
+// Walks the sorted words as a trie: node holds the words sharing a prefix of
+// length depth, and row the edit distances from each prefix of term to it.
+// A node within one edit of all of term matches as a whole; one that is more
+// than an edit away from every prefix of term is pruned.
+void ProductSearch::collectFuzzy(std::u16string_view term, Range node, size_t depth, const std::vector<int>& row,
+                                 std::vector<Range>& out) const {
+    const size_t n = term.size();
+    if (row[n] <= 1) {
+        out.push_back(node);
+        return;
+    }
+    if (*std::min_element(row.begin(), row.end()) > 1) return;
+
+    // Only the word equal to the prefix itself ends here; it sorts first.
+    uint32_t child = node.first;
+    if (child < node.last && m_catalog->searchWord(child).size() == depth) ++child;
+
+    // Words of a sound index are longer than depth past the first; a damaged
+    // one that is not is skipped.
+    std::vector<int> next(n + 1);
+    while (child < node.last) {
+        const std::u16string_view word = m_catalog->searchWord(child);
+        if (word.size() <= depth) {
+            ++child;
+            continue;
+        }
+        const char16_t c = word[depth];
+        uint32_t first = child + 1;
+        uint32_t last = node.last;
+        while (first < last) {
+            const uint32_t mid = first + (last - first) / 2;
+            const std::u16string_view other = m_catalog->searchWord(mid);
+            if (other.size() > depth && other[depth] == c) first = mid + 1;
+            else last = mid;
+        }
+
+        next[0] = row[0] + 1;
+        for (size_t j = 1; j <= n; ++j) {
+            next[j] = std::min({ row[j] + 1, next[j - 1] + 1, row[j - 1] + (term[j - 1] != c ? 1 : 0) });
+        }
+        collectFuzzy(term, Range{ child, first }, depth + 1, next, out);
+        child = first;
+    }
+}
+
+uint32_t ProductSearch::postingCount(const Term& term) const {
+    uint32_t count = 0;
+    for (const Range& range : term.ranges) {
+        const uint32_t begin = m_catalog->postingsBegin(range.first);
+        const uint32_t end = m_catalog->postingsBegin(range.last);
+        if (begin < end) count += end - begin;
+    }
+    return count;
+}
+
+// A record matches a term when one of its index words falls in the term's
+// ranges, so checking a candidate never looks at its name. A word id past the
+// index matches nothing.
+bool ProductSearch::recordMatches(uint32_t record, const std::vector<Term>& terms, const Term* skip) const {
+    uint32_t count = 0;
+    const uint32_t* words = m_catalog->recordWords(record, count);
+    const uint32_t wordCount = m_catalog->searchWordCount();
+    for (const Term& term : terms) {
+        if (&term == skip) continue;
+        const bool found = std::any_of(words, words + count, [&term, wordCount](uint32_t word) {
+            if (word >= wordCount) return false;
+            const auto after = std::upper_bound(term.ranges.begin(), term.ranges.end(), word,
+                                                [](uint32_t value, const Range& range) { return value < range.first; });
+            return after != term.ranges.begin() && word < std::prev(after)->last;
+        });
+        if (!found) return false;
+    }
+    return true;
+}
+
+// Walks the postings of the most selective word and checks the others against
+// each candidate's name. The walk stops at MaxResults, or once CheckBudget
+// candidates have been checked, leaving the state incomplete.
+void ProductSearch::enumerate(State& state) const {
+    const Term* driver = nullptr;
+    uint32_t fewest = UINT32_MAX;
+    for (const Term& term : state.terms) {
+        const uint32_t count = postingCount(term);
+        if (count < fewest) {
+            fewest = count;
+            driver = &term;
+        }
+    }
+    if (fewest == 0) return;
+
+    const bool single = state.terms.size() == 1;
+    const uint32_t* postings = m_catalog->postings();
+    const uint32_t recordCount = m_catalog->size();
+    int budget = CheckBudget;
+    for (const Range& range : driver->ranges) {
+        const uint32_t end = m_catalog->postingsBegin(range.last);
+        for (uint32_t p = m_catalog->postingsBegin(range.first); p < end; ++p) {
+            const uint32_t record = postings[p];
+            if (record >= recordCount) continue;
+            if (std::find(state.results.begin(), state.results.end(), record) != state.results.end()) continue;
+            if (!single) {
+                if (--budget < 0) {
+                    state.complete = false;
+                    return;
+                }
+                if (!recordMatches(record, state.terms, driver)) continue;
+            }
+            if (static_cast<int>(state.results.size()) == MaxResults) {
+                state.complete = false;
+                return;
+            }
+            state.results.push_back(record);
+        }
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <QStringView>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class ProductCatalog;
+
+// Finds catalog products by name as the cashier types. Every word of the query
+// must begin some word of the product name, in any order: "мол 2.5" finds
+// "Молоко Яготинське 2.5% 900 г". Capital and small letters match, Cyrillic
+// included, as do ё and е and the apostrophe variants. A query word that
+// begins no word in the catalog is matched within one typo instead.
+//
+// The word index is precomputed in the catalog file (ProductCatalog::build),
+// and queries are refined incrementally: a query that extends the previous one
+// narrows the previous word ranges instead of searching the whole index, and
+// filters the previous results directly when they held every match. Deleting
+// characters returns to an earlier state without searching at all.
+class ProductSearch {
+public:
+    static constexpr int MaxResults = 50;
+
+    explicit ProductSearch(const ProductCatalog* catalog = nullptr);
+
+    // Also forgets the query; call it again after the catalog is reopened.
+    void setCatalog(const ProductCatalog* catalog);
+
+    void setQuery(QStringView query);
+    void clear();
+
+    // Catalog record indices of up to MaxResults matches.
+    [[nodiscard]] const std::vector<uint32_t>& results() const;
+    // Whether results() holds every match rather than the first MaxResults.
+    [[nodiscard]] bool isComplete() const;
+    // Whether some query word was matched within one typo.
+    [[nodiscard]] bool isFuzzy() const;
+
+    // Splits text into the case-folded words the index is built from: runs of
+    // letters and digits, keeping apostrophes inside words ("м'ясо") and
+    // decimal points inside numbers ("2.5").
+    static void foldWords(QStringView text, std::vector<std::u16string>& words);
+
+private:
+    // Index words [first, last).
+    struct Range {
+        uint32_t first;
+        uint32_t last;
+    };
+
+    struct Term {
+        std::u16string text;
+        bool fuzzy = false;
+        // The index words it matches, disjoint and in index order.
+        std::vector<Range> ranges;
+    };
+
+    struct State {
+        std::vector<Term> terms;
+        std::vector<uint32_t> results;
+        bool complete = true;
+    };
+
+    static constexpr size_t MaxStates = 64;
+    // Shorter words match too much of the catalog within one typo.
+    static constexpr size_t MinFuzzyLength = 3;
+    static constexpr size_t MaxFuzzyLength = 63;
+    // Candidates checked against the other query words per keystroke.
+    static constexpr int CheckBudget = 4096;
+
+    static bool refines(const State& state, const std::vector<std::u16string>& words);
+    [[nodiscard]] State search(const std::vector<std::u16string>& words, const State* base) const;
+    void matchTerm(Term& term, Range within) const;
+    [[nodiscard]] Range prefixRange(std::u16string_view prefix, Range within) const;
+    void collectFuzzy(std::u16string_view term, Range node, size_t depth, const std::vector<int>& row,
+                      std::vector<Range>& out) const;
+    [[nodiscard]] uint32_t postingCount(const Term& term) const;
+    [[nodiscard]] bool recordMatches(uint32_t record, const std::vector<Term>& terms, const Term* skip) const;
+    void enumerate(State& state) const;
+
+    const ProductCatalog* m_catalog;
+    // The states of the query's shorter forms, the current one last.
+    std::vector<State> m_states;
+};
@@ -0,0 +1,42 @@
+#include "ProductSearchModel.h"
+#include "ProductCatalog.h"
+
+ProductSearchModel::ProductSearchModel(QObject* parent)
+    : QAbstractListModel(parent), m_catalog(nullptr) {}
+
+void ProductSearchModel::setCatalog(const ProductCatalog* catalog) {
+    beginResetModel();
+    m_catalog = catalog;
+    m_search.setCatalog(catalog);
+    endResetModel();
+}
+
+// At most MaxResults rows, so resetting is cheaper than diffing the lists.
+void ProductSearchModel::setQuery(QStringView query) {
+    beginResetModel();
+    m_search.setQuery(query);
+    endResetModel();
+}
+
+bool ProductSearchModel::isComplete() const {
+    return m_search.isComplete();
+}
+
+int ProductSearchModel::rowCount(const QModelIndex& parent) const {
+    if (parent.isValid()) return 0;
+    return static_cast<int>(m_search.results().size());
+}
+
+QVariant ProductSearchModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || index.row() >= rowCount()) return {};
+
+    const CatalogEntry entry = m_catalog->entryAt(m_search.results()[static_cast<size_t>(index.row())]);
+    switch (role) {
+    case Qt::DisplayRole:
+        return QString("%1 — %2").arg(entry.name.toString(), entry.price.toString());
+    case BarcodeRole:
+        return QVariant::fromValue<qulonglong>(entry.barcode);
+    default:
+        return {};
+    }
+}
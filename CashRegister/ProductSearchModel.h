@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include "ProductSearch.h"
+
+// Lists the products ProductSearch finds for the query typed so far, one row
+// per product: its name and price for display and its barcode under
+// BarcodeRole for adding it to the receipt.
+class ProductSearchModel : public QAbstractListModel {
+    Q_OBJECT
+
+public:
+    enum Role {
+        BarcodeRole = Qt::UserRole
+    };
+
+    explicit ProductSearchModel(QObject* parent = nullptr);
+
+    // Also empties the list; catalog must outlive the model or be replaced.
+    void setCatalog(const ProductCatalog* catalog);
+    void setQuery(QStringView query);
+
+    [[nodiscard]] bool isComplete() const;
+
+    [[nodiscard]] int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    [[nodiscard]] QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+private:
+    const ProductCatalog* m_catalog;
+    ProductSearch m_search;
+};
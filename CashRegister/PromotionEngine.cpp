@@ -0,0 +1,283 @@
+#include "PromotionEngine.h"
+#include "ProductCatalog.h"
+#include <QFile>
+#include <QStringList>
+#include <algorithm>
+
+namespace {
+
+bool parseMoney(QStringView text, Money& out) {
+    return Money::parse(text.utf16(), text.utf16() + text.size(), out) == ParseStatus::Ok;
+}
+
+// Percentages have two decimals, so "12.5" is 1250 basis points.
+bool parsePercent(QStringView text, int& basisPoints) {
+    int64_t value = 0;
+    if (MoneyDetail::parseDecimal(text.utf16(), text.utf16() + text.size(), value, RoundingMode::HalfUp) != ParseStatus::Ok
+        || value < 0 || value > 10000) {
+        return false;
+    }
+    basisPoints = static_cast<int>(value);
+    return true;
+}
+
+bool parseBarcodes(const QString& text, std::vector<uint64_t>& barcodes) {
+    for (const QString& part : text.split(';', Qt::SkipEmptyParts)) {
+        uint64_t barcode = 0;
+        if (!ProductCatalog::parseBarcode(QStringView(part).trimmed(), barcode)) return false;
+        barcodes.push_back(barcode);
+    }
+    return !barcodes.empty();
+}
+
+}
+
+PromotionEngine::PromotionEngine()
+    : m_compiled(false), m_gross(0), m_itemDiscount(0), m_thresholdDiscount(0), m_thresholdRule(-1) {}
+
+uint32_t PromotionEngine::addRule(PromotionRule rule) {
+    m_rules.push_back(std::move(rule));
+    m_compiled = false;
+    return static_cast<uint32_t>(m_rules.size() - 1);
+}
+
+void PromotionEngine::setCategory(uint64_t barcode, uint32_t category) {
+    m_categories[barcode] = category;
+    m_compiled = false;
+}
+
+void PromotionEngine::clearRules() {
+    m_rules.clear();
+    m_categories.clear();
+    m_compiled = false;
+}
+
+size_t PromotionEngine::ruleCount() const {
+    return m_rules.size();
+}
+
+bool PromotionEngine::load(const QString& path, QString* error) {
+    auto fail = [error](const QString& message) {
+        if (error) *error = message;
+        return false;
+    };
+
+    QFile input(path);
+    if (!input.open(QIODevice::ReadOnly)) return fail("Cannot open " + path);
+
+    int lineNumber = 0;
+    while (!input.atEnd()) {
+        const QByteArray line = input.readLine();
+        ++lineNumber;
+
+        const QString text = QString::fromUtf8(line).trimmed();
+        if (text.isEmpty() || text.startsWith('#')) continue;
+
+        QStringList fields = text.split(',');
+        for (QString& field : fields) field = field.trimmed();
+        const QString& kind = fields[0];
+        auto invalid = [&](const char* expected) {
+            return fail(QString("Line %1: expected %2").arg(lineNumber).arg(expected));
+        };
+
+        PromotionRule rule;
+        bool ok = true;
+        if (kind == "category") {
+            if (fields.size() != 3) return invalid("category,id,barcodes");
+            const uint32_t category = fields[1].toUInt(&ok);
+            std::vector<uint64_t> barcodes;
+            if (!ok || !parseBarcodes(fields[2], barcodes)) return invalid("category,id,barcodes");
+            for (uint64_t barcode : barcodes) setCategory(barcode, category);
+            continue;
+        } else if (kind == "multibuy" || kind == "mixmatch") {
+            if (fields.size() != 5) return invalid("name,barcodes,count,price");
+            rule.kind = kind == "multibuy" ? PromotionKind::MultiBuy : PromotionKind::MixAndMatch;
+            rule.bundleSize = fields[3].toInt(&ok);
+            if (!ok || rule.bundleSize <= 0 || !parseBarcodes(fields[2], rule.products)
+                || (rule.kind == PromotionKind::MultiBuy && rule.products.size() != 1)
+                || !parseMoney(fields[4], rule.bundlePrice)) {
+                return invalid("name,barcodes,count,price");
+            }
+        } else if (kind == "percent") {
+            if (fields.size() != 4) return invalid("percent,name,category,percent");
+            rule.kind = PromotionKind::CategoryPercent;
+            rule.category = fields[2].toUInt(&ok);
+            if (!ok || !parsePercent(fields[3], rule.percentBp)) return invalid("percent,name,category,percent");
+        } else if (kind == "threshold") {
+            if (fields.size() != 5) return invalid("threshold,name,minimum,percent,amount");
+            rule.kind = PromotionKind::ReceiptThreshold;
+            if (!parseMoney(fields[2], rule.minimumSpend) || !parsePercent(fields[3], rule.percentBp)
+                || !parseMoney(fields[4], rule.amountOff)) {
+                return invalid("threshold,name,minimum,percent,amount");
+            }
+        } else {
+            return fail(QString("Line %1: unknown rule kind '%2'").arg(lineNumber).arg(kind));
+        }
+        rule.name = fields[1];
+        addRule(std::move(rule));
+    }
+    return true;
+}
+
+void PromotionEngine::compile() {
+    m_productRules.clear();
+    m_thresholds.clear();
+
+    // The first bundle rule listing a product claims it; of a category's
+    // percentages only the largest applies.
+    std::unordered_map<uint32_t, uint32_t> categoryRules;
+    for (uint32_t id = 0; id < m_rules.size(); ++id) {
+        const PromotionRule& rule = m_rules[id];
+        switch (rule.kind) {
+        case PromotionKind::MultiBuy:
+        case PromotionKind::MixAndMatch:
+            for (uint64_t barcode : rule.products) m_productRules.emplace(barcode, id);
+            break;
+        case PromotionKind::CategoryPercent: {
+            auto best = categoryRules.emplace(rule.category, id).first;
+            if (rule.percentBp > m_rules[best->second].percentBp) best->second = id;
+            break;
+        }
+        case PromotionKind::ReceiptThreshold:
+            m_thresholds.push_back(id);
+            break;
+        }
+    }
+
+    // A product's category is fixed, so a product no bundle claims takes its
+    // category's rule and a scan needs a single lookup.
+    for (const auto& [barcode, category] : m_categories) {
+        auto it = categoryRules.find(category);
+        if (it != categoryRules.end()) m_productRules.emplace(barcode, it->second);
+    }
+
+    std::sort(m_thresholds.begin(), m_thresholds.end(), [this](uint32_t a, uint32_t b) {
+        return m_rules[a].minimumSpend < m_rules[b].minimumSpend;
+    });
+
+    m_compiled = true;
+    reset();
+}
+
+void PromotionEngine::reset() {
+    m_state.assign(m_rules.size(), RuleState());
+    m_active.clear();
+    m_activePosition.assign(m_rules.size(), -1);
+    m_gross = 0;
+    m_itemDiscount = 0;
+    m_thresholdDiscount = 0;
+    m_thresholdRule = -1;
+}
+
+void PromotionEngine::lineChanged(uint64_t barcode, int64_t unitPrice, int64_t units, Money total) {
+    if (!m_compiled) compile();
+
+    m_gross += total.amount();
+    if (barcode != 0) {
+        auto it = m_productRules.find(barcode);
+        if (it != m_productRules.end()) {
+            const uint32_t id = it->second;
+            RuleState& state = m_state[id];
+            state.units += units;
+            state.gross += total.amount();
+            if (units != 0) {
+                auto price = state.unitsByPrice.emplace(unitPrice, 0).first;
+                price->second += units;
+                if (price->second == 0) state.unitsByPrice.erase(price);
+            }
+            evaluate(id);
+        }
+    }
+    evaluateThreshold();
+}
+
+void PromotionEngine::evaluate(uint32_t ruleId) {
+    const PromotionRule& rule = m_rules[ruleId];
+    RuleState& state = m_state[ruleId];
+
+    int64_t discount = 0;
+    switch (rule.kind) {
+    case PromotionKind::MultiBuy:
+    case PromotionKind::MixAndMatch:
+        if (rule.bundleSize > 0 && state.units >= rule.bundleSize) {
+            // Bundles take the most expensive units, which favours the customer.
+            const int64_t bundles = state.units / rule.bundleSize;
+            int64_t remaining = bundles * rule.bundleSize;
+            int64_t bundled = 0;
+            for (auto it = state.unitsByPrice.rbegin(); it != state.unitsByPrice.rend() && remaining > 0; ++it) {
+                const int64_t take = std::min(remaining, it->second);
+                bundled += it->first * take;
+                remaining -= take;
+            }
+            discount = std::max<int64_t>(0, bundled - rule.bundlePrice.amount() * bundles);
+        }
+        break;
+    case PromotionKind::CategoryPercent:
+        if (state.gross > 0) discount = Money(state.gross).mulDiv(rule.percentBp, 10000).amount();
+        break;
+    case PromotionKind::ReceiptThreshold:
+        return;
+    }
+    // A rule's products are its alone, so this caps every product's discount
+    // at what its lines are worth.
+    discount = std::clamp<int64_t>(discount, 0, std::max<int64_t>(state.gross, 0));
+
+    m_itemDiscount += discount - state.discount;
+    state.discount = discount;
+    setActive(ruleId, discount != 0);
+}
+
+void PromotionEngine::evaluateThreshold() {
+    const int64_t net = m_gross - m_itemDiscount;
+    auto tier = std::upper_bound(m_thresholds.begin(), m_thresholds.end(), net, [this](int64_t value, uint32_t id) {
+        return value < m_rules[id].minimumSpend.amount();
+    });
+
+    int ruleId = -1;
+    int64_t discount = 0;
+    if (tier != m_thresholds.begin() && net > 0) {
+        ruleId = static_cast<int>(*(tier - 1));
+        const PromotionRule& rule = m_rules[ruleId];
+        discount = rule.amountOff.amount() + Money(net).mulDiv(rule.percentBp, 10000).amount();
+        discount = std::min(discount, net);
+    }
+
+    if (m_thresholdRule >= 0 && m_thresholdRule != ruleId) {
+        m_state[m_thresholdRule].discount = 0;
+        setActive(static_cast<uint32_t>(m_thresholdRule), false);
+    }
+    if (ruleId >= 0) {
+        m_state[ruleId].discount = discount;
+        setActive(static_cast<uint32_t>(ruleId), discount != 0);
+    }
+    m_thresholdRule = ruleId;
+    m_thresholdDiscount = discount;
+}
+
+void PromotionEngine::setActive(uint32_t ruleId, bool active) {
+    const int position = m_activePosition[ruleId];
+    if (active && position < 0) {
+        m_activePosition[ruleId] = static_cast<int>(m_active.size());
+        m_active.push_back(ruleId);
+    } else if (!active && position >= 0) {
+        const uint32_t moved = m_active.back();
+        m_active[position] = moved;
+        m_activePosition[moved] = position;
+        m_active.pop_back();
+        m_activePosition[ruleId] = -1;
+    }
+}
+
+Money PromotionEngine::discount() const {
+    const int64_t total = m_itemDiscount + m_thresholdDiscount;
+    return Money(std::clamp<int64_t>(total, 0, std::max<int64_t>(m_gross, 0)));
+}
+
+std::vector<AppliedDiscount> PromotionEngine::appliedDiscounts() const {
+    std::vector<AppliedDiscount> result;
+    result.reserve(m_active.size());
+    for (uint32_t id : m_active) {
+        result.push_back(AppliedDiscount{id, m_rules[id].name, Money(m_state[id].discount)});
+    }
+    return result;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <QString>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include "money.h"
+
+enum class PromotionKind : uint8_t {
+    MultiBuy,           // bundleSize units of one product for bundlePrice
+    MixAndMatch,        // any bundleSize units from products for bundlePrice
+    CategoryPercent,    // percentBp off every line in category
+    ReceiptThreshold    // percentBp and/or amountOff once the receipt reaches minimumSpend
+};
+
+struct PromotionRule {
+    PromotionKind kind = PromotionKind::MultiBuy;
+    QString name;
+    std::vector<uint64_t> products;
+    uint32_t category = 0;
+    int bundleSize = 0;
+    Money bundlePrice;
+    int percentBp = 0;
+    Money minimumSpend;
+    Money amountOff;
+};
+
+struct AppliedDiscount {
+    uint32_t ruleId = 0;
+    QString name;
+    Money amount;
+};
+
+// Receipt promotions evaluated incrementally. Rules are compiled into an index
+// from barcode to the one item rule it can affect, so a line change
+// re-evaluates only that rule; receipt thresholds are tiered and looked up by
+// binary search. Only the highest threshold tier that is met applies.
+//
+// Item rules do not stack: a product counts towards at most one of them, so no
+// unit is discounted twice. Multibuy and mix-and-match rules claim their
+// products in the order they were added, the earlier rule winning; a product
+// no bundle claims gets the largest percentage of its category. Each rule's
+// discount is capped at the value of its lines, and the receipt threshold
+// applies to what is left after item discounts.
+//
+// The engine sees the receipt only through lineChanged() deltas; changing the
+// rules or categories clears that state.
+class PromotionEngine {
+public:
+    PromotionEngine();
+
+    uint32_t addRule(PromotionRule rule);
+    void setCategory(uint64_t barcode, uint32_t category);
+    void clearRules();
+    [[nodiscard]] size_t ruleCount() const;
+
+    // Loads comma-separated rules, one per line ('#' starts a comment); the
+    // order of bundle rules is their priority:
+    //   category,<id>,<barcode>[;<barcode>...]
+    //   multibuy,<name>,<barcode>,<count>,<price>
+    //   mixmatch,<name>,<barcode>[;<barcode>...],<count>,<price>
+    //   percent,<name>,<category>,<percent>
+    //   threshold,<name>,<minimum spend>,<percent>,<amount off>
+    // Returns false and fills error on failure; rules loaded so far are kept.
+    bool load(const QString& path, QString* error = nullptr);
+
+    // Forgets the current receipt.
+    void reset();
+
+    // A receipt line was added, changed or removed. units is the change in
+    // counted pieces (zero for weighed goods) and total the change in line total.
+    void lineChanged(uint64_t barcode, int64_t unitPrice, int64_t units, Money total);
+
+    [[nodiscard]] Money discount() const;
+    [[nodiscard]] std::vector<AppliedDiscount> appliedDiscounts() const;
+
+private:
+    struct RuleState {
+        int64_t units = 0;
+        int64_t gross = 0;
+        std::map<int64_t, int64_t> unitsByPrice;
+        int64_t discount = 0;
+    };
+
+    void compile();
+    void evaluate(uint32_t ruleId);
+    void evaluateThreshold();
+    void setActive(uint32_t ruleId, bool active);
+
+    std::vector<PromotionRule> m_rules;
+    std::unordered_map<uint64_t, uint32_t> m_categories;
+
+    // Compiled index, rebuilt lazily after rules or categories change.
+    std::unordered_map<uint64_t, uint32_t> m_productRules;
+    std::vector<uint32_t> m_thresholds;
+    bool m_compiled;
+
+    std::vector<RuleState> m_state;
+    std::vector<uint32_t> m_active;
+    std::vector<int> m_activePosition;
+    int64_t m_gross;
+    int64_t m_itemDiscount;
+    int64_t m_thresholdDiscount;
+    int m_thresholdRule;
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+
+// Weighed goods carry their quantity in grams or millilitres and are priced
+// per kilogram or litre.
+enum class QuantityUnit : uint8_t {
+    Piece,
+    Gram,
+    Milliliter
+};
+
+constexpr int quantityScale(QuantityUnit unit) {
+    return unit == QuantityUnit::Piece ? 1 : 1000;
+}
@@ -0,0 +1,829 @@
+#include "Receipt.h"
+#include "ProductCatalog.h"
+#include "ReceiptJournal.h"
+#include "MoneyKernels.h"
+#include <QtGlobal>
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+namespace {
+
+bool saturated(SaturatingMoney amount) {
+    return amount.amount() == std::numeric_limits<int64_t>::max()
+        || amount.amount() == std::numeric_limits<int64_t>::min();
+}
+
+}
+
+ReceiptItem::ReceiptItem() : m_name(""), m_price(Money(0)), m_quantity(0), m_barcode(0), m_unit(QuantityUnit::Piece) {}
+
+ReceiptItem::ReceiptItem(QString name, Money price, int quantity, uint64_t barcode, QuantityUnit unit)
+    : m_name(std::move(name)), m_price(price), m_quantity(quantity > 0 ? quantity : 1), m_barcode(barcode), m_unit(unit) {}
+
+QString ReceiptItem::name() const { return m_name; }
+Money ReceiptItem::price() const { return m_price; }
+int ReceiptItem::quantity() const { return m_quantity; }
+uint64_t ReceiptItem::barcode() const { return m_barcode; }
+QuantityUnit ReceiptItem::unit() const { return m_unit; }
+bool ReceiptItem::isWeighed() const { return m_unit != QuantityUnit::Piece; }
+int64_t ReceiptItem::itemCount() const { return isWeighed() ? 1 : m_quantity; }
+
+void ReceiptItem::setQuantity(int quantity) {
+    if (quantity > 0) {
+        m_quantity = quantity;
+    }
+}
+
+Money ReceiptItem::total(RoundingMode mode) const {
+    if (!isWeighed()) return m_price * m_quantity;
+    return m_price.mulDiv(m_quantity, quantityScale(m_unit), mode);
+}
+
+Receipt::UpdateScope::UpdateScope(Receipt& receipt)
+    : m_receipt(receipt) {
+    m_receipt.beginUpdate();
+}
+
+Receipt::UpdateScope::~UpdateScope() {
+    m_receipt.endUpdate();
+}
+
+// An empty snapshot has no lines to name, so it needs no pool.
+ReceiptSnapshot::ReceiptSnapshot()
+    : m_subtotal(0), m_itemCount(0), m_weighedLines(0),
+    m_weightRounding(RoundingMode::HalfUp) {}
+
+int ReceiptSnapshot::lineCount() const {
+    return m_lines.size();
+}
+
+bool ReceiptSnapshot::isEmpty() const {
+    return m_lines.isEmpty();
+}
+
+ReceiptItem ReceiptSnapshot::getItem(int row) const {
+    if (row < 0 || row >= lineCount()) return {};
+    const ReceiptLine line = m_lines.line(row);
+    return ReceiptItem(m_names->name(line.nameId), Money(line.price), line.quantity, line.barcode, line.unit);
+}
+
+std::vector<ReceiptItem> ReceiptSnapshot::items() const {
+    std::vector<ReceiptItem> result;
+    result.reserve(static_cast<size_t>(lineCount()));
+    m_lines.forEachRun([this, &result](const ReceiptLines::Run& run) {
+        for (int i = 0; i < run.count; ++i) {
+            result.emplace_back(m_names->name(run.nameIds[i]), Money(run.prices[i]), run.quantities[i],
+                                run.barcodes[i], run.units[i]);
+        }
+    });
+    return result;
+}
+
+Money ReceiptSnapshot::subtotal() const {
+    return Money(m_subtotal);
+}
+
+int64_t ReceiptSnapshot::itemCount() const {
+    return m_itemCount;
+}
+
+Receipt::Receipt()
+    : m_arena(std::make_shared<ReceiptArena>()), m_lines(m_arena.get()),
+    m_names(std::make_shared<NamePool>()), m_lineIndex(m_arena.get()), m_lineIndexValid(true),
+    m_duplicatePolicy(DuplicatePolicy::Merge), m_journal(nullptr), m_observer(nullptr),
+    m_weighedLines(0), m_weightRounding(RoundingMode::HalfUp), m_promotions(nullptr),
+    m_subtotal(0), m_itemCount(0), m_memoryPeakSum(0),
+    m_updateDepth(0), m_totalsDirty(false) {}
+
+void Receipt::setObserver(ReceiptObserver* observer) {
+    m_observer = observer;
+}
+
+void Receipt::setJournal(ReceiptJournal* journal) {
+    m_journal = journal;
+}
+
+void Receipt::setPromotions(PromotionEngine* promotions) {
+    m_promotions = promotions;
+    if (!m_promotions) return;
+
+    feedPromotions();
+    notifyTotalsChanged();
+}
+
+void Receipt::setDuplicatePolicy(DuplicatePolicy policy) {
+    m_duplicatePolicy = policy;
+}
+
+Receipt::DuplicatePolicy Receipt::duplicatePolicy() const {
+    return m_duplicatePolicy;
+}
+
+void Receipt::setWeightRounding(RoundingMode mode) {
+    if (mode == m_weightRounding) return;
+    if (m_weighedLines == 0) {
+        m_weightRounding = mode;
+        return;
+    }
+
+    auto accountWeighed = [this](int sign) {
+        m_lines.forEachRun([this, sign](const ReceiptLines::Run& run) {
+            for (int i = 0; i < run.count; ++i) {
+                if (run.units[i] != QuantityUnit::Piece) accountLine(run.line(i), sign);
+            }
+        });
+    };
+    accountWeighed(-1);
+    m_weightRounding = mode;
+    accountWeighed(1);
+    if (m_observer) m_observer->linesChanged(0, lineCount() - 1);
+    notifyTotalsChanged();
+}
+
+RoundingMode Receipt::weightRounding() const {
+    return m_weightRounding;
+}
+
+void Receipt::setItems(const std::vector<ReceiptItem>& items) {
+    if (m_journal) m_journal->logReset();
+
+    if (m_observer) m_observer->aboutToReset();
+    clearLines();
+    m_lineIndex.reserve(static_cast<int>(items.size()));
+    for (const auto& item : items) {
+        if (!canAdd(item)) continue;
+        if (m_journal) m_journal->logAppendItem(item);
+        appendLine(item);
+        const int row = lineCount() - 1;
+        m_lineIndex.insert(lineKey(m_lines.line(row)), row);
+    }
+    if (m_observer) m_observer->resetDone();
+    verifyTotals();
+    notifyTotalsChanged();
+}
+
+bool Receipt::addItem(const ReceiptItem& item) {
+    if (!canAdd(item)) return false;
+    if (m_journal) m_journal->logAddItem(item);
+    insertOrMerge(item);
+    verifyTotals();
+    notifyTotalsChanged();
+    return true;
+}
+
+void Receipt::addItems(const std::vector<ReceiptItem>& items) {
+    if (items.empty()) return;
+
+    UpdateScope scope(*this);
+    for (const auto& item : items) {
+        if (!canAdd(item)) continue;
+        if (m_journal) m_journal->logAddItem(item);
+        insertOrMerge(item);
+    }
+    verifyTotals();
+    notifyTotalsChanged();
+}
+
+bool Receipt::appendItem(const ReceiptItem& item) {
+    const ReceiptLine line{ 0, item.price().amount(), item.quantity(), item.barcode(), item.unit() };
+    if (!fitsSubtotal(line, Money(0))) return false;
+    if (m_journal) m_journal->logAppendItem(item);
+    appendIndexedLine(item);
+    verifyTotals();
+    notifyTotalsChanged();
+    return true;
+}
+
+bool Receipt::addByBarcode(const ProductCatalog& catalog, uint64_t barcode, int quantity) {
+    CatalogEntry entry;
+    if (!catalog.find(barcode, entry)) return false;
+
+    return addItem(ReceiptItem(entry.name.toString(), entry.price, quantity, entry.barcode, entry.unit));
+}
+
+void Receipt::removeItem(int row) {
+    if (!isValidRow(row)) return;
+    if (m_journal) m_journal->logRemoveItem(row);
+
+    if (m_observer) m_observer->linesAboutToBeRemoved(row, row);
+    eraseLines(row, 1);
+    renumberRows({ row });
+    if (m_observer) m_observer->linesRemoved(row, row);
+    verifyTotals();
+    notifyTotalsChanged();
+}
+
+void Receipt::removeItems(std::vector<int> rows) {
+    rows.erase(std::remove_if(rows.begin(), rows.end(), [this](int row) { return !isValidRow(row); }), rows.end());
+    if (rows.empty()) return;
+
+    std::sort(rows.begin(), rows.end(), std::greater<int>());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    if (m_journal) m_journal->logRemoveItems(rows);
+
+    UpdateScope scope(*this);
+
+    // Walk from the bottom so earlier row numbers stay valid, removing each
+    // contiguous run with a single notification.
+    size_t i = 0;
+    while (i < rows.size()) {
+        const int last = rows[i];
+        int first = last;
+        while (++i < rows.size() && rows[i] == first - 1) {
+            first = rows[i];
+        }
+        if (m_observer) m_observer->linesAboutToBeRemoved(first, last);
+        eraseLines(first, last - first + 1);
+        if (m_observer) m_observer->linesRemoved(first, last);
+    }
+    renumberRows(std::vector<int>(rows.rbegin(), rows.rend()));
+    verifyTotals();
+    notifyTotalsChanged();
+}
+
+void Receipt::moveItem(int from, int to) {
+    if (!isValidRow(from) || !isValidRow(to) || from == to) return;
+    if (m_journal) m_journal->logMoveItem(from, to);
+
+    if (m_observer) m_observer->lineAboutToBeMoved(from, to);
+    m_lines.move(from, to);
+    if (m_lineIndexValid) reindexRows(std::min(from, to), std::max(from, to));
+    if (m_observer) m_observer->lineMoved(from, to);
+}
+
+int Receipt::findLine(const ReceiptItem& item) const {
+    LineKey key{};
+    if (!itemKey(item, key)) return -1;
+    ensureLineIndex();
+    return m_lineIndex.find(key);
+}
+
+ReceiptSnapshot Receipt::snapshot() const {
+    ReceiptSnapshot snapshot;
+    snapshot.m_arena = m_arena;
+    snapshot.m_lines = m_lines;
+    snapshot.m_names = m_names;
+    snapshot.m_subtotal = m_subtotal;
+    snapshot.m_itemCount = m_itemCount;
+    snapshot.m_weighedLines = m_weighedLines;
+    snapshot.m_weightRounding = m_weightRounding;
+    return snapshot;
+}
+
+void Receipt::restore(const ReceiptSnapshot& snapshot) {
+    if (m_journal) journalRestore(snapshot);
+
+    if (m_observer) m_observer->aboutToReset();
+    const bool sameRounding = snapshot.m_weightRounding == m_weightRounding || snapshot.m_weighedLines == 0;
+    if (m_promotions && sameRounding) {
+        // Withdraw what only the current lines hold, then add what only the
+        // snapshot holds; totals themselves are taken from the snapshot.
+        ReceiptLines::diff(m_lines, snapshot.m_lines,
+            [this](const ReceiptLines::Run& run) { accountRun(run, -1); },
+            [this](const ReceiptLines::Run& run) { accountRun(run, 1); });
+    }
+
+    // The receipt moves to the snapshot's arena; an empty default snapshot
+    // has none and keeps the current one.
+    std::shared_ptr<ReceiptArena> arena = snapshot.m_arena ? snapshot.m_arena : m_arena;
+    m_lineIndex.setArena(arena.get());
+    m_lines = snapshot.m_arena ? snapshot.m_lines : ReceiptLines(arena.get());
+    m_arena = std::move(arena);
+    m_names = snapshot.m_names ? snapshot.m_names : std::make_shared<NamePool>();
+    m_weighedLines = snapshot.m_weighedLines;
+    m_lineIndexValid = false;
+    m_itemCount = snapshot.m_itemCount;
+    if (sameRounding) {
+        m_subtotal = snapshot.m_subtotal;
+    } else {
+        // Weighed lines were rounded differently when the snapshot was taken.
+        m_subtotal = SaturatingMoney(recomputeSubtotal());
+        if (m_promotions) feedPromotions();
+    }
+
+    if (m_observer) m_observer->resetDone();
+    verifyTotals();
+    notifyTotalsChanged();
+}
+
+// Journals the lines that differ between the receipt and snapshot, as edits
+// that turn one into the other on replay: quantity changes where only
+// quantities differ, otherwise the differing lines removed and the snapshot's
+// appended and moved into place. Undo and redo usually differ in one line, so
+// they cost a record or two however long the receipt is. A snapshot with
+// another name pool cannot be compared and is journaled whole.
+void Receipt::journalRestore(const ReceiptSnapshot& snapshot) {
+    int prefix = 0;
+    int suffix = 0;
+    if (snapshot.m_names == m_names) ReceiptLines::commonEnds(m_lines, snapshot.m_lines, prefix, suffix);
+    if (prefix == 0 && suffix == 0) {
+        m_journal->logReset();
+        snapshot.m_lines.forEachRun([this, &snapshot](const ReceiptLines::Run& run) {
+            for (int i = 0; i < run.count; ++i) {
+                m_journal->logAppendItem(ReceiptItem(snapshot.m_names->name(run.nameIds[i]), Money(run.prices[i]),
+                                                  run.quantities[i], run.barcodes[i], run.units[i]));
+            }
+        });
+        return;
+    }
+
+    const int removed = lineCount() - prefix - suffix;
+    const int added = snapshot.lineCount() - prefix - suffix;
+    bool quantitiesOnly = removed == added;
+    for (int i = 0; quantitiesOnly && i < added; ++i) {
+        const ReceiptLine line = m_lines.line(prefix + i);
+        const ReceiptLine other = snapshot.m_lines.line(prefix + i);
+        quantitiesOnly = line.nameId == other.nameId && line.price == other.price && line.barcode == other.barcode
+            && line.unit == other.unit;
+    }
+    if (quantitiesOnly) {
+        for (int row = prefix; row < prefix + added; ++row) {
+            m_journal->logUpdateQuantity(row, snapshot.m_lines.quantity(row));
+        }
+        return;
+    }
+
+    if (removed > 0) {
+        std::vector<int> rows(static_cast<size_t>(removed));
+        for (int i = 0; i < removed; ++i) rows[static_cast<size_t>(i)] = prefix + i;
+        m_journal->logRemoveItems(rows);
+    }
+    for (int i = 0; i < added; ++i) {
+        m_journal->logAppendItem(snapshot.getItem(prefix + i));
+        if (suffix > 0) m_journal->logMoveItem(prefix + suffix + i, prefix + i);
+    }
+}
+
+bool Receipt::updateQuantity(int row, int newQuantity) {
+    if (!isValidRow(row) || newQuantity <= 0) return false;
+    const ReceiptLine old = m_lines.line(row);
+    ReceiptLine line = old;
+    line.quantity = newQuantity;
+    if (!fitsSubtotal(line, lineTotal(old))) return false;
+    if (m_journal) m_journal->logUpdateQuantity(row, newQuantity);
+
+    accountLine(old, -1);
+    m_lines.setQuantity(row, newQuantity);
+    accountLine(line, 1);
+    verifyTotals();
+
+    if (m_observer) m_observer->linesChanged(row, row);
+    notifyTotalsChanged();
+    return true;
+}
+
+void Receipt::beginUpdate() {
+    ++m_updateDepth;
+}
+
+void Receipt::endUpdate() {
+    Q_ASSERT(m_updateDepth > 0);
+    if (--m_updateDepth > 0) return;
+
+    if (m_observer) m_observer->updateFinished();
+    if (m_totalsDirty) {
+        m_totalsDirty = false;
+        if (m_observer) m_observer->totalsUpdated();
+    }
+}
+
+bool Receipt::isUpdating() const {
+    return m_updateDepth > 0;
+}
+
+void Receipt::notifyTotalsChanged() {
+    if (m_updateDepth > 0) {
+        m_totalsDirty = true;
+        return;
+    }
+    if (m_observer) m_observer->totalsUpdated();
+}
+
+ReceiptItem Receipt::getItem(int row) const {
+    if (!isValidRow(row)) return {};
+    const ReceiptLine line = m_lines.line(row);
+    return ReceiptItem(m_names->name(line.nameId), Money(line.price), line.quantity, line.barcode, line.unit);
+}
+
+std::vector<ReceiptItem> Receipt::items() const {
+    return snapshot().items();
+}
+
+const QString& Receipt::name(int row) const {
+    return m_names->name(m_lines.nameId(row));
+}
+
+Money Receipt::price(int row) const {
+    return Money(m_lines.price(row));
+}
+
+int Receipt::quantity(int row) const {
+    return m_lines.quantity(row);
+}
+
+QuantityUnit Receipt::unit(int row) const {
+    return m_lines.unit(row);
+}
+
+Money Receipt::lineTotal(int row) const {
+    return lineTotal(m_lines.line(row));
+}
+
+Money Receipt::lineTotal(const ReceiptLine& line) const {
+    if (line.unit == QuantityUnit::Piece) return Money(line.price) * line.quantity;
+    return Money(line.price).mulDiv(line.quantity, quantityScale(line.unit), m_weightRounding);
+}
+
+Money Receipt::subtotal() const {
+    return Money(m_subtotal);
+}
+
+Money Receipt::discount() const {
+    return m_promotions ? m_promotions->discount() : Money(0);
+}
+
+Money Receipt::amountDue() const {
+    return Money(m_subtotal) - discount();
+}
+
+std::vector<AppliedDiscount> Receipt::appliedDiscounts() const {
+    return m_promotions ? m_promotions->appliedDiscounts() : std::vector<AppliedDiscount>();
+}
+
+// Chunks are contiguous per column, so a chunk of pieces goes through the
+// vector kernel in one call; weighed lines round individually and are added
+// one by one. Chunks add up saturating, like the running subtotal.
+Money Receipt::recomputeSubtotal() const {
+    SaturatingMoney subtotal(0);
+    m_lines.forEachRun([this, &subtotal](const ReceiptLines::Run& run) {
+        const bool pieces = m_weighedLines == 0
+            || std::all_of(run.units, run.units + run.count, [](QuantityUnit unit) { return unit == QuantityUnit::Piece; });
+        if (pieces) {
+            int64_t chunk = 0;
+            MoneyKernels::dot(run.prices, run.quantities, static_cast<size_t>(run.count), chunk);
+            subtotal += SaturatingMoney(chunk);
+            return;
+        }
+        for (int i = 0; i < run.count; ++i) {
+            subtotal += SaturatingMoney(lineTotal(run.line(i)));
+        }
+    });
+    return Money(subtotal);
+}
+
+int Receipt::lineCount() const {
+    return m_lines.size();
+}
+
+int64_t Receipt::itemCount() const {
+    return m_itemCount;
+}
+
+bool Receipt::isEmpty() const {
+    return m_lines.isEmpty();
+}
+
+bool Receipt::isValidRow(int row) const {
+    return row >= 0 && row < lineCount();
+}
+
+ReceiptMemoryUsage Receipt::memoryUsage() const {
+    ReceiptMemoryUsage usage = m_memoryUsage;
+    if (usage.receipts > 0) usage.averagePeakBytes = m_memoryPeakSum / usage.receipts;
+    usage.reservedBytes = static_cast<int64_t>(m_arena->reservedBytes());
+    return usage;
+}
+
+bool Receipt::LineKey::operator==(const LineKey& other) const {
+    return barcode == other.barcode && nameId == other.nameId && price == other.price;
+}
+
+size_t Receipt::LineKeyHash::operator()(const LineKey& key) const {
+    uint64_t h = key.barcode ^ (static_cast<uint64_t>(key.nameId) << 32) ^ static_cast<uint64_t>(key.price);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return static_cast<size_t>(h);
+}
+
+Receipt::LineIndex::LineIndex(ReceiptArena* arena)
+    : m_arena(arena), m_slots(nullptr), m_capacity(0), m_count(0) {}
+
+Receipt::LineIndex::~LineIndex() {
+    release();
+}
+
+void Receipt::LineIndex::setArena(ReceiptArena* arena) {
+    release();
+    m_arena = arena;
+}
+
+void Receipt::LineIndex::forget() {
+    m_slots = nullptr;
+    m_capacity = 0;
+    m_count = 0;
+}
+
+void Receipt::LineIndex::release() {
+    if (m_slots) m_arena->deallocateArray(m_slots, static_cast<size_t>(m_capacity));
+    forget();
+}
+
+void Receipt::LineIndex::clear() {
+    for (int i = 0; i < m_capacity; ++i) m_slots[i].row = -1;
+    m_count = 0;
+}
+
+// Capacity is a power of two kept at least twice the count.
+void Receipt::LineIndex::reserve(int count) {
+    int capacity = 16;
+    while (capacity < count * 2) capacity *= 2;
+    if (capacity > m_capacity) rehash(capacity);
+}
+
+Receipt::LineIndex::Slot* Receipt::LineIndex::probe(const LineKey& key) const {
+    const size_t mask = static_cast<size_t>(m_capacity) - 1;
+    for (size_t i = LineKeyHash()(key) & mask;; i = (i + 1) & mask) {
+        Slot& slot = m_slots[i];
+        if (slot.row < 0 || slot.key == key) return &slot;
+    }
+}
+
+int Receipt::LineIndex::find(const LineKey& key) const {
+    if (m_count == 0) return -1;
+    return probe(key)->row;
+}
+
+void Receipt::LineIndex::insert(const LineKey& key, int row) {
+    grow();
+    Slot* slot = probe(key);
+    if (slot->row >= 0) return;
+    *slot = Slot{ key, row };
+    ++m_count;
+}
+
+void Receipt::LineIndex::assign(const LineKey& key, int row) {
+    grow();
+    Slot* slot = probe(key);
+    if (slot->row < 0) ++m_count;
+    *slot = Slot{ key, row };
+}
+
+// Backward-shift deletion: later entries of the probe run move up into the
+// hole unless their home slot lies after it, so no tombstones are left.
+void Receipt::LineIndex::remove(const LineKey& key) {
+    if (m_count == 0) return;
+    Slot* slot = probe(key);
+    if (slot->row < 0) return;
+
+    const size_t mask = static_cast<size_t>(m_capacity) - 1;
+    size_t hole = static_cast<size_t>(slot - m_slots);
+    for (size_t i = (hole + 1) & mask; m_slots[i].row >= 0; i = (i + 1) & mask) {
+        const size_t home = LineKeyHash()(m_slots[i].key) & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            m_slots[hole] = m_slots[i];
+            hole = i;
+        }
+    }
+    m_slots[hole].row = -1;
+    --m_count;
+}
+
+void Receipt::LineIndex::grow() {
+    if ((m_count + 1) * 2 > m_capacity) reserve(m_count + 1);
+}
+
+void Receipt::LineIndex::rehash(int capacity) {
+    Slot* old = m_slots;
+    const int oldCapacity = m_capacity;
+    m_slots = m_arena->allocateArray<Slot>(static_cast<size_t>(capacity));
+    m_capacity = capacity;
+    m_count = 0;
+    for (int i = 0; i < capacity; ++i) m_slots[i].row = -1;
+    for (int i = 0; i < oldCapacity; ++i) {
+        if (old[i].row >= 0) assign(old[i].key, old[i].row);
+    }
+    if (old) m_arena->deallocateArray(old, static_cast<size_t>(oldCapacity));
+}
+
+Receipt::LineKey Receipt::lineKey(const ReceiptLine& line) {
+    if (line.barcode != 0) return LineKey{line.barcode, 0, 0};
+    return LineKey{0, line.nameId, line.price};
+}
+
+bool Receipt::itemKey(const ReceiptItem& item, LineKey& key) const {
+    if (item.barcode() != 0) {
+        key = LineKey{item.barcode(), 0, 0};
+        return true;
+    }
+
+    // A name that is not interned yet cannot be on any line.
+    NamePool::Id nameId;
+    if (!m_names->find(item.name(), nameId)) return false;
+    key = LineKey{0, nameId, item.price().amount()};
+    return true;
+}
+
+bool Receipt::canAdd(const ReceiptItem& item) const {
+    ReceiptLine line{ 0, item.price().amount(), item.quantity(), item.barcode(), item.unit() };
+    Money replaced(0);
+    if (m_duplicatePolicy == DuplicatePolicy::Merge) {
+        const int row = findLine(item);
+        if (row >= 0 && m_lines.unit(row) == item.unit()) {
+            const ReceiptLine existing = m_lines.line(row);
+            if (existing.quantity > std::numeric_limits<int>::max() - line.quantity) return false;
+            line.quantity += existing.quantity;
+            replaced = lineTotal(existing);
+        }
+    }
+    return fitsSubtotal(line, replaced);
+}
+
+// Whether line, in place of a line totalling replaced, keeps its own total and
+// the subtotal within the kopeck range.
+bool Receipt::fitsSubtotal(const ReceiptLine& line, Money replaced) const {
+    const SaturatingMoney price(line.price);
+    const SaturatingMoney total = line.unit == QuantityUnit::Piece
+        ? price * line.quantity
+        : price.mulDiv(line.quantity, quantityScale(line.unit), m_weightRounding);
+    return !saturated(total) && !saturated(m_subtotal - SaturatingMoney(replaced) + total);
+}
+
+void Receipt::insertOrMerge(const ReceiptItem& item) {
+    if (m_duplicatePolicy == DuplicatePolicy::Merge) {
+        const int row = findLine(item);
+        if (row >= 0 && m_lines.unit(row) == item.unit()) {
+            ReceiptLine line = m_lines.line(row);
+            accountLine(line, -1);
+            line.quantity += item.quantity();
+            m_lines.setQuantity(row, line.quantity);
+            accountLine(line, 1);
+            if (m_observer) m_observer->linesChanged(row, row);
+            return;
+        }
+    }
+
+    appendIndexedLine(item);
+}
+
+void Receipt::appendIndexedLine(const ReceiptItem& item) {
+    appendLine(item);
+    const int row = lineCount() - 1;
+    if (m_lineIndexValid) m_lineIndex.insert(lineKey(m_lines.line(row)), row);
+    if (m_observer) m_observer->linesAppended(row, row);
+}
+
+void Receipt::ensureLineIndex() const {
+    if (m_lineIndexValid) return;
+    m_lineIndex.clear();
+    m_lineIndex.reserve(lineCount());
+    reindexRows(0, lineCount() - 1);
+    m_lineIndexValid = true;
+}
+
+// The first row wins when lines share a key, as merging would have kept it.
+void Receipt::reindexRows(int first, int last) const {
+    for (int row = last; row >= first; --row) {
+        m_lineIndex.assign(lineKey(m_lines.line(row)), row);
+    }
+}
+
+int64_t Receipt::lineItemCount(const ReceiptLine& line) {
+    return line.unit == QuantityUnit::Piece ? line.quantity : 1;
+}
+
+void Receipt::appendLine(const ReceiptItem& item) {
+    const ReceiptLine line{ m_names->acquire(item.name()), item.price().amount(), item.quantity(), item.barcode(), item.unit() };
+    m_lines.append(line);
+    if (item.isWeighed()) ++m_weighedLines;
+    accountLine(line, 1);
+}
+
+// Names stay in the pool: snapshots may still refer to them by id. The rows
+// after the erased ones keep their old numbers in the index until
+// renumberRows().
+void Receipt::eraseLines(int first, int count) {
+    for (int row = first; row < first + count; ++row) {
+        const ReceiptLine line = m_lines.line(row);
+        accountLine(line, -1);
+        if (line.unit != QuantityUnit::Piece) --m_weighedLines;
+        if (m_lineIndexValid) {
+            const LineKey key = lineKey(line);
+            if (m_lineIndex.find(key) == row) m_lineIndex.remove(key);
+        }
+    }
+    m_lines.erase(first, count);
+}
+
+// Moves the index entries of the lines after the erased rows, given by their
+// old numbers in ascending order, to the lines' new rows. A key whose first
+// line was erased passes to its next remaining line. Rows before the first
+// erased one are not visited.
+void Receipt::renumberRows(const std::vector<int>& erased) {
+    if (!m_lineIndexValid || erased.empty()) return;
+    const int oldCount = lineCount() + static_cast<int>(erased.size());
+    size_t skipped = 0;
+    for (int old = erased.front(); old < oldCount; ++old) {
+        if (skipped < erased.size() && erased[skipped] == old) {
+            ++skipped;
+            continue;
+        }
+        const int row = old - static_cast<int>(skipped);
+        const LineKey key = lineKey(m_lines.line(row));
+        const int indexed = m_lineIndex.find(key);
+        if (indexed == old) {
+            m_lineIndex.assign(key, row);
+        } else if (indexed < 0) {
+            m_lineIndex.insert(key, row);
+        }
+    }
+}
+
+// An arena that no snapshot shares is reset in one step, without visiting the
+// lines and index in it; otherwise the snapshots keep it and the receipt moves
+// to a new one. A shared name pool is likewise left to them and replaced.
+void Receipt::clearLines() {
+    recordMemoryUsage();
+    if (m_arena.use_count() == 1) {
+        m_lines.forget();
+        m_lineIndex.forget();
+        m_arena->reset();
+    } else {
+        auto arena = std::make_shared<ReceiptArena>();
+        m_lineIndex.setArena(arena.get());
+        m_lines = ReceiptLines(arena.get());
+        m_arena = std::move(arena);
+    }
+    m_lineIndexValid = true;
+    if (m_names.use_count() > 1) {
+        m_names = std::make_shared<NamePool>();
+    } else {
+        m_names->clear();
+    }
+    m_subtotal = SaturatingMoney(0);
+    m_itemCount = 0;
+    m_weighedLines = 0;
+    if (m_promotions) m_promotions->reset();
+}
+
+void Receipt::recordMemoryUsage() {
+    const auto peak = static_cast<int64_t>(m_arena->peakBytes());
+    if (peak == 0) return;
+    ++m_memoryUsage.receipts;
+    m_memoryUsage.lastPeakBytes = peak;
+    m_memoryUsage.maxPeakBytes = std::max(m_memoryUsage.maxPeakBytes, peak);
+    m_memoryPeakSum += peak;
+}
+
+// Adds (sign 1) or withdraws (sign -1) one line's share of the cached totals
+// and of the promotion state; mutations bracket every change with the two.
+void Receipt::accountLine(const ReceiptLine& line, int sign) {
+    const Money total = lineTotal(line);
+    const int64_t items = lineItemCount(line);
+    if (sign > 0) {
+        m_subtotal += SaturatingMoney(total);
+        m_itemCount += items;
+    } else {
+        m_subtotal -= SaturatingMoney(total);
+        m_itemCount -= items;
+    }
+
+    if (m_promotions) {
+        const int64_t units = line.unit == QuantityUnit::Piece ? line.quantity : 0;
+        m_promotions->lineChanged(line.barcode, line.price, sign * units, sign > 0 ? total : Money(0) - total);
+    }
+}
+
+void Receipt::accountRun(const ReceiptLines::Run& run, int sign) {
+    for (int i = 0; i < run.count; ++i) {
+        accountLine(run.line(i), sign);
+    }
+}
+
+// Rebuilds the promotion state from every line, leaving the totals alone.
+void Receipt::feedPromotions() {
+    m_promotions->reset();
+    m_lines.forEachRun([this](const ReceiptLines::Run& run) {
+        for (int i = 0; i < run.count; ++i) {
+            const ReceiptLine line = run.line(i);
+            const int64_t units = line.unit == QuantityUnit::Piece ? line.quantity : 0;
+            m_promotions->lineChanged(line.barcode, line.price, units, lineTotal(line));
+        }
+    });
+}
+
+// Cached totals are kept in O(1) per mutation; builds with RECEIPT_VERIFY_TOTALS
+// cross-check them against a full rescan after every change.
+void Receipt::verifyTotals() const {
+#ifdef RECEIPT_VERIFY_TOTALS
+    int64_t itemCount = 0;
+    m_lines.forEachRun([&itemCount](const ReceiptLines::Run& run) {
+        for (int i = 0; i < run.count; ++i) {
+            itemCount += lineItemCount(run.line(i));
+        }
+    });
+    Q_ASSERT_X(recomputeSubtotal() == Money(m_subtotal), "Receipt", "cached subtotal diverged");
+    Q_ASSERT_X(itemCount == m_itemCount, "Receipt", "cached item count diverged");
+#endif
+}
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <QString>
+#include <memory>
+#include <vector>
+#include "money.h"
+#include "NamePool.h"
+#include "PromotionEngine.h"
+#include "ReceiptLines.h"
+
+class ProductCatalog;
+class ReceiptJournal;
+
+class ReceiptItem {
+public:
+    ReceiptItem();
+    ReceiptItem(QString name, Money price, int quantity, uint64_t barcode = 0,
+                QuantityUnit unit = QuantityUnit::Piece);
+
+    [[nodiscard]] QString name() const;
+    [[nodiscard]] Money price() const;
+    [[nodiscard]] int quantity() const;
+    [[nodiscard]] uint64_t barcode() const;
+    [[nodiscard]] QuantityUnit unit() const;
+    [[nodiscard]] bool isWeighed() const;
+
+    // Pieces count individually; a weighed line counts as one item.
+    [[nodiscard]] int64_t itemCount() const;
+
+    void setQuantity(int quantity);
+
+    [[nodiscard]] Money total(RoundingMode mode = RoundingMode::HalfUp) const;
+
+private:
+    QString m_name;
+    Money m_price;
+    int m_quantity;
+    uint64_t m_barcode;
+    QuantityUnit m_unit;
+};
+
+// Structural change notifications from a Receipt, following Qt's item model
+// protocol: removals, moves and resets are announced before they happen,
+// appends and value changes after. Calls come from the mutating thread.
+class ReceiptObserver {
+public:
+    virtual ~ReceiptObserver() = default;
+
+    virtual void linesAppended(int first, int last) { (void)first; (void)last; }
+    virtual void linesAboutToBeRemoved(int first, int last) { (void)first; (void)last; }
+    virtual void linesRemoved(int first, int last) { (void)first; (void)last; }
+    virtual void lineAboutToBeMoved(int from, int to) { (void)from; (void)to; }
+    virtual void lineMoved(int from, int to) { (void)from; (void)to; }
+    virtual void linesChanged(int first, int last) { (void)first; (void)last; }
+    virtual void aboutToReset() {}
+    virtual void resetDone() {}
+    virtual void updateFinished() {}
+    virtual void totalsUpdated() {}
+};
+
+// Arena memory of finished receipts, in bytes. Each receipt counts with the
+// most its arena held at once.
+struct ReceiptMemoryUsage {
+    int64_t receipts = 0;
+    int64_t lastPeakBytes = 0;
+    int64_t maxPeakBytes = 0;
+    int64_t averagePeakBytes = 0;
+    // Held by the current receipt's arena, used or not.
+    int64_t reservedBytes = 0;
+};
+
+// A receipt's lines and totals as they were at one moment. Taking one is O(1)
+// and copies share everything; a snapshot costs memory only for the chunks of
+// lines the receipt changes afterwards (see ReceiptLines). Names come from a
+// pool that the receipt only ever appends to while snapshots share it.
+class ReceiptSnapshot {
+public:
+    ReceiptSnapshot();
+
+    [[nodiscard]] int lineCount() const;
+    [[nodiscard]] bool isEmpty() const;
+    [[nodiscard]] ReceiptItem getItem(int row) const;
+    [[nodiscard]] std::vector<ReceiptItem> items() const;
+    [[nodiscard]] Money subtotal() const;
+    [[nodiscard]] int64_t itemCount() const;
+
+private:
+    friend class Receipt;
+
+    // Keeps the lines' memory alive, so it is declared before them.
+    std::shared_ptr<ReceiptArena> m_arena;
+    ReceiptLines m_lines;
+    std::shared_ptr<NamePool> m_names;
+    SaturatingMoney m_subtotal;
+    int64_t m_itemCount;
+    int m_weighedLines;
+    RoundingMode m_weightRounding;
+};
+
+// The lines of one open receipt: persistent columnar storage, O(1) running
+// totals and snapshots, duplicate merging, promotions and journaling. Headless and widget-free, so
+// registers can run without a GUI and many can run side by side on worker
+// threads; ReceiptTableModel adapts one to a view through ReceiptObserver.
+class Receipt {
+public:
+    // Groups mutations into one transaction: the observer gets updateFinished()
+    // and a single totalsUpdated() when the outermost scope ends.
+    class UpdateScope {
+    public:
+        explicit UpdateScope(Receipt& receipt);
+        ~UpdateScope();
+
+        UpdateScope(const UpdateScope&) = delete;
+        UpdateScope& operator=(const UpdateScope&) = delete;
+
+    private:
+        Receipt& m_receipt;
+    };
+
+    enum class DuplicatePolicy {
+        Merge,
+        AppendLine
+    };
+
+    Receipt();
+
+    Receipt(const Receipt&) = delete;
+    Receipt& operator=(const Receipt&) = delete;
+
+    void setObserver(ReceiptObserver* observer);
+
+    // Every subsequent mutation is also recorded into journal (may be null).
+    void setJournal(ReceiptJournal* journal);
+
+    // Every line change is fed to promotions (may be null), whose discount is
+    // taken off the subtotal in amountDue(). The current lines are replayed.
+    void setPromotions(PromotionEngine* promotions);
+
+    void setDuplicatePolicy(DuplicatePolicy policy);
+    [[nodiscard]] DuplicatePolicy duplicatePolicy() const;
+
+    // Rounding applied when a weighed line's total falls between kopecks.
+    void setWeightRounding(RoundingMode mode);
+    [[nodiscard]] RoundingMode weightRounding() const;
+
+    // Lines whose totals would take the subtotal beyond the kopeck range are
+    // refused: setItems() and addItems() leave them out, the single-line
+    // mutations return false and change nothing, not even the journal.
+    void setItems(const std::vector<ReceiptItem>& items);
+    bool addItem(const ReceiptItem& item);
+    void addItems(const std::vector<ReceiptItem>& items);
+    // Adds item as a new line even where addItem() would merge it.
+    bool appendItem(const ReceiptItem& item);
+    bool addByBarcode(const ProductCatalog& catalog, uint64_t barcode, int quantity = 1);
+    void removeItem(int row);
+    void removeItems(std::vector<int> rows);
+    bool updateQuantity(int row, int newQuantity);
+    void moveItem(int from, int to);
+    [[nodiscard]] int findLine(const ReceiptItem& item) const;
+
+    [[nodiscard]] ReceiptSnapshot snapshot() const;
+
+    // Makes snapshot the current receipt, as one reset. Totals come from the
+    // snapshot; promotions are fed only the chunks that differ between the two.
+    // The journal gets only the lines that differ, as edits that replay to the
+    // snapshot's lines.
+    void restore(const ReceiptSnapshot& snapshot);
+
+    void beginUpdate();
+    void endUpdate();
+    [[nodiscard]] bool isUpdating() const;
+
+    [[nodiscard]] ReceiptItem getItem(int row) const;
+    [[nodiscard]] std::vector<ReceiptItem> items() const;
+    [[nodiscard]] const QString& name(int row) const;
+    [[nodiscard]] Money price(int row) const;
+    [[nodiscard]] int quantity(int row) const;
+    [[nodiscard]] QuantityUnit unit(int row) const;
+    [[nodiscard]] Money lineTotal(int row) const;
+
+    [[nodiscard]] Money subtotal() const;
+    [[nodiscard]] Money recomputeSubtotal() const;
+    [[nodiscard]] Money discount() const;
+    [[nodiscard]] Money amountDue() const;
+    [[nodiscard]] std::vector<AppliedDiscount> appliedDiscounts() const;
+    [[nodiscard]] int lineCount() const;
+    [[nodiscard]] int64_t itemCount() const;
+    [[nodiscard]] bool isEmpty() const;
+    [[nodiscard]] bool isValidRow(int row) const;
+
+    [[nodiscard]] ReceiptMemoryUsage memoryUsage() const;
+
+private:
+    // Barcoded products are keyed by barcode alone; free-form lines by their
+    // interned name and price.
+    struct LineKey {
+        uint64_t barcode;
+        NamePool::Id nameId;
+        int64_t price;
+
+        bool operator==(const LineKey& other) const;
+    };
+
+    struct LineKeyHash {
+        size_t operator()(const LineKey& key) const;
+    };
+
+    // Open-addressing map from line key to row, kept in the receipt's arena.
+    // Erasing lines removes their keys and renumbers the rows after them;
+    // only restore() leaves it to be rebuilt on the next lookup.
+    class LineIndex {
+    public:
+        explicit LineIndex(ReceiptArena* arena);
+        ~LineIndex();
+
+        LineIndex(const LineIndex&) = delete;
+        LineIndex& operator=(const LineIndex&) = delete;
+
+        // Releases the slots into the old arena before moving to arena.
+        void setArena(ReceiptArena* arena);
+        // Drops the slots without releasing them, ahead of an arena reset.
+        void forget();
+
+        void clear();
+        void reserve(int count);
+        [[nodiscard]] int find(const LineKey& key) const;
+        // insert() keeps a row already stored under key; assign() replaces it.
+        void insert(const LineKey& key, int row);
+        void assign(const LineKey& key, int row);
+        void remove(const LineKey& key);
+
+    private:
+        struct Slot {
+            LineKey key;
+            int row;
+        };
+
+        [[nodiscard]] Slot* probe(const LineKey& key) const;
+        void grow();
+        void rehash(int capacity);
+        void release();
+
+        ReceiptArena* m_arena;
+        Slot* m_slots;
+        int m_capacity;
+        int m_count;
+    };
+
+    [[nodiscard]] static LineKey lineKey(const ReceiptLine& line);
+    bool itemKey(const ReceiptItem& item, LineKey& key) const;
+    [[nodiscard]] bool canAdd(const ReceiptItem& item) const;
+    [[nodiscard]] bool fitsSubtotal(const ReceiptLine& line, Money replaced) const;
+    void insertOrMerge(const ReceiptItem& item);
+    void journalRestore(const ReceiptSnapshot& snapshot);
+    void ensureLineIndex() const;
+    void reindexRows(int first, int last) const;
+
+    [[nodiscard]] Money lineTotal(const ReceiptLine& line) const;
+    [[nodiscard]] static int64_t lineItemCount(const ReceiptLine& line);
+    void accountLine(const ReceiptLine& line, int sign);
+    void accountRun(const ReceiptLines::Run& run, int sign);
+    void feedPromotions();
+    void appendLine(const ReceiptItem& item);
+    void appendIndexedLine(const ReceiptItem& item);
+    void eraseLines(int first, int count);
+    void renumberRows(const std::vector<int>& erased);
+    void clearLines();
+    void recordMemoryUsage();
+    void notifyTotalsChanged();
+    void verifyTotals() const;
+
+    // Lines and the line index live in the arena, which snapshots share and
+    // which is reset in one step when a receipt is finished and nothing else
+    // holds it. Names are ids in a pool that is shared with snapshots and
+    // therefore never shrinks while the receipt is open.
+    std::shared_ptr<ReceiptArena> m_arena;
+    ReceiptLines m_lines;
+    std::shared_ptr<NamePool> m_names;
+
+    // Rebuilt on the next lookup after removals and restores renumber rows.
+    mutable LineIndex m_lineIndex;
+    mutable bool m_lineIndexValid;
+    DuplicatePolicy m_duplicatePolicy;
+    ReceiptJournal* m_journal;
+    ReceiptObserver* m_observer;
+    int m_weighedLines;
+    RoundingMode m_weightRounding;
+    PromotionEngine* m_promotions;
+
+    // Mutations that would take it beyond the kopeck range are refused, so it
+    // only pins at a limit where a rounding change pushes it there.
+    SaturatingMoney m_subtotal;
+    int64_t m_itemCount;
+
+    ReceiptMemoryUsage m_memoryUsage;
+    int64_t m_memoryPeakSum;
+
+    int m_updateDepth;
+    bool m_totalsDirty;
+};
@@ -0,0 +1,132 @@
+#include "ReceiptArena.h"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+struct ReceiptArena::Block {
+    Block* next;
+    size_t size;
+
+    static constexpr size_t HeaderSize =
+        (sizeof(Block*) + sizeof(size_t) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+    static Block* create(size_t size) {
+        void* memory = std::malloc(HeaderSize + size);
+        if (!memory) throw std::bad_alloc();
+        return new (memory) Block{ nullptr, size };
+    }
+
+    char* data() {
+        return reinterpret_cast<char*>(this) + HeaderSize;
+    }
+};
+
+ReceiptArena::ReceiptArena()
+    : m_first(nullptr), m_current(nullptr), m_cursor(nullptr), m_end(nullptr),
+    m_inUse(0), m_peak(0), m_reserved(0) {
+    m_free.fill(nullptr);
+}
+
+ReceiptArena::~ReceiptArena() {
+    while (m_first) {
+        Block* next = m_first->next;
+        std::free(m_first);
+        m_first = next;
+    }
+}
+
+// Multiples of 64 bytes up to 4 KiB, where receipt chunks and small tables
+// fall, then powers of two.
+int ReceiptArena::sizeClass(size_t size) {
+    if (size <= 4096) return static_cast<int>((std::max<size_t>(size, 1) + 63) / 64) - 1;
+    int sizeClass = 64;
+    for (size_t classBytes = 8192; classBytes < size; classBytes <<= 1) ++sizeClass;
+    return sizeClass;
+}
+
+size_t ReceiptArena::classSize(int sizeClass) {
+    if (sizeClass < 64) return static_cast<size_t>(sizeClass + 1) * 64;
+    return size_t(8192) << (sizeClass - 64);
+}
+
+void* ReceiptArena::allocate(size_t size) {
+    const int sizeClass = ReceiptArena::sizeClass(size);
+    const size_t bytes = classSize(sizeClass);
+    void* p;
+    if (FreeSlot* slot = m_free[sizeClass]) {
+        m_free[sizeClass] = slot->next;
+        p = slot;
+    } else {
+        p = bump(bytes);
+    }
+    m_inUse += bytes;
+    m_peak = std::max(m_peak, m_inUse);
+    return p;
+}
+
+void ReceiptArena::deallocate(void* p, size_t size) {
+    if (!p) return;
+    const int sizeClass = ReceiptArena::sizeClass(size);
+    m_free[sizeClass] = new (p) FreeSlot{ m_free[sizeClass] };
+    m_inUse -= classSize(sizeClass);
+}
+
+// Moves on through the kept blocks before asking the heap for a new one, which
+// grows geometrically or is sized to fit an oversized request.
+void* ReceiptArena::bump(size_t size) {
+    while (static_cast<size_t>(m_end - m_cursor) < size) {
+        Block* next = m_current ? m_current->next : m_first;
+        if (!next || next->size < size) {
+            const size_t grown = m_current ? std::min(m_current->size * 2, MaxBlockSize) : FirstBlockSize;
+            Block* block = Block::create(std::max(grown, size));
+            block->next = next;
+            if (m_current) m_current->next = block;
+            else m_first = block;
+            m_reserved += block->size;
+            next = block;
+        }
+        m_current = next;
+        m_cursor = next->data();
+        m_end = m_cursor + next->size;
+    }
+    void* p = m_cursor;
+    m_cursor += size;
+    return p;
+}
+
+void ReceiptArena::reset() {
+    m_free.fill(nullptr);
+    m_current = nullptr;
+    m_cursor = nullptr;
+    m_end = nullptr;
+    m_inUse = 0;
+    m_peak = 0;
+
+    // Only an unusually large receipt leaves more than this behind.
+    if (m_reserved <= RetainedBytes) return;
+    size_t kept = 0;
+    Block** link = &m_first;
+    while (*link && kept + (*link)->size <= RetainedBytes) {
+        kept += (*link)->size;
+        link = &(*link)->next;
+    }
+    for (Block* block = *link; block;) {
+        Block* next = block->next;
+        std::free(block);
+        block = next;
+    }
+    *link = nullptr;
+    m_reserved = kept;
+}
+
+size_t ReceiptArena::bytesInUse() const {
+    return m_inUse;
+}
+
+size_t ReceiptArena::peakBytes() const {
+    return m_peak;
+}
+
+size_t ReceiptArena::reservedBytes() const {
+    return m_reserved;
+}
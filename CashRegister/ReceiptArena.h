@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Memory for one receipt's lines and indexes. Allocations are carved from a
+// chain of blocks with a bump pointer, and freed memory goes onto a free list
+// per size class to be handed out again within the same receipt. reset()
+// frees everything at once in O(1) without visiting what was allocated; the
+// blocks stay for the next receipt, so a long shift keeps reusing the same
+// few blocks instead of fragmenting the heap line by line.
+//
+// Nothing allocated here has its destructor run by reset(): only trivially
+// destructible data, or owners that forget their pointers first, may live in
+// an arena. An arena is used from one thread at a time.
+class ReceiptArena {
+public:
+    ReceiptArena();
+    ~ReceiptArena();
+
+    ReceiptArena(const ReceiptArena&) = delete;
+    ReceiptArena& operator=(const ReceiptArena&) = delete;
+
+    // Aligned for any scalar type. Sizes are rounded up to their size class.
+    [[nodiscard]] void* allocate(size_t size);
+    void deallocate(void* p, size_t size);
+
+    template <typename T>
+    [[nodiscard]] T* allocateArray(size_t count) {
+        return static_cast<T*>(allocate(count * sizeof(T)));
+    }
+
+    template <typename T>
+    void deallocateArray(T* p, size_t count) {
+        deallocate(p, count * sizeof(T));
+    }
+
+    void reset();
+
+    // Bytes handed out and not yet freed, the most there were at once since
+    // the last reset(), and the bytes held in blocks.
+    [[nodiscard]] size_t bytesInUse() const;
+    [[nodiscard]] size_t peakBytes() const;
+    [[nodiscard]] size_t reservedBytes() const;
+
+private:
+    struct Block;
+
+    static constexpr size_t FirstBlockSize = 16 * 1024;
+    static constexpr size_t MaxBlockSize = 256 * 1024;
+    // Blocks beyond this are returned to the heap on reset().
+    static constexpr size_t RetainedBytes = 1024 * 1024;
+    static constexpr int SizeClassCount = 64 + 40;
+
+    static int sizeClass(size_t size);
+    static size_t classSize(int sizeClass);
+
+    void* bump(size_t size);
+
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+
+    Block* m_first;
+    Block* m_current;
+    char* m_cursor;
+    char* m_end;
+    std::array<FreeSlot*, SizeClassCount> m_free;
+    size_t m_inUse;
+    size_t m_peak;
+    size_t m_reserved;
+};
@@ -0,0 +1,62 @@
+#include "ReceiptItemDelegate.h"
+#include "ReceiptTableModel.h"
+#include <QFontMetrics>
+#include <QHeaderView>
+#include <QPainter>
+#include <QStyle>
+#include <QTableView>
+#include <QtMath>
+
+ReceiptItemDelegate::ReceiptItemDelegate(const ReceiptTableModel& model, QObject* parent)
+    : QStyledItemDelegate(parent), m_model(model) {}
+
+void ReceiptItemDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const {
+    const int row = index.row();
+    const int column = index.column();
+    if (row >= m_model.rowCount() || column >= ReceiptTableModel::ColumnCount) return;
+
+    const bool selected = option.state.testFlag(QStyle::State_Selected);
+    if (selected) {
+        painter->fillRect(option.rect, option.palette.brush(QPalette::Highlight));
+    } else if (row & 1) {
+        painter->fillRect(option.rect, option.palette.brush(QPalette::AlternateBase));
+    }
+
+    const QStaticText& text = m_model.cell(row, column);
+    const QSizeF size = text.size();
+    const QRect area = option.rect.adjusted(HorizontalMargin, 0, -HorizontalMargin, 0);
+    const qreal x = column == ReceiptTableModel::NameColumn ? area.left() : area.right() + 1 - size.width();
+    const qreal y = area.top() + (area.height() - size.height()) / 2;
+
+    painter->setPen(option.palette.color(selected ? QPalette::HighlightedText : QPalette::Text));
+    if (size.width() <= area.width()) {
+        painter->drawStaticText(QPointF(x, y), text);
+        return;
+    }
+
+    // Only overlong names need clipping to their column.
+    painter->save();
+    painter->setClipRect(area, Qt::IntersectClip);
+    painter->drawStaticText(QPointF(area.left(), y), text);
+    painter->restore();
+}
+
+QSize ReceiptItemDelegate::sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const {
+    if (index.row() >= m_model.rowCount()) return QSize(0, rowHeight(option.font));
+    const QSizeF size = m_model.cell(index.row(), index.column()).size();
+    return QSize(qCeil(size.width()) + 2 * HorizontalMargin, rowHeight(option.font));
+}
+
+int ReceiptItemDelegate::rowHeight(const QFont& font) {
+    return QFontMetrics(font).height() + 2 * VerticalPadding;
+}
+
+void ReceiptItemDelegate::install(QTableView* view, ReceiptTableModel* model) {
+    model->setCellFont(view->font());
+    view->setModel(model);
+    view->setItemDelegate(new ReceiptItemDelegate(*model, view));
+    view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    view->verticalHeader()->setDefaultSectionSize(rowHeight(view->font()));
+    view->setAlternatingRowColors(false);
+    view->setWordWrap(false);
+}
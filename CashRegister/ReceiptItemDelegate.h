@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QStyledItemDelegate>
+
+class QTableView;
+class ReceiptTableModel;
+
+// Paints receipt cells straight from the model's cached QStaticText, skipping
+// the QVariant/QString round trip and style machinery of the default delegate.
+// Rows alternate and highlight from the view's palette.
+class ReceiptItemDelegate : public QStyledItemDelegate {
+    Q_OBJECT
+
+public:
+    explicit ReceiptItemDelegate(const ReceiptTableModel& model, QObject* parent = nullptr);
+
+    void paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+    [[nodiscard]] QSize sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+
+    [[nodiscard]] static int rowHeight(const QFont& font);
+
+    // Shows model in view in the fast mode: fixed row heights, no word wrap,
+    // no style-drawn alternate rows, and this delegate for every cell.
+    static void install(QTableView* view, ReceiptTableModel* model);
+
+private:
+    static constexpr int HorizontalMargin = 6;
+    static constexpr int VerticalPadding = 4;
+
+    const ReceiptTableModel& m_model;
+};
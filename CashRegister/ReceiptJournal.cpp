@@ -0,0 +1,429 @@
+#include "ReceiptJournal.h"
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct RecordHeader {
+    uint32_t payloadSize;
+    uint16_t op;
+    uint16_t reserved;
+    uint32_t checksum;
+    uint32_t reserved2;
+    int64_t timestampNs;
+};
+
+// unit takes the high bytes of what used to be a 32-bit name length, so
+// records written before weighed goods read back as pieces.
+struct AddItemPayload {
+    int64_t price;
+    uint64_t barcode;
+    int32_t quantity;
+    uint16_t nameLength;
+    uint8_t unit;
+    uint8_t reserved;
+};
+
+constexpr size_t RingCapacity = size_t(1) << 20;
+constexpr size_t MaxBatchBytes = 256 * 1024;
+// Well inside the ring, so a record always fits once the writer catches up.
+// The largest add-item record, with a 65535-character name, is about half.
+constexpr size_t MaxRecordBytes = MaxBatchBytes;
+
+int64_t monotonicNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t checksum(const char* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ static_cast<uint8_t>(data[i])) * 16777619u;
+    }
+    return hash;
+}
+
+bool isClosingOp(uint16_t op) {
+    return op == static_cast<uint16_t>(JournalOp::Approve) || op == static_cast<uint16_t>(JournalOp::Decline);
+}
+
+// Length of the longest prefix made of complete records with valid checksums.
+size_t validPrefixLength(const QByteArray& data) {
+    size_t offset = 0;
+    const size_t size = static_cast<size_t>(data.size());
+    while (offset + sizeof(RecordHeader) <= size) {
+        RecordHeader header;
+        std::memcpy(&header, data.constData() + offset, sizeof(header));
+        if (header.payloadSize > size - offset - sizeof(header)) break;
+        if (checksum(data.constData() + offset + sizeof(header), header.payloadSize) != header.checksum) break;
+        offset += sizeof(header) + header.payloadSize;
+    }
+    return offset;
+}
+
+bool syncToDisk(QFile& file) {
+    if (!file.flush()) return false;
+#if defined(Q_OS_WIN)
+    return _commit(file.handle()) == 0;
+#elif defined(Q_OS_LINUX)
+    return ::fdatasync(file.handle()) == 0;
+#else
+    return ::fsync(file.handle()) == 0;
+#endif
+}
+
+}
+
+class ReceiptJournal::WriterThread : public QThread {
+public:
+    SpscByteRing* ring = nullptr;
+    std::chrono::microseconds commitDelay{0};
+    QFile file;
+    bool sync = true;
+    std::atomic<bool> running{false};
+    std::atomic<bool> idle{false};
+    QMutex mutex;
+    QWaitCondition wakeup;
+
+    std::atomic<uint64_t> records{0};
+    std::atomic<uint64_t> commits{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> maxBatchRecords{0};
+    std::atomic<int64_t> totalLatencyNs{0};
+    std::atomic<int64_t> maxLatencyNs{0};
+    std::atomic<uint64_t> failedCommits{0};
+    std::atomic<uint64_t> lostRecords{0};
+    // Cleared when a batch is lost; the journal no longer rebuilds the open
+    // receipt until a closed one restarts it.
+    std::atomic<bool> intact{true};
+
+    // The fence pairs with the one in run(): either the writer sees the new
+    // record before it sleeps, or this sees idle and wakes it under the mutex,
+    // which the writer holds until it is actually waiting.
+    void wake() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!idle.load(std::memory_order_relaxed)) return;
+        QMutexLocker lock(&mutex);
+        wakeup.wakeOne();
+    }
+
+    void run() override {
+        std::vector<char> batch;
+        batch.reserve(MaxBatchBytes);
+
+        while (true) {
+            if (ring->available() == 0) {
+                if (!running) break;
+                mutex.lock();
+                idle.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (ring->available() == 0 && running) wakeup.wait(&mutex);
+                idle.store(false, std::memory_order_relaxed);
+                mutex.unlock();
+                continue;
+            }
+
+            // Give concurrent records a bounded window to join this commit.
+            const auto deadline = std::chrono::steady_clock::now() + commitDelay;
+            while (running && ring->available() < MaxBatchBytes && std::chrono::steady_clock::now() < deadline) {
+                QThread::usleep(100);
+            }
+
+            batch.clear();
+            ring->drain(batch);
+            commit(batch);
+        }
+    }
+
+    void commit(const std::vector<char>& batch) {
+        // Everything up to the last closed receipt is irrelevant for recovery,
+        // so the journal restarts from the first record after it.
+        size_t keepFrom = 0;
+        uint64_t batchRecords = 0;
+        int64_t oldestTimestamp = 0;
+        for (size_t offset = 0; offset < batch.size(); ++batchRecords) {
+            RecordHeader header;
+            std::memcpy(&header, batch.data() + offset, sizeof(header));
+            if (batchRecords == 0) oldestTimestamp = header.timestampNs;
+            offset += sizeof(header) + header.payloadSize;
+            if (isClosingOp(header.op)) keepFrom = offset;
+        }
+
+        // A failed batch is cut off again so that later records do not follow a
+        // torn one, which would hide them from replay.
+        const qint64 start = keepFrom > 0 ? 0 : file.size();
+        const qint64 size = static_cast<qint64>(batch.size() - keepFrom);
+        const bool written = (keepFrom == 0 || (file.resize(0) && file.seek(0)))
+            && (size == 0 || file.write(batch.data() + keepFrom, size) == size)
+            && (!sync || syncToDisk(file));
+        if (!written) {
+            file.resize(start);
+            failedCommits += 1;
+            lostRecords += batchRecords;
+            intact = false;
+            return;
+        }
+        if (keepFrom > 0) intact = true;
+
+        const int64_t latency = monotonicNs() - oldestTimestamp;
+        records += batchRecords;
+        commits += 1;
+        bytes += static_cast<uint64_t>(size);
+        totalLatencyNs += latency;
+        if (batchRecords > maxBatchRecords) maxBatchRecords = batchRecords;
+        if (latency > maxLatencyNs) maxLatencyNs = latency;
+    }
+};
+
+ReceiptJournal::ReceiptJournal(std::chrono::microseconds commitDelay)
+    : m_ring(RingCapacity), m_commitDelay(commitDelay) {}
+
+ReceiptJournal::~ReceiptJournal() {
+    close();
+}
+
+bool ReceiptJournal::open(const QString& filePath, bool sync) {
+    close();
+
+    // Drop a torn tail left by a crash so new records stay reachable on replay.
+    QFile existing(filePath);
+    if (existing.open(QIODevice::ReadOnly)) {
+        const QByteArray data = existing.readAll();
+        existing.close();
+        const size_t validLength = validPrefixLength(data);
+        if (validLength < static_cast<size_t>(data.size())) {
+            QFile::resize(filePath, static_cast<qint64>(validLength));
+        }
+    }
+
+    auto writer = std::make_unique<WriterThread>();
+    writer->file.setFileName(filePath);
+    if (!writer->file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered)) return false;
+
+    writer->ring = &m_ring;
+    writer->commitDelay = m_commitDelay;
+    writer->sync = sync;
+    writer->running = true;
+    writer->start();
+    m_writer = std::move(writer);
+    return true;
+}
+
+void ReceiptJournal::close() {
+    if (!m_writer) return;
+
+    m_writer->running = false;
+    m_writer->wake();
+    m_writer->wait();
+    m_writer->file.close();
+    m_writer.reset();
+}
+
+bool ReceiptJournal::isOpen() const {
+    return m_writer != nullptr;
+}
+
+void ReceiptJournal::append(JournalOp op, const void* payload, uint32_t payloadSize) {
+    if (!m_writer) return;
+    // Could never be pushed; the loggers split or bound what they write.
+    Q_ASSERT(sizeof(RecordHeader) + payloadSize <= MaxRecordBytes);
+    if (sizeof(RecordHeader) + payloadSize > MaxRecordBytes) return;
+
+    RecordHeader header{};
+    header.payloadSize = payloadSize;
+    header.op = static_cast<uint16_t>(op);
+    header.checksum = checksum(static_cast<const char*>(payload), payloadSize);
+    header.timestampNs = monotonicNs();
+
+    // Only a stalled disk can fill the ring; wait for the writer rather than
+    // dropping a mutation.
+    while (!m_ring.tryPush(&header, sizeof(header), payload, payloadSize)) {
+        m_writer->wake();
+        QThread::yieldCurrentThread();
+    }
+    m_writer->wake();
+}
+
+void ReceiptJournal::logAddItem(const ReceiptItem& item) {
+    logItem(JournalOp::AddItem, item);
+}
+
+void ReceiptJournal::logAppendItem(const ReceiptItem& item) {
+    logItem(JournalOp::AppendItem, item);
+}
+
+void ReceiptJournal::logItem(JournalOp op, const ReceiptItem& item) {
+    const QString name = item.name().left(0xFFFF);
+    std::vector<char> payload(sizeof(AddItemPayload) + static_cast<size_t>(name.size()) * sizeof(char16_t));
+
+    AddItemPayload fixed{};
+    fixed.price = item.price().amount();
+    fixed.barcode = item.barcode();
+    fixed.quantity = item.quantity();
+    fixed.nameLength = static_cast<uint16_t>(name.size());
+    fixed.unit = static_cast<uint8_t>(item.unit());
+    std::memcpy(payload.data(), &fixed, sizeof(fixed));
+    std::memcpy(payload.data() + sizeof(fixed), name.utf16(), static_cast<size_t>(name.size()) * sizeof(char16_t));
+
+    append(op, payload.data(), static_cast<uint32_t>(payload.size()));
+}
+
+void ReceiptJournal::logRemoveItem(int row) {
+    const int32_t value = row;
+    append(JournalOp::RemoveItem, &value, sizeof(value));
+}
+
+// Rows come sorted from the bottom up, so a long list splits into records
+// that replay one after another without renumbering each other's rows.
+void ReceiptJournal::logRemoveItems(const std::vector<int>& rows) {
+    constexpr size_t RowsPerRecord = (MaxRecordBytes - sizeof(RecordHeader)) / sizeof(int32_t);
+    for (size_t first = 0; first < rows.size(); first += RowsPerRecord) {
+        const size_t count = std::min(rows.size() - first, RowsPerRecord);
+        std::vector<int32_t> values(rows.begin() + static_cast<std::ptrdiff_t>(first),
+                                    rows.begin() + static_cast<std::ptrdiff_t>(first + count));
+        append(JournalOp::RemoveItems, values.data(), static_cast<uint32_t>(values.size() * sizeof(int32_t)));
+    }
+}
+
+void ReceiptJournal::logUpdateQuantity(int row, int quantity) {
+    const int32_t values[2] = { row, quantity };
+    append(JournalOp::UpdateQuantity, values, sizeof(values));
+}
+
+void ReceiptJournal::logMoveItem(int from, int to) {
+    const int32_t values[2] = { from, to };
+    append(JournalOp::MoveItem, values, sizeof(values));
+}
+
+void ReceiptJournal::logReset() {
+    append(JournalOp::Reset, nullptr, 0);
+}
+
+void ReceiptJournal::logTender(Money amount) {
+    const int64_t value = amount.amount();
+    append(JournalOp::Tender, &value, sizeof(value));
+}
+
+void ReceiptJournal::logApprove() {
+    append(JournalOp::Approve, nullptr, 0);
+}
+
+void ReceiptJournal::logDecline() {
+    append(JournalOp::Decline, nullptr, 0);
+}
+
+void ReceiptJournal::logSaleId(uint64_t saleId) {
+    append(JournalOp::SaleId, &saleId, sizeof(saleId));
+}
+
+JournalStats ReceiptJournal::stats() const {
+    JournalStats result;
+    if (!m_writer) return result;
+
+    result.records = m_writer->records;
+    result.commits = m_writer->commits;
+    result.bytes = m_writer->bytes;
+    result.maxBatchRecords = m_writer->maxBatchRecords;
+    if (result.commits > 0) {
+        result.averageBatchRecords = static_cast<double>(result.records) / static_cast<double>(result.commits);
+        result.averageCommitLatencyUs = m_writer->totalLatencyNs / static_cast<int64_t>(result.commits) / 1000;
+    }
+    result.maxCommitLatencyUs = m_writer->maxLatencyNs / 1000;
+    result.failedCommits = m_writer->failedCommits;
+    result.lostRecords = m_writer->lostRecords;
+    return result;
+}
+
+bool ReceiptJournal::isIntact() const {
+    return !m_writer || m_writer->intact;
+}
+
+std::vector<JournalEntry> ReceiptJournal::readOpenReceipt(const QString& filePath) {
+    std::vector<JournalEntry> entries;
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) return entries;
+    const QByteArray data = file.readAll();
+
+    size_t offset = 0;
+    const size_t size = validPrefixLength(data);
+    while (offset < size) {
+        RecordHeader header;
+        std::memcpy(&header, data.constData() + offset, sizeof(header));
+        const char* payload = data.constData() + offset + sizeof(header);
+        offset += sizeof(header) + header.payloadSize;
+
+        JournalEntry entry;
+        entry.op = static_cast<JournalOp>(header.op);
+        switch (entry.op) {
+        case JournalOp::AddItem:
+        case JournalOp::AppendItem: {
+            AddItemPayload fixed;
+            if (header.payloadSize < sizeof(fixed)) return entries;
+            std::memcpy(&fixed, payload, sizeof(fixed));
+            if (header.payloadSize != sizeof(fixed) + fixed.nameLength * sizeof(char16_t)) return entries;
+            const QString name = QString::fromUtf16(reinterpret_cast<const char16_t*>(payload + sizeof(fixed)), fixed.nameLength);
+            entry.item = ReceiptItem(name, Money(fixed.price), fixed.quantity, fixed.barcode, static_cast<QuantityUnit>(fixed.unit));
+            break;
+        }
+        case JournalOp::RemoveItem: {
+            int32_t row = 0;
+            if (header.payloadSize != sizeof(row)) return entries;
+            std::memcpy(&row, payload, sizeof(row));
+            entry.row = row;
+            break;
+        }
+        case JournalOp::RemoveItems: {
+            entry.rows.resize(header.payloadSize / sizeof(int32_t));
+            for (size_t i = 0; i < entry.rows.size(); ++i) {
+                int32_t row = 0;
+                std::memcpy(&row, payload + i * sizeof(int32_t), sizeof(row));
+                entry.rows[i] = row;
+            }
+            break;
+        }
+        case JournalOp::UpdateQuantity:
+        case JournalOp::MoveItem: {
+            int32_t values[2] = {};
+            if (header.payloadSize != sizeof(values)) return entries;
+            std::memcpy(values, payload, sizeof(values));
+            entry.row = values[0];
+            entry.value = values[1];
+            break;
+        }
+        case JournalOp::Tender: {
+            int64_t amount = 0;
+            if (header.payloadSize != sizeof(amount)) return entries;
+            std::memcpy(&amount, payload, sizeof(amount));
+            entry.amount = Money(amount);
+            break;
+        }
+        case JournalOp::SaleId: {
+            if (header.payloadSize != sizeof(entry.saleId)) return entries;
+            std::memcpy(&entry.saleId, payload, sizeof(entry.saleId));
+            break;
+        }
+        case JournalOp::Approve:
+        case JournalOp::Decline:
+            entries.clear();
+            continue;
+        case JournalOp::Reset:
+            break;
+        default:
+            return entries;
+        }
+        entries.push_back(std::move(entry));
+    }
+    return entries;
+}
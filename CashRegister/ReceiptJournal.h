@@ -0,0 +1,105 @@
+#pragma once
+
+#include <QString>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "money.h"
+#include "Receipt.h"
+#include "SpscByteRing.h"
+
+enum class JournalOp : uint16_t {
+    AddItem = 1,
+    RemoveItem,
+    RemoveItems,
+    UpdateQuantity,
+    MoveItem,
+    Reset,
+    Tender,
+    Approve,
+    Decline,
+    SaleId,
+    // A line appended as is, without merging into an equal one.
+    AppendItem
+};
+
+struct JournalEntry {
+    JournalOp op = JournalOp::Reset;
+    ReceiptItem item;
+    std::vector<int> rows;
+    int row = -1;
+    int value = 0;
+    Money amount;
+    uint64_t saleId = 0;
+};
+
+struct JournalStats {
+    uint64_t records = 0;
+    uint64_t commits = 0;
+    uint64_t bytes = 0;
+    uint64_t maxBatchRecords = 0;
+    double averageBatchRecords = 0.0;
+    int64_t averageCommitLatencyUs = 0;
+    int64_t maxCommitLatencyUs = 0;
+    // Batches that could not be written or synced, and the records in them;
+    // none of these count as committed above.
+    uint64_t failedCommits = 0;
+    uint64_t lostRecords = 0;
+};
+
+// Append-only write-ahead journal of receipt mutations. The GUI thread encodes
+// records into a lock-free ring; a writer thread drains it and group-commits
+// each batch with a single write and fdatasync, waiting at most commitDelay
+// for more records to join the batch.
+class ReceiptJournal {
+public:
+    explicit ReceiptJournal(std::chrono::microseconds commitDelay = std::chrono::milliseconds(2));
+    ~ReceiptJournal();
+
+    ReceiptJournal(const ReceiptJournal&) = delete;
+    ReceiptJournal& operator=(const ReceiptJournal&) = delete;
+
+    // With sync false commits are written but never synced: a crash of the
+    // process loses nothing, a power cut may. Meant for load tests.
+    bool open(const QString& filePath, bool sync = true);
+    void close();
+    [[nodiscard]] bool isOpen() const;
+
+    void logAddItem(const ReceiptItem& item);
+    void logAppendItem(const ReceiptItem& item);
+    void logRemoveItem(int row);
+    // rows sorted from the bottom up, as Receipt::removeItems() passes them.
+    void logRemoveItems(const std::vector<int>& rows);
+    void logUpdateQuantity(int row, int quantity);
+    void logMoveItem(int from, int to);
+    void logReset();
+    void logTender(Money amount);
+    void logApprove();
+    void logDecline();
+    // The id the open receipt will be recorded under in the sales ledger.
+    void logSaleId(uint64_t saleId);
+
+    [[nodiscard]] JournalStats stats() const;
+
+    // False once a batch has failed to reach the file: recovery would rebuild
+    // a different receipt. The next closed receipt restarts the journal and
+    // makes it whole again.
+    [[nodiscard]] bool isIntact() const;
+
+    // Decodes the journal and returns the operations recorded after the last
+    // approve/decline, i.e. what is needed to rebuild the open receipt. Stops
+    // at the first torn or corrupted record.
+    static std::vector<JournalEntry> readOpenReceipt(const QString& filePath);
+
+private:
+    class WriterThread;
+
+    void append(JournalOp op, const void* payload, uint32_t payloadSize);
+    void logItem(JournalOp op, const ReceiptItem& item);
+
+    SpscByteRing m_ring;
+    std::unique_ptr<WriterThread> m_writer;
+    std::chrono::microseconds m_commitDelay;
+};
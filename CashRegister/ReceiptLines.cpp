@@ -0,0 +1,434 @@
+#include "ReceiptLines.h"
+#include <algorithm>
+#include <array>
+#include <new>
+#include <vector>
+
+namespace {
+
+void* allocateIn(ReceiptArena* arena, size_t size) {
+    return arena ? arena->allocate(size) : ::operator new(size);
+}
+
+void deallocateIn(ReceiptArena* arena, void* p, size_t size) {
+    if (arena) arena->deallocate(p, size);
+    else ::operator delete(p);
+}
+
+}
+
+struct ReceiptLines::Chunk {
+    int refs = 1;
+    int count = 0;
+    std::array<NamePool::Id, ChunkCapacity> nameIds{};
+    std::array<int64_t, ChunkCapacity> prices{};
+    std::array<int, ChunkCapacity> quantities{};
+    std::array<uint64_t, ChunkCapacity> barcodes{};
+    std::array<QuantityUnit, ChunkCapacity> units{};
+
+    template <typename F>
+    void forEachColumn(F&& f) {
+        f(nameIds);
+        f(prices);
+        f(quantities);
+        f(barcodes);
+        f(units);
+    }
+
+    void set(int i, const ReceiptLine& line) {
+        nameIds[i] = line.nameId;
+        prices[i] = line.price;
+        quantities[i] = line.quantity;
+        barcodes[i] = line.barcode;
+        units[i] = line.unit;
+    }
+
+    [[nodiscard]] Run run() const {
+        return Run{ nameIds.data(), prices.data(), quantities.data(), barcodes.data(), units.data(), count };
+    }
+};
+
+struct ReceiptLines::Table {
+    int refs = 1;
+    int chunkCount = 0;
+    int capacity = 0;
+    Chunk** chunks = nullptr;
+    // ends[i] is the number of rows in chunks 0..i.
+    int* ends = nullptr;
+
+    void rebuildEnds(int from) {
+        int end = from > 0 ? ends[from - 1] : 0;
+        for (int i = from; i < chunkCount; ++i) {
+            end += chunks[i]->count;
+            ends[i] = end;
+        }
+    }
+};
+
+ReceiptLine ReceiptLines::Run::line(int i) const {
+    return ReceiptLine{ nameIds[i], prices[i], quantities[i], barcodes[i], units[i] };
+}
+
+ReceiptLines::ReceiptLines(ReceiptArena* arena) : m_arena(arena), d(nullptr) {}
+
+ReceiptLines::ReceiptLines(const ReceiptLines& other) : m_arena(other.m_arena), d(other.d) {
+    if (d) ++d->refs;
+}
+
+ReceiptLines& ReceiptLines::operator=(const ReceiptLines& other) {
+    if (other.d) ++other.d->refs;
+    release(m_arena, d);
+    m_arena = other.m_arena;
+    d = other.d;
+    return *this;
+}
+
+ReceiptLines::~ReceiptLines() {
+    release(m_arena, d);
+}
+
+void ReceiptLines::release(ReceiptArena* arena, Table* table) {
+    if (!table || --table->refs > 0) return;
+    for (int i = 0; i < table->chunkCount; ++i) release(arena, table->chunks[i]);
+    deallocateIn(arena, table->chunks, sizeof(Chunk*) * table->capacity);
+    deallocateIn(arena, table->ends, sizeof(int) * table->capacity);
+    table->~Table();
+    deallocateIn(arena, table, sizeof(Table));
+}
+
+void ReceiptLines::release(ReceiptArena* arena, Chunk* chunk) {
+    if (--chunk->refs > 0) return;
+    chunk->~Chunk();
+    deallocateIn(arena, chunk, sizeof(Chunk));
+}
+
+ReceiptArena* ReceiptLines::arena() const {
+    return m_arena;
+}
+
+int ReceiptLines::size() const {
+    return d && d->chunkCount > 0 ? d->ends[d->chunkCount - 1] : 0;
+}
+
+bool ReceiptLines::isEmpty() const {
+    return size() == 0;
+}
+
+int ReceiptLines::locate(int row, int& offset) const {
+    const int* ends = d->ends;
+    const int index = static_cast<int>(std::upper_bound(ends, ends + d->chunkCount, row) - ends);
+    offset = row - (index > 0 ? ends[index - 1] : 0);
+    return index;
+}
+
+ReceiptLines::Chunk* ReceiptLines::newChunk(const Chunk* from) {
+    void* memory = allocateIn(m_arena, sizeof(Chunk));
+    Chunk* chunk = from ? new (memory) Chunk(*from) : new (memory) Chunk;
+    chunk->refs = 1;
+    return chunk;
+}
+
+void ReceiptLines::reserveChunks(Table& table, int count) {
+    if (count <= table.capacity) return;
+    const int capacity = std::max({ 4, table.capacity * 2, count });
+    auto* chunks = static_cast<Chunk**>(allocateIn(m_arena, sizeof(Chunk*) * capacity));
+    auto* ends = static_cast<int*>(allocateIn(m_arena, sizeof(int) * capacity));
+    std::copy(table.chunks, table.chunks + table.chunkCount, chunks);
+    std::copy(table.ends, table.ends + table.chunkCount, ends);
+    deallocateIn(m_arena, table.chunks, sizeof(Chunk*) * table.capacity);
+    deallocateIn(m_arena, table.ends, sizeof(int) * table.capacity);
+    table.chunks = chunks;
+    table.ends = ends;
+    table.capacity = capacity;
+}
+
+void ReceiptLines::insertChunk(Table& table, int index, Chunk* chunk) {
+    reserveChunks(table, table.chunkCount + 1);
+    std::copy_backward(table.chunks + index, table.chunks + table.chunkCount, table.chunks + table.chunkCount + 1);
+    table.chunks[index] = chunk;
+    ++table.chunkCount;
+    table.rebuildEnds(index);
+}
+
+void ReceiptLines::removeChunk(Table& table, int index) {
+    release(m_arena, table.chunks[index]);
+    std::copy(table.chunks + index + 1, table.chunks + table.chunkCount, table.chunks + index);
+    --table.chunkCount;
+}
+
+// Mutations first copy the table, and then the chunk they change, if a copy
+// of the sequence still shares them; once copied they belong to this sequence
+// alone.
+ReceiptLines::Table& ReceiptLines::detachTable() {
+    if (!d) {
+        d = new (allocateIn(m_arena, sizeof(Table))) Table;
+    } else if (d->refs > 1) {
+        Table* copy = new (allocateIn(m_arena, sizeof(Table))) Table;
+        reserveChunks(*copy, d->chunkCount);
+        std::copy(d->chunks, d->chunks + d->chunkCount, copy->chunks);
+        std::copy(d->ends, d->ends + d->chunkCount, copy->ends);
+        copy->chunkCount = d->chunkCount;
+        for (int i = 0; i < copy->chunkCount; ++i) ++copy->chunks[i]->refs;
+        --d->refs;
+        d = copy;
+    }
+    return *d;
+}
+
+ReceiptLines::Chunk& ReceiptLines::detachChunk(int index) {
+    Table& table = detachTable();
+    Chunk*& chunk = table.chunks[index];
+    if (chunk->refs > 1) {
+        Chunk* copy = newChunk(chunk);
+        --chunk->refs;
+        chunk = copy;
+    }
+    return *chunk;
+}
+
+ReceiptLine ReceiptLines::line(int row) const {
+    int offset = 0;
+    const int index = locate(row, offset);
+    return d->chunks[index]->run().line(offset);
+}
+
+NamePool::Id ReceiptLines::nameId(int row) const {
+    int offset = 0;
+    const int index = locate(row, offset);
+    return d->chunks[index]->nameIds[offset];
+}
+
+int64_t ReceiptLines::price(int row) const {
+    int offset = 0;
+    const int index = locate(row, offset);
+    return d->chunks[index]->prices[offset];
+}
+
+int ReceiptLines::quantity(int row) const {
+    int offset = 0;
+    const int index = locate(row, offset);
+    return d->chunks[index]->quantities[offset];
+}
+
+uint64_t ReceiptLines::barcode(int row) const {
+    int offset = 0;
+    const int index = locate(row, offset);
+    return d->chunks[index]->barcodes[offset];
+}
+
+QuantityUnit ReceiptLines::unit(int row) const {
+    int offset = 0;
+    const int index = locate(row, offset);
+    return d->chunks[index]->units[offset];
+}
+
+void ReceiptLines::append(const ReceiptLine& line) {
+    Table& table = detachTable();
+    if (table.chunkCount == 0 || table.chunks[table.chunkCount - 1]->count == ChunkCapacity) {
+        insertChunk(table, table.chunkCount, newChunk(nullptr));
+    }
+    Chunk& chunk = detachChunk(table.chunkCount - 1);
+    chunk.set(chunk.count++, line);
+    ++table.ends[table.chunkCount - 1];
+}
+
+// A full chunk is split in half, so inserts in the middle touch one or two
+// chunks rather than shifting the rest of the receipt.
+void ReceiptLines::insert(int row, const ReceiptLine& line) {
+    if (row >= size()) {
+        append(line);
+        return;
+    }
+
+    int offset = 0;
+    int index = locate(row, offset);
+    // A split leaves the ends of the split chunk stale, so they are all
+    // recomputed from it rather than from where the line lands.
+    const int first = index;
+    Table& table = detachTable();
+    if (table.chunks[index]->count == ChunkCapacity) {
+        Chunk& full = detachChunk(index);
+        const int half = ChunkCapacity / 2;
+        Chunk* upper = newChunk(&full);
+        upper->count = full.count - half;
+        upper->forEachColumn([half](auto& column) {
+            std::copy(column.begin() + half, column.end(), column.begin());
+        });
+        full.count = half;
+        insertChunk(table, index + 1, upper);
+        if (offset > half) {
+            offset -= half;
+            ++index;
+        }
+    }
+
+    Chunk& chunk = detachChunk(index);
+    chunk.forEachColumn([&chunk, offset](auto& column) {
+        std::copy_backward(column.begin() + offset, column.begin() + chunk.count, column.begin() + chunk.count + 1);
+    });
+    chunk.set(offset, line);
+    ++chunk.count;
+    table.rebuildEnds(first);
+}
+
+// Emptied chunks are dropped, and a chunk left under a quarter full is folded
+// into its successor when they fit together, so long edit sessions do not
+// leave a trail of tiny chunks behind.
+void ReceiptLines::erase(int first, int count) {
+    if (count <= 0) return;
+
+    int offset = 0;
+    const int startIndex = locate(first, offset);
+    Table& table = detachTable();
+    int index = startIndex;
+    while (count > 0 && index < table.chunkCount) {
+        Chunk& chunk = detachChunk(index);
+        const int n = std::min(count, chunk.count - offset);
+        chunk.forEachColumn([&chunk, offset, n](auto& column) {
+            std::copy(column.begin() + offset + n, column.begin() + chunk.count, column.begin() + offset);
+        });
+        chunk.count -= n;
+        count -= n;
+        if (chunk.count == 0) {
+            removeChunk(table, index);
+        } else {
+            ++index;
+        }
+        offset = 0;
+    }
+
+    const int small = std::min(startIndex, table.chunkCount - 1);
+    if (small >= 0 && small + 1 < table.chunkCount) {
+        const Chunk& left = *table.chunks[small];
+        const Chunk& right = *table.chunks[small + 1];
+        if (left.count < ChunkCapacity / 4 && left.count + right.count <= ChunkCapacity) {
+            Chunk& merged = detachChunk(small + 1);
+            const int shift = left.count;
+            merged.forEachColumn([&merged, shift](auto& column) {
+                std::copy_backward(column.begin(), column.begin() + merged.count, column.begin() + merged.count + shift);
+            });
+            for (int i = 0; i < shift; ++i) merged.set(i, left.run().line(i));
+            merged.count += shift;
+            removeChunk(table, small);
+        }
+    }
+    table.rebuildEnds(std::max(0, std::min(startIndex, small)));
+}
+
+void ReceiptLines::move(int from, int to) {
+    const ReceiptLine moved = line(from);
+    erase(from, 1);
+    insert(to, moved);
+}
+
+void ReceiptLines::setQuantity(int row, int quantity) {
+    int offset = 0;
+    const int index = locate(row, offset);
+    detachChunk(index).quantities[offset] = quantity;
+}
+
+void ReceiptLines::clear() {
+    release(m_arena, d);
+    d = nullptr;
+}
+
+void ReceiptLines::forget() {
+    d = nullptr;
+}
+
+void ReceiptLines::forEachRun(const RunVisitor& visit) const {
+    if (!d) return;
+    for (int i = 0; i < d->chunkCount; ++i) {
+        visit(d->chunks[i]->run());
+    }
+}
+
+void ReceiptLines::diff(const ReceiptLines& from, const ReceiptLines& to,
+                        const RunVisitor& removed, const RunVisitor& added) {
+    if (from.d == to.d) return;
+
+    auto sortedChunks = [](const ReceiptLines& lines) {
+        std::vector<const Chunk*> chunks;
+        if (!lines.d) return chunks;
+        chunks.assign(lines.d->chunks, lines.d->chunks + lines.d->chunkCount);
+        std::sort(chunks.begin(), chunks.end());
+        return chunks;
+    };
+    const std::vector<const Chunk*> before = sortedChunks(from);
+    const std::vector<const Chunk*> after = sortedChunks(to);
+
+    auto b = before.begin();
+    auto a = after.begin();
+    while (b != before.end() || a != after.end()) {
+        if (a == after.end() || (b != before.end() && *b < *a)) {
+            removed((*b++)->run());
+        } else if (b == before.end() || *a < *b) {
+            added((*a++)->run());
+        } else {
+            ++b;
+            ++a;
+        }
+    }
+}
+
+void ReceiptLines::commonEnds(const ReceiptLines& from, const ReceiptLines& to, int& prefix, int& suffix) {
+    const int limit = std::min(from.size(), to.size());
+    prefix = 0;
+    suffix = 0;
+    if (from.d == to.d) {
+        prefix = limit;
+        return;
+    }
+    if (limit == 0) return;
+
+    auto same = [](const Chunk* a, int i, const Chunk* b, int j) {
+        return a->nameIds[i] == b->nameIds[j] && a->prices[i] == b->prices[j]
+            && a->quantities[i] == b->quantities[j] && a->barcodes[i] == b->barcodes[j] && a->units[i] == b->units[j];
+    };
+
+    // Positions are a chunk index and an offset into that chunk.
+    int fromChunk = 0;
+    int fromOffset = 0;
+    int toChunk = 0;
+    int toOffset = 0;
+    while (prefix < limit) {
+        const Chunk* a = from.d->chunks[fromChunk];
+        const Chunk* b = to.d->chunks[toChunk];
+        if (a == b && fromOffset == 0 && toOffset == 0) {
+            prefix += a->count;
+            ++fromChunk;
+            ++toChunk;
+            continue;
+        }
+        if (!same(a, fromOffset, b, toOffset)) break;
+        ++prefix;
+        if (++fromOffset == a->count) {
+            ++fromChunk;
+            fromOffset = 0;
+        }
+        if (++toOffset == b->count) {
+            ++toChunk;
+            toOffset = 0;
+        }
+    }
+
+    fromChunk = from.d->chunkCount - 1;
+    toChunk = to.d->chunkCount - 1;
+    fromOffset = from.d->chunks[fromChunk]->count - 1;
+    toOffset = to.d->chunks[toChunk]->count - 1;
+    while (suffix < limit - prefix) {
+        const Chunk* a = from.d->chunks[fromChunk];
+        const Chunk* b = to.d->chunks[toChunk];
+        if (a == b && fromOffset == a->count - 1 && toOffset == b->count - 1 && suffix + a->count <= limit - prefix) {
+            suffix += a->count;
+            if (suffix == limit - prefix) break;
+            fromOffset = from.d->chunks[--fromChunk]->count - 1;
+            toOffset = to.d->chunks[--toChunk]->count - 1;
+            continue;
+        }
+        if (!same(a, fromOffset, b, toOffset)) break;
+        if (++suffix == limit - prefix) break;
+        if (--fromOffset < 0) fromOffset = from.d->chunks[--fromChunk]->count - 1;
+        if (--toOffset < 0) toOffset = to.d->chunks[--toChunk]->count - 1;
+    }
+}
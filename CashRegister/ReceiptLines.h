@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include "NamePool.h"
+#include "QuantityUnit.h"
+#include "ReceiptArena.h"
+
+// One stored receipt line; the name is an id in the receipt's NamePool.
+struct ReceiptLine {
+    NamePool::Id nameId = 0;
+    int64_t price = 0;
+    int quantity = 0;
+    uint64_t barcode = 0;
+    QuantityUnit unit = QuantityUnit::Piece;
+};
+
+// Persistent sequence of receipt lines. Lines are kept column by column in
+// chunks of up to ChunkCapacity, and both the chunk table and every chunk are
+// reference counted: copying a ReceiptLines is O(1), and a later mutation
+// copies only the table of chunk pointers and the one chunk it touches. A copy
+// therefore never changes and serves as a snapshot that costs memory only for
+// the chunks changed after it was taken.
+//
+// Tables and chunks are allocated from the arena given at construction, or
+// from the heap without one, and copies share it; the arena must outlive every
+// copy. Row lookups binary-search the chunk table. A sequence and its copies
+// are used from one thread at a time.
+class ReceiptLines {
+public:
+    static constexpr int ChunkCapacity = 128;
+
+    // Consecutive lines within one chunk, column by column.
+    struct Run {
+        const NamePool::Id* nameIds;
+        const int64_t* prices;
+        const int* quantities;
+        const uint64_t* barcodes;
+        const QuantityUnit* units;
+        int count;
+
+        [[nodiscard]] ReceiptLine line(int i) const;
+    };
+
+    using RunVisitor = std::function<void(const Run&)>;
+
+    explicit ReceiptLines(ReceiptArena* arena = nullptr);
+    ReceiptLines(const ReceiptLines& other);
+    ReceiptLines& operator=(const ReceiptLines& other);
+    ~ReceiptLines();
+
+    [[nodiscard]] ReceiptArena* arena() const;
+    [[nodiscard]] int size() const;
+    [[nodiscard]] bool isEmpty() const;
+
+    [[nodiscard]] ReceiptLine line(int row) const;
+    [[nodiscard]] NamePool::Id nameId(int row) const;
+    [[nodiscard]] int64_t price(int row) const;
+    [[nodiscard]] int quantity(int row) const;
+    [[nodiscard]] uint64_t barcode(int row) const;
+    [[nodiscard]] QuantityUnit unit(int row) const;
+
+    void append(const ReceiptLine& line);
+    void insert(int row, const ReceiptLine& line);
+    void erase(int first, int count);
+    void move(int from, int to);
+    void setQuantity(int row, int quantity);
+    void clear();
+
+    // Drops the lines without releasing their memory, for an owner that is
+    // about to reset the arena and knows no copy of them is left.
+    void forget();
+
+    // Visits every line in order, one chunk at a time.
+    void forEachRun(const RunVisitor& visit) const;
+
+    // Visits the chunks held by only one of from and to. Chunks the two share
+    // are identical, so the cost is the number of chunks plus the lines that
+    // actually differ, however large the receipts are.
+    static void diff(const ReceiptLines& from, const ReceiptLines& to,
+                     const RunVisitor& removed, const RunVisitor& added);
+
+    // The number of lines from and to have in common at the start (prefix)
+    // and, beyond those, at the end (suffix); the lines in between are all
+    // that differ. Chunks the two share at the same place are skipped whole,
+    // so the cost follows the differing lines rather than the receipt size.
+    // Name ids are compared as they are, so both must use one pool.
+    static void commonEnds(const ReceiptLines& from, const ReceiptLines& to, int& prefix, int& suffix);
+
+private:
+    struct Chunk;
+    struct Table;
+
+    static void release(ReceiptArena* arena, Table* table);
+    static void release(ReceiptArena* arena, Chunk* chunk);
+
+    [[nodiscard]] int locate(int row, int& offset) const;
+    [[nodiscard]] Chunk* newChunk(const Chunk* from);
+    void reserveChunks(Table& table, int count);
+    void insertChunk(Table& table, int index, Chunk* chunk);
+    void removeChunk(Table& table, int index);
+    Table& detachTable();
+    Chunk& detachChunk(int index);
+
+    ReceiptArena* m_arena;
+    // Null while empty.
+    Table* d;
+};
@@ -1,55 +1,76 @@
 #include "ReceiptTableModel.h"
+#include <QTransform>
+#include <algorithm>
 
-ReceiptItem::ReceiptItem() : m_name(""), m_price(Money(0)), m_quantity(0) {}
+namespace {
 
-ReceiptItem::ReceiptItem(QString name, Money price, int quantity)
-    : m_name(std::move(name)), m_price(price), m_quantity(quantity > 0 ? quantity : 1) {}
-
-QString ReceiptItem::name() const { return m_name; }
-Money ReceiptItem::price() const { return m_price; }
-int ReceiptItem::quantity() const { return m_quantity; }
+const char16_t* unitSuffix(QuantityUnit unit) {
+    switch (unit) {
+    case QuantityUnit::Gram: return u" кг";
+    case QuantityUnit::Milliliter: return u" л";
+    case QuantityUnit::Piece: break;
+    }
+    return u"";
+}
 
-void ReceiptItem::setQuantity(int quantity) {
-    if (quantity > 0) {
-        m_quantity = quantity;
+const char16_t* perUnitSuffix(QuantityUnit unit) {
+    switch (unit) {
+    case QuantityUnit::Gram: return u"/кг";
+    case QuantityUnit::Milliliter: return u"/л";
+    case QuantityUnit::Piece: break;
     }
+    return u"";
 }
 
-Money ReceiptItem::total() const { return m_price * m_quantity; }
+}
 
 ReceiptTableModel::ReceiptTableModel(QObject* parent)
-    : QAbstractTableModel(parent) {}
+    : QAbstractTableModel(parent), m_ownedReceipt(std::make_unique<Receipt>()), m_receipt(*m_ownedReceipt),
+    m_publishedRows(0), m_pendingRows(0) {
+    m_receipt.setObserver(this);
+}
 
-void ReceiptTableModel::setItems(const std::vector<ReceiptItem>& items) {
-    beginResetModel();
-    m_items = items;
-    endResetModel();
-    emit totalsChanged();
+ReceiptTableModel::ReceiptTableModel(Receipt& receipt, QObject* parent)
+    : QAbstractTableModel(parent), m_receipt(receipt),
+    m_publishedRows(std::min(receipt.lineCount(), FetchBatch)), m_pendingRows(0) {
+    for (auto& cells : m_cells) cells.resize(static_cast<size_t>(m_publishedRows));
+    m_receipt.setObserver(this);
+}
+
+Receipt& ReceiptTableModel::receipt() {
+    return m_receipt;
+}
+
+const Receipt& ReceiptTableModel::receipt() const {
+    return m_receipt;
 }
 
 int ReceiptTableModel::rowCount(const QModelIndex& parent) const {
     if (parent.isValid()) return 0;
-    return static_cast<int>(m_items.size());
+    return m_publishedRows;
 }
 
 int ReceiptTableModel::columnCount(const QModelIndex& parent) const {
     if (parent.isValid()) return 0;
-    return 4;
+    return ColumnCount;
 }
 
 QVariant ReceiptTableModel::data(const QModelIndex& index, int role) const {
-    if (!index.isValid() || index.row() >= static_cast<int>(m_items.size())) {
+    if (!index.isValid() || index.row() >= m_publishedRows) {
         return {};
     }
 
-    const auto& item = m_items[index.row()];
+    const int row = index.row();
 
     if (role == Qt::DisplayRole) {
         switch (index.column()) {
-        case 0: return item.name();
-        case 1: return item.quantity();
-        case 2: return item.price().toString();
-        case 3: return item.total().toString();
+        case NameColumn: return m_receipt.name(row);
+        case QuantityColumn:
+            if (m_receipt.unit(row) == QuantityUnit::Piece) return m_receipt.quantity(row);
+            return cell(row, QuantityColumn).text();
+        case PriceColumn:
+        case TotalColumn:
+            return cell(row, index.column()).text();
         default: return {};
         }
     }
@@ -67,56 +88,191 @@ QVariant ReceiptTableModel::data(const QModelIndex& index, int role) const {
 QVariant ReceiptTableModel::headerData(int section, Qt::Orientation orientation, int role) const {
     if (role == Qt::DisplayRole && orientation == Qt::Horizontal) {
         switch (section) {
-        case 0: return QString("Назва товару");
-        case 1: return QString("К-ть");
-        case 2: return QString("Ціна");
-        case 3: return QString("Сума");
+        case NameColumn: return QString("Назва товару");
+        case QuantityColumn: return QString("К-ть");
+        case PriceColumn: return QString("Ціна");
+        case TotalColumn: return QString("Сума");
         default: return {};
         }
     }
     return {};
 }
 
-void ReceiptTableModel::addItem(const ReceiptItem& item) {
-    const int newRow = static_cast<int>(m_items.size());
-    beginInsertRows(QModelIndex(), newRow, newRow);
-    m_items.push_back(item);
-    endInsertRows();
-    emit totalsChanged();
+bool ReceiptTableModel::canFetchMore(const QModelIndex& parent) const {
+    return !parent.isValid() && !m_receipt.isUpdating() && m_publishedRows < m_receipt.lineCount();
 }
 
-void ReceiptTableModel::removeItem(int row) {
-    if (row < 0 || row >= static_cast<int>(m_items.size())) return;
+void ReceiptTableModel::fetchMore(const QModelIndex& parent) {
+    if (!canFetchMore(parent)) return;
+    publishRows(std::min(m_receipt.lineCount(), m_publishedRows + FetchBatch));
+}
 
-    beginRemoveRows(QModelIndex(), row, row);
-    m_items.erase(m_items.begin() + row);
-    endRemoveRows();
-    emit totalsChanged();
+const QStaticText& ReceiptTableModel::cell(int row, int column) const {
+    std::optional<QStaticText>& text = m_cells[column][row];
+    if (!text) {
+        text.emplace(formatCell(row, column));
+        text->setTextFormat(Qt::PlainText);
+        text->prepare(QTransform(), m_cellFont);
+    }
+    return *text;
+}
+
+// Weighed quantities are shown in kilograms or litres with three decimals, and
+// their prices are per kilogram or litre.
+QString ReceiptTableModel::formatCell(int row, int column) const {
+    const QuantityUnit unit = m_receipt.unit(row);
+    switch (column) {
+    case NameColumn:
+        return m_receipt.name(row);
+    case QuantityColumn: {
+        if (unit == QuantityUnit::Piece) return QString::number(m_receipt.quantity(row));
+        const int scale = quantityScale(unit);
+        const int quantity = m_receipt.quantity(row);
+        return QString("%1%2%3%4")
+            .arg(quantity / scale)
+            .arg(QChar(m_moneyFormat.decimalSeparator))
+            .arg(quantity % scale, 3, 10, QChar('0'))
+            .arg(QString::fromUtf16(unitSuffix(unit)));
+    }
+    case PriceColumn:
+        return m_receipt.price(row).toString(m_moneyFormat) + QString::fromUtf16(perUnitSuffix(unit));
+    case TotalColumn:
+        return m_receipt.lineTotal(row).toString(m_moneyFormat);
+    default:
+        return QString();
+    }
+}
+
+// Only published rows have cells; the rest are formatted once fetched.
+void ReceiptTableModel::clearCells(int column, int first, int last) {
+    auto& cells = m_cells[column];
+    last = std::min(last, static_cast<int>(cells.size()) - 1);
+    for (int row = first; row <= last; ++row) cells[static_cast<size_t>(row)].reset();
+}
+
+void ReceiptTableModel::linesAppended(int first, int last) {
+    if (first == m_publishedRows + m_pendingRows) m_pendingRows += last - first + 1;
+    if (!m_receipt.isUpdating()) publishPendingRows();
+}
+
+// Only the published part of a removal is announced; the rest was never seen.
+void ReceiptTableModel::linesAboutToBeRemoved(int first, int last) {
+    publishPendingRows();
+    last = std::min(last, m_publishedRows - 1);
+    if (first <= last) beginRemoveRows(QModelIndex(), first, last);
 }
 
-void ReceiptTableModel::updateQuantity(int row, int newQuantity) {
-    if (row < 0 || row >= static_cast<int>(m_items.size()) || newQuantity <= 0) return;
+void ReceiptTableModel::linesRemoved(int first, int last) {
+    last = std::min(last, m_publishedRows - 1);
+    if (first <= last) {
+        for (auto& cells : m_cells) cells.erase(cells.begin() + first, cells.begin() + last + 1);
+        m_publishedRows -= last - first + 1;
+        endRemoveRows();
+    }
+}
+
+// A single-row move between two valid, distinct rows is always accepted. A row
+// moved out of the published rows leaves the view and one moved into them
+// enters it; moves among unpublished rows are not announced.
+void ReceiptTableModel::lineAboutToBeMoved(int from, int to) {
+    publishPendingRows();
+    const bool fromPublished = from < m_publishedRows;
+    const bool toPublished = to < m_publishedRows;
+    if (fromPublished && toPublished) {
+        beginMoveRows(QModelIndex(), from, from, QModelIndex(), to > from ? to + 1 : to);
+    } else if (fromPublished) {
+        beginRemoveRows(QModelIndex(), from, from);
+    } else if (toPublished) {
+        beginInsertRows(QModelIndex(), to, to);
+    }
+}
+
+void ReceiptTableModel::lineMoved(int from, int to) {
+    const bool fromPublished = from < m_publishedRows;
+    const bool toPublished = to < m_publishedRows;
+    if (fromPublished && toPublished) {
+        for (auto& cells : m_cells) {
+            if (from < to) {
+                std::rotate(cells.begin() + from, cells.begin() + from + 1, cells.begin() + to + 1);
+            } else {
+                std::rotate(cells.begin() + to, cells.begin() + from, cells.begin() + from + 1);
+            }
+        }
+        endMoveRows();
+    } else if (fromPublished) {
+        for (auto& cells : m_cells) cells.erase(cells.begin() + from);
+        --m_publishedRows;
+        endRemoveRows();
+    } else if (toPublished) {
+        for (auto& cells : m_cells) cells.emplace(cells.begin() + to);
+        ++m_publishedRows;
+        endInsertRows();
+    }
+}
 
-    m_items[row].setQuantity(newQuantity);
-    const QModelIndex idx1 = index(row, 1);
-    const QModelIndex idx2 = index(row, 3);
-    emit dataChanged(idx1, idx2);
+void ReceiptTableModel::linesChanged(int first, int last) {
+    clearCells(QuantityColumn, first, last);
+    clearCells(TotalColumn, first, last);
+    last = std::min(last, m_publishedRows - 1);
+    if (first <= last) {
+        emit dataChanged(index(first, QuantityColumn), index(last, TotalColumn));
+    }
+}
+
+void ReceiptTableModel::aboutToReset() {
+    beginResetModel();
+}
+
+void ReceiptTableModel::resetDone() {
+    m_publishedRows = std::min(m_receipt.lineCount(), FetchBatch);
+    m_pendingRows = 0;
+    for (auto& cells : m_cells) {
+        cells.clear();
+        cells.resize(static_cast<size_t>(m_publishedRows));
+    }
+    endResetModel();
+}
+
+void ReceiptTableModel::updateFinished() {
+    publishPendingRows();
+}
+
+void ReceiptTableModel::totalsUpdated() {
     emit totalsChanged();
 }
 
-ReceiptItem ReceiptTableModel::getItem(int row) const {
-    if (row < 0 || row >= static_cast<int>(m_items.size())) return {};
-    return m_items[row];
+void ReceiptTableModel::publishRows(int count) {
+    if (count <= m_publishedRows) return;
+
+    beginInsertRows(QModelIndex(), m_publishedRows, count - 1);
+    for (auto& cells : m_cells) cells.resize(static_cast<size_t>(count));
+    m_publishedRows = count;
+    endInsertRows();
+}
+
+void ReceiptTableModel::publishPendingRows() {
+    const int count = m_publishedRows + m_pendingRows;
+    m_pendingRows = 0;
+    publishRows(count);
 }
 
-Money ReceiptTableModel::calculateSubtotal() const {
-    Money subtotal(0);
-    for (const auto& item : m_items) {
-        subtotal += item.total();
+void ReceiptTableModel::setCellFont(const QFont& font) {
+    m_cellFont = font;
+    for (auto& cells : m_cells) std::fill(cells.begin(), cells.end(), std::nullopt);
+    if (m_publishedRows > 0) {
+        emit dataChanged(index(0, 0), index(m_publishedRows - 1, ColumnCount - 1));
     }
-    return subtotal;
 }
 
-bool ReceiptTableModel::isEmpty() const {
-    return m_items.empty();
+void ReceiptTableModel::setMoneyFormat(const MoneyFormat& format) {
+    m_moneyFormat = format;
+    if (m_receipt.isEmpty()) return;
+
+    const int last = m_publishedRows - 1;
+    clearCells(QuantityColumn, 0, last);
+    clearCells(PriceColumn, 0, last);
+    clearCells(TotalColumn, 0, last);
+    if (m_publishedRows > 0) {
+        emit dataChanged(index(0, QuantityColumn), index(m_publishedRows - 1, TotalColumn));
+    }
 }
@@ -1,53 +1,97 @@
 #pragma once
 
 #include <QAbstractTableModel>
+#include <QFont>
+#include <QStaticText>
+#include <array>
+#include <memory>
+#include <optional>
 #include <vector>
 #include <QString>
 #include "money.h"
+#include "Receipt.h"
 
-class ReceiptItem {
-public:
-    ReceiptItem();
-    ReceiptItem(QString name, Money price, int quantity);
-
-    [[nodiscard]] QString name() const;
-    [[nodiscard]] Money price() const;
-    [[nodiscard]] int quantity() const;
-
-    void setQuantity(int quantity);
-
-    [[nodiscard]] Money total() const;
-
-private:
-    QString m_name;
-    Money m_price;
-    int m_quantity;
-};
-
-class ReceiptTableModel : public QAbstractTableModel {
+// Presents a Receipt to item views. The receipt owns the lines and totals;
+// this adapter translates its change notifications into Qt model signals and
+// caches formatted cells for painting.
+//
+// After a reset only the first FetchBatch rows are published; views pull in
+// the rest through fetchMore() as they scroll, so loading a bulk receipt does
+// not lay out every row up front. Published rows are always a prefix of the
+// receipt: a new line is published only when every line before it is, and
+// edits past the prefix reach the view once it fetches that far.
+class ReceiptTableModel : public QAbstractTableModel, private ReceiptObserver {
     Q_OBJECT
 
 public:
+    enum Column {
+        NameColumn,
+        QuantityColumn,
+        PriceColumn,
+        TotalColumn,
+        ColumnCount
+    };
+
+    static constexpr int FetchBatch = 1024;
+
+    // Adapts a receipt of its own.
     explicit ReceiptTableModel(QObject* parent = nullptr);
 
-    void setItems(const std::vector<ReceiptItem>& items);
+    // Adapts receipt, which must outlive the model and have no other observer.
+    explicit ReceiptTableModel(Receipt& receipt, QObject* parent = nullptr);
+
+    [[nodiscard]] Receipt& receipt();
+    [[nodiscard]] const Receipt& receipt() const;
 
     [[nodiscard]] int rowCount(const QModelIndex& parent = QModelIndex()) const override;
     [[nodiscard]] int columnCount(const QModelIndex& parent = QModelIndex()) const override;
     [[nodiscard]] QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
     [[nodiscard]] QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    [[nodiscard]] bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
+
+    // The formatted text of a published cell, built on first use and kept
+    // until the line changes; ReceiptItemDelegate paints straight from it.
+    [[nodiscard]] const QStaticText& cell(int row, int column) const;
 
-    void addItem(const ReceiptItem& item);
-    void removeItem(int row);
-    void updateQuantity(int row, int newQuantity);
+    void setMoneyFormat(const MoneyFormat& format);
 
-    [[nodiscard]] ReceiptItem getItem(int row) const;
-    [[nodiscard]] Money calculateSubtotal() const;
-    [[nodiscard]] bool isEmpty() const;
+    // Font the cached cells are laid out for; set it to the view's font.
+    void setCellFont(const QFont& font);
 
 signals:
     void totalsChanged();
 
 private:
-    std::vector<ReceiptItem> m_items;
+    void linesAppended(int first, int last) override;
+    void linesAboutToBeRemoved(int first, int last) override;
+    void linesRemoved(int first, int last) override;
+    void lineAboutToBeMoved(int from, int to) override;
+    void lineMoved(int from, int to) override;
+    void linesChanged(int first, int last) override;
+    void aboutToReset() override;
+    void resetDone() override;
+    void updateFinished() override;
+    void totalsUpdated() override;
+
+    [[nodiscard]] QString formatCell(int row, int column) const;
+    void clearCells(int column, int first, int last);
+    void publishRows(int count);
+    void publishPendingRows();
+
+    std::unique_ptr<Receipt> m_ownedReceipt;
+    Receipt& m_receipt;
+
+    // Formatted cells per column for the published rows, built when a cell is
+    // first painted and dropped when its line changes; a row never painted
+    // costs no QStaticText.
+    mutable std::array<std::vector<std::optional<QStaticText>>, ColumnCount> m_cells;
+    MoneyFormat m_moneyFormat;
+    QFont m_cellFont;
+
+    // Rows past the first batch after a reset stay unpublished until the view
+    // fetches them. Rows appended right after the published ones are pending
+    // until the update scope ends or another mutation needs a consistent view.
+    int m_publishedRows;
+    int m_pendingRows;
 };
@@ -0,0 +1,381 @@
+#include "RegisterEngine.h"
+#include "ProductCatalog.h"
+#include "PromotionEngine.h"
+#include "ReceiptJournal.h"
+#include "SalesLedger.h"
+#include <algorithm>
+
+RegisterEngine::RegisterEngine()
+    : m_catalog(nullptr), m_journal(nullptr), m_ledger(nullptr), m_tendered(0), m_saleId(0), m_selectedRow(-1) {
+    startSale();
+}
+
+void RegisterEngine::setCatalog(const ProductCatalog* catalog) {
+    m_catalog = catalog;
+}
+
+void RegisterEngine::setPromotions(PromotionEngine* promotions) {
+    m_receipt.setPromotions(promotions);
+}
+
+void RegisterEngine::setJournal(ReceiptJournal* journal) {
+    m_journal = journal;
+    m_receipt.setJournal(journal);
+    if (m_journal) m_journal->logSaleId(m_saleId);
+}
+
+void RegisterEngine::setLedger(SalesLedger* ledger) {
+    m_ledger = ledger;
+    if (m_ledger && m_saleId <= m_ledger->lastSaleId()) startSale();
+}
+
+Receipt& RegisterEngine::receipt() {
+    return m_receipt;
+}
+
+const Receipt& RegisterEngine::receipt() const {
+    return m_receipt;
+}
+
+RegisterEngine::EnterResult RegisterEngine::enter(const QString& text, int selectedRow) {
+    if (text.isEmpty()) return EnterResult::Ignored;
+
+    uint64_t barcode = 0;
+    if (selectedRow >= 0) {
+        const ReceiptSnapshot before = m_receipt.snapshot();
+        const int newQuantity = text.toInt();
+        if (newQuantity <= 0 || !m_receipt.isValidRow(selectedRow)) return EnterResult::Ignored;
+        if (!m_receipt.updateQuantity(selectedRow, newQuantity)) return EnterResult::TotalTooLarge;
+        checkpoint(before);
+        return EnterResult::QuantityChanged;
+    }
+    if (text.size() >= 8 && ProductCatalog::parseBarcode(text, barcode)) return scan(barcode);
+    tender(Money::fromString(text));
+    return EnterResult::Tendered;
+}
+
+// A weighed product's own code carries no weight; it is sold through the
+// label its scale prints, or addWeighed() from a connected scale.
+RegisterEngine::EnterResult RegisterEngine::scan(uint64_t barcode) {
+    if (!m_catalog) return EnterResult::UnknownBarcode;
+
+    CatalogEntry entry;
+    if (m_catalog->find(barcode, entry)) {
+        if (entry.unit != QuantityUnit::Piece) return EnterResult::WeightRequired;
+        const ReceiptSnapshot before = m_receipt.snapshot();
+        if (!m_receipt.addByBarcode(*m_catalog, barcode)) return EnterResult::TotalTooLarge;
+        checkpoint(before);
+        return EnterResult::ItemAdded;
+    }
+
+    uint64_t productCode = 0;
+    int quantity = 0;
+    if (ProductCatalog::parseScaleLabel(barcode, productCode, quantity)) return addWeighed(productCode, quantity);
+    return EnterResult::UnknownBarcode;
+}
+
+RegisterEngine::EnterResult RegisterEngine::addWeighed(uint64_t barcode, int quantity) {
+    if (quantity <= 0) return EnterResult::Ignored;
+
+    CatalogEntry entry;
+    if (!m_catalog || !m_catalog->find(barcode, entry) || entry.unit == QuantityUnit::Piece) {
+        return EnterResult::UnknownBarcode;
+    }
+    const ReceiptSnapshot before = m_receipt.snapshot();
+    if (!m_receipt.addByBarcode(*m_catalog, barcode, quantity)) return EnterResult::TotalTooLarge;
+    checkpoint(before);
+    return EnterResult::ItemAdded;
+}
+
+void RegisterEngine::tender(Money amount) {
+    m_tendered = amount;
+    if (m_journal) m_journal->logTender(m_tendered);
+}
+
+bool RegisterEngine::removeLine(int row) {
+    if (!m_receipt.isValidRow(row)) return false;
+    const ReceiptSnapshot before = m_receipt.snapshot();
+    recordVoid(VoidKind::Line, row);
+    m_receipt.removeItem(row);
+    checkpoint(before);
+    return true;
+}
+
+RegisterEngine::ApproveResult RegisterEngine::approve() {
+    if (m_receipt.isEmpty()) return ApproveResult::Empty;
+    if (m_tendered < m_receipt.amountDue()) return ApproveResult::Insufficient;
+
+    if (m_ledger && !m_ledger->appendSale(m_receipt.items(), m_tendered, m_receipt.discount(),
+                                          m_receipt.weightRounding(), m_saleId)) {
+        return ApproveResult::LedgerFailed;
+    }
+    if (m_journal) m_journal->logApprove();
+    startSale();
+    // History goes first, so the receipt's arena is no longer shared and is
+    // reset rather than replaced.
+    clearHistory();
+    m_receipt.setItems({});
+    resetPayment();
+    return ApproveResult::Approved;
+}
+
+void RegisterEngine::decline() {
+    if (!m_receipt.isEmpty()) recordVoid(VoidKind::Receipt, -1);
+    if (m_journal) {
+        // The id is still unused, but the journal drops everything up to a decline.
+        m_journal->logDecline();
+        m_journal->logSaleId(m_saleId);
+    }
+    clearHistory();
+    m_receipt.setItems({});
+    resetPayment();
+}
+
+bool RegisterEngine::undo() {
+    if (m_undo.empty()) return false;
+    m_redo.push_back(m_receipt.snapshot());
+    m_receipt.restore(m_undo.back());
+    m_undo.pop_back();
+    return true;
+}
+
+bool RegisterEngine::redo() {
+    if (m_redo.empty()) return false;
+    m_undo.push_back(m_receipt.snapshot());
+    m_receipt.restore(m_redo.back());
+    m_redo.pop_back();
+    return true;
+}
+
+bool RegisterEngine::canUndo() const {
+    return !m_undo.empty();
+}
+
+bool RegisterEngine::canRedo() const {
+    return !m_redo.empty();
+}
+
+bool RegisterEngine::suspend() {
+    if (m_receipt.isEmpty()) return false;
+
+    SuspendedReceipt parked;
+    parked.receipt = m_receipt.snapshot();
+    parked.suspendedAt = QDateTime::currentDateTimeUtc();
+    parked.undo = std::move(m_undo);
+    parked.redo = std::move(m_redo);
+    m_suspended.push_back(std::move(parked));
+
+    clearHistory();
+    m_receipt.setItems({});
+    clearTender();
+    resetPayment();
+    return true;
+}
+
+bool RegisterEngine::resume(int index) {
+    if (index < 0 || index >= static_cast<int>(m_suspended.size())) return false;
+
+    SuspendedReceipt parked = std::move(m_suspended[static_cast<size_t>(index)]);
+    m_suspended.erase(m_suspended.begin() + index);
+    suspend();
+
+    m_receipt.restore(parked.receipt);
+    m_undo = std::move(parked.undo);
+    m_redo = std::move(parked.redo);
+    clearTender();
+    resetPayment();
+    return true;
+}
+
+const std::deque<SuspendedReceipt>& RegisterEngine::suspendedReceipts() const {
+    return m_suspended;
+}
+
+void RegisterEngine::setSupervisor(const QString& supervisor) {
+    m_supervisor = supervisor;
+}
+
+const std::deque<VoidRecord>& RegisterEngine::voids() const {
+    return m_voids;
+}
+
+bool RegisterEngine::restore(const std::vector<JournalEntry>& entries) {
+    if (entries.empty()) return false;
+
+    uint64_t saleId = 0;
+    for (const auto& entry : entries) {
+        if (entry.op == JournalOp::SaleId) saleId = entry.saleId;
+    }
+    if (saleId != 0 && m_ledger && saleId == m_ledger->lastSaleId()) {
+        if (m_journal) m_journal->logApprove();
+        startSale();
+        return false;
+    }
+
+    m_receipt.setJournal(nullptr);
+    {
+        Receipt::UpdateScope scope(m_receipt);
+        for (const auto& entry : entries) {
+            switch (entry.op) {
+            case JournalOp::AddItem: m_receipt.addItem(entry.item); break;
+            case JournalOp::AppendItem: m_receipt.appendItem(entry.item); break;
+            case JournalOp::RemoveItem: m_receipt.removeItem(entry.row); break;
+            case JournalOp::RemoveItems: m_receipt.removeItems(entry.rows); break;
+            case JournalOp::UpdateQuantity: m_receipt.updateQuantity(entry.row, entry.value); break;
+            case JournalOp::MoveItem: m_receipt.moveItem(entry.row, entry.value); break;
+            case JournalOp::Reset: m_receipt.setItems({}); break;
+            case JournalOp::Tender: m_tendered = entry.amount; break;
+            case JournalOp::Approve:
+            case JournalOp::Decline:
+            case JournalOp::SaleId:
+                break;
+            }
+        }
+    }
+    m_receipt.setJournal(m_journal);
+    if (saleId != 0) m_saleId = saleId;
+    if (m_journal) m_journal->logSaleId(m_saleId);
+    // A journal cut at an approve or decline holds at most resets of the empty
+    // receipt and the next sale id, which restore nothing.
+    return !m_receipt.isEmpty();
+}
+
+Money RegisterEngine::tendered() const {
+    return m_tendered;
+}
+
+PaymentState RegisterEngine::paymentState() const {
+    PaymentState state;
+    state.subtotal = m_receipt.subtotal();
+    state.amountDue = m_receipt.amountDue();
+    state.tendered = m_tendered;
+    state.journalIntact = !m_journal || m_journal->isIntact();
+
+    // A receipt promotions discount to nothing is still approved, with 0.00 due.
+    if (m_receipt.isEmpty() || state.subtotal.amount() == 0) {
+        return state;
+    }
+
+    if (m_tendered < state.amountDue) {
+        if (m_tendered.amount() > 0) {
+            state.change = state.amountDue - m_tendered;
+            state.changeState = ChangeState::Insufficient;
+        }
+    } else {
+        state.change = m_tendered - state.amountDue;
+        state.changeState = ChangeState::Change;
+        state.canApprove = true;
+    }
+    return state;
+}
+
+void RegisterEngine::applyAction(const ActionRecord& record) {
+    switch (record.action) {
+    case MacroAction::Numpad:
+        m_input = numpadInput(m_input, record.argument);
+        break;
+    case MacroAction::Enter:
+        if (record.text.isEmpty()) break;
+        enter(record.text, m_selectedRow);
+        m_input.clear();
+        m_selectedRow = -1;
+        break;
+    case MacroAction::Clear:
+        m_input.clear();
+        m_selectedRow = -1;
+        break;
+    case MacroAction::DeleteItem:
+        if (m_selectedRow >= 0) removeLine(m_selectedRow);
+        m_selectedRow = -1;
+        break;
+    case MacroAction::Approve:
+        approve();
+        break;
+    case MacroAction::Decline:
+        decline();
+        break;
+    case MacroAction::SelectRow:
+        m_selectedRow = m_receipt.isValidRow(record.argument) ? record.argument : -1;
+        break;
+    case MacroAction::Undo:
+        undo();
+        m_selectedRow = -1;
+        break;
+    case MacroAction::Redo:
+        redo();
+        m_selectedRow = -1;
+        break;
+    case MacroAction::Suspend:
+        suspend();
+        break;
+    case MacroAction::Resume:
+        resume(record.argument);
+        break;
+    }
+}
+
+QString RegisterEngine::numpadInput(QString text, int id) {
+    if (id == KeyBackspace) {
+        if (!text.isEmpty()) text.chop(1);
+    }
+    else if (id == KeyPoint) {
+        if (!text.contains(".") && !text.contains(",")) {
+            text += (text.isEmpty() ? "0." : ".");
+        }
+    }
+    else {
+        if (text == "0") text = QString::number(id);
+        else text += QString::number(id);
+    }
+    return text;
+}
+
+void RegisterEngine::resetPayment() {
+    m_tendered = Money(0);
+    m_input.clear();
+    m_selectedRow = -1;
+}
+
+// Journals the cleared tender, so recovery does not apply the last customer's
+// payment to a receipt that was parked or swapped in.
+void RegisterEngine::clearTender() {
+    if (m_tendered.amount() != 0) tender(Money(0));
+}
+
+void RegisterEngine::checkpoint(const ReceiptSnapshot& before) {
+    m_undo.push_back(before);
+    if (static_cast<int>(m_undo.size()) > UndoDepth) m_undo.pop_front();
+    m_redo.clear();
+}
+
+void RegisterEngine::clearHistory() {
+    m_undo.clear();
+    m_redo.clear();
+}
+
+// Ids only have to differ from the ledger's newest sale; starting from the
+// clock keeps them increasing across restarts.
+void RegisterEngine::startSale() {
+    m_saleId = std::max(m_saleId + 1, static_cast<uint64_t>(QDateTime::currentMSecsSinceEpoch()) * 1000);
+    if (m_ledger) m_saleId = std::max(m_saleId, m_ledger->lastSaleId() + 1);
+    if (m_journal) m_journal->logSaleId(m_saleId);
+}
+
+// Called before the void, while the receipt still has what is taken off.
+void RegisterEngine::recordVoid(VoidKind kind, int row) {
+    VoidRecord record;
+    record.kind = kind;
+    record.saleId = m_saleId;
+    record.timestampMs = QDateTime::currentMSecsSinceEpoch();
+    record.supervisor = m_supervisor;
+    record.row = row;
+    if (row >= 0) record.item = m_receipt.getItem(row);
+    record.lineCount = m_receipt.lineCount();
+    record.subtotal = m_receipt.subtotal();
+    record.itemCount = m_receipt.itemCount();
+
+    // The void goes ahead even if the ledger cannot take it.
+    if (m_ledger) m_ledger->appendVoid(record);
+    m_voids.push_back(std::move(record));
+    if (static_cast<int>(m_voids.size()) > VoidHistoryDepth) m_voids.pop_front();
+}
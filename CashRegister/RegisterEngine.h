@@ -0,0 +1,179 @@
+#pragma once
+
+#include <QDateTime>
+#include <QString>
+#include <deque>
+#include <vector>
+#include "money.h"
+#include "Receipt.h"
+#include "ActionMacro.h"
+#include "SalesLedger.h"
+
+class ProductCatalog;
+class PromotionEngine;
+class ReceiptJournal;
+struct JournalEntry;
+
+enum class ChangeState {
+    Neutral,
+    Insufficient,
+    Change
+};
+
+// Everything the payment panel shows, derived from the receipt and the
+// tendered amount.
+struct PaymentState {
+    Money subtotal;
+    Money amountDue;
+    Money tendered;
+    Money change;
+    ChangeState changeState = ChangeState::Neutral;
+    bool canApprove = false;
+    // False while the journal could not rebuild the open receipt after a crash.
+    bool journalIntact = true;
+};
+
+// A receipt parked while the cashier serves the next customer, together with
+// its undo history.
+struct SuspendedReceipt {
+    ReceiptSnapshot receipt;
+    QDateTime suspendedAt;
+    std::deque<ReceiptSnapshot> undo;
+    std::deque<ReceiptSnapshot> redo;
+};
+
+// One register's receipt and payment logic without any UI: the window and
+// headless lanes drive it through the same calls. Catalog, promotions, journal
+// and ledger are borrowed and may be null; an engine is used from one thread
+// at a time, and independent engines share nothing but the read-only catalog.
+class RegisterEngine {
+public:
+    enum class EnterResult {
+        Ignored,
+        QuantityChanged,
+        ItemAdded,
+        UnknownBarcode,
+        // A weighed product scanned by its own code rather than a scale label.
+        WeightRequired,
+        // The line would take the receipt total beyond what Money holds; the
+        // receipt is left as it was.
+        TotalTooLarge,
+        Tendered
+    };
+
+    enum class ApproveResult {
+        Approved,
+        Insufficient,
+        // Nothing to sell; no sale is recorded.
+        Empty,
+        LedgerFailed
+    };
+
+    // Numpad ids beyond the digits 0-9.
+    enum NumpadKey {
+        KeyBackspace = 10,
+        KeyPoint = 11
+    };
+
+    // Undo steps kept per receipt; each costs only the lines it changed.
+    static constexpr int UndoDepth = 100;
+
+    // Recent voids kept for voids(); the ledger, if set, records every one.
+    static constexpr int VoidHistoryDepth = 100;
+
+    RegisterEngine();
+
+    RegisterEngine(const RegisterEngine&) = delete;
+    RegisterEngine& operator=(const RegisterEngine&) = delete;
+
+    void setCatalog(const ProductCatalog* catalog);
+    void setPromotions(PromotionEngine* promotions);
+    void setJournal(ReceiptJournal* journal);
+    void setLedger(SalesLedger* ledger);
+
+    [[nodiscard]] Receipt& receipt();
+    [[nodiscard]] const Receipt& receipt() const;
+
+    // Interprets the cashier's input: a quantity for selectedRow when one is
+    // selected (grams or millilitres on a weighed line), otherwise a barcode
+    // of 8+ digits, otherwise a tendered amount. A scale label
+    // (ProductCatalog::parseScaleLabel) adds the weighed product it encodes.
+    EnterResult enter(const QString& text, int selectedRow = -1);
+    // Adds quantity grams or millilitres of the weighed product barcode, as
+    // read from a scale.
+    EnterResult addWeighed(uint64_t barcode, int quantity);
+    void tender(Money amount);
+    bool removeLine(int row);
+    // Records the sale in the ledger under the open receipt's sale id, which
+    // the journal holds as well, then closes the receipt. LedgerFailed leaves
+    // the receipt open and nothing recorded, so approving again is safe.
+    ApproveResult approve();
+    void decline();
+
+    // Step back and forth through the receipt's line changes: scans, quantity
+    // changes and removed lines. Tendering is not a line change.
+    bool undo();
+    bool redo();
+    [[nodiscard]] bool canUndo() const;
+    [[nodiscard]] bool canRedo() const;
+
+    // Parks the open receipt and starts an empty one; false if it has no lines.
+    // Parked receipts live in memory: after a restart only the open one is
+    // recovered from the journal.
+    bool suspend();
+
+    // Reopens suspended receipt index, parking the open one first if it has
+    // lines, so repeated resume(0) cycles through the queue.
+    bool resume(int index = 0);
+    [[nodiscard]] const std::deque<SuspendedReceipt>& suspendedReceipts() const;
+
+    // The supervisor who authorises voids from now on; every removed line and
+    // declined receipt is recorded with it, in the ledger and in voids().
+    void setSupervisor(const QString& supervisor);
+    [[nodiscard]] const std::deque<VoidRecord>& voids() const;
+
+    // Rebuilds the open receipt from journal entries without journaling them
+    // again. Returns false if no lines came back, or if the ledger
+    // (set beforehand) already holds the receipt's sale: a crash between the
+    // two lost its approve, so it is closed instead of reopened.
+    bool restore(const std::vector<JournalEntry>& entries);
+
+    [[nodiscard]] Money tendered() const;
+    [[nodiscard]] PaymentState paymentState() const;
+
+    // Applies one recorded cashier action, keeping the input line and the
+    // selected row itself; approve and decline are taken as confirmed.
+    void applyAction(const ActionRecord& record);
+
+    // The input line after pressing numpad key id.
+    static QString numpadInput(QString text, int id);
+
+private:
+    EnterResult scan(uint64_t barcode);
+    void resetPayment();
+    void clearTender();
+    void checkpoint(const ReceiptSnapshot& before);
+    void clearHistory();
+    void startSale();
+    void recordVoid(VoidKind kind, int row);
+
+    Receipt m_receipt;
+    const ProductCatalog* m_catalog;
+    ReceiptJournal* m_journal;
+    SalesLedger* m_ledger;
+    Money m_tendered;
+    // The id the open receipt will be recorded under, journaled whenever a
+    // receipt starts so that recovery can ask the ledger whether it was.
+    uint64_t m_saleId;
+
+    // Snapshots before each line change, newest last.
+    std::deque<ReceiptSnapshot> m_undo;
+    std::deque<ReceiptSnapshot> m_redo;
+    std::deque<SuspendedReceipt> m_suspended;
+    std::deque<VoidRecord> m_voids;
+    QString m_supervisor;
+
+    // Headless cashier state used by applyAction().
+    QString m_input;
+    int m_selectedRow;
+};
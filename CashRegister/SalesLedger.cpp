@@ -0,0 +1,517 @@
+#include "SalesLedger.h"
+#include "MoneyKernels.h"
+#include <QDateTime>
+#include <QDir>
+#include <cstddef>
+#include <cstring>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr char SegmentMagic[8] = { 'C', 'R', 'L', 'E', 'D', 'G', 'E', 'R' };
+constexpr uint32_t SegmentVersion = 5;
+constexpr uint32_t ReceiptMagic = 0x53414C45;
+constexpr uint32_t VoidMagic = 0x564F4944;
+
+struct SegmentHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t sequence;
+    int64_t julianDay;
+    int64_t createdMs;
+    uint8_t reserved[32];
+};
+
+struct ReceiptHeader {
+    uint32_t magic;
+    uint32_t lineCount;
+    uint32_t payloadSize;
+    uint32_t checksum;
+    uint64_t receiptNumber;
+    int64_t timestampMs;
+    int64_t gross;
+    int64_t tendered;
+    int64_t change;
+    // Version 3 and later.
+    uint64_t saleId;
+    // Version 4 and later; before it gross had the discount taken off.
+    int64_t discount;
+};
+
+// Version 5 and later: an audited void between the sales, which totals skip.
+// The payload is the supervisor's name and then the voided line, if any.
+struct VoidHeader {
+    uint32_t magic;
+    uint32_t lineCount;
+    uint32_t payloadSize;
+    uint32_t checksum;
+    int64_t timestampMs;
+    uint64_t saleId;
+    // The receipt just before the void.
+    int64_t subtotal;
+    int64_t itemCount;
+    int32_t receiptLines;
+    int32_t row;
+    uint16_t supervisorLength;
+    uint8_t kind;
+    uint8_t reserved[5];
+};
+
+// The fields every record starts with, whatever its kind.
+struct RecordPrefix {
+    uint32_t magic;
+    uint32_t lineCount;
+    uint32_t payloadSize;
+    uint32_t checksum;
+};
+
+// Older receipt headers end before the fields added since, which read as 0.
+size_t receiptHeaderSize(uint32_t version) {
+    if (version >= 4) return sizeof(ReceiptHeader);
+    return version >= 3 ? offsetof(ReceiptHeader, discount) : offsetof(ReceiptHeader, saleId);
+}
+
+// Version 2 split the 32-bit name length to carry the quantity unit; version 1
+// lines read back as pieces.
+struct LineHeader {
+    int64_t price;
+    uint64_t barcode;
+    int32_t quantity;
+    uint16_t nameLength;
+    uint8_t unit;
+    uint8_t reserved;
+};
+
+// Day totals saturate, as the batch kernels that rebuild them do.
+int64_t addSaturated(int64_t total, int64_t amount) {
+    return (SaturatingMoney(total) + SaturatingMoney(amount)).amount();
+}
+
+uint32_t checksum(const char* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ static_cast<uint8_t>(data[i])) * 16777619u;
+    }
+    return hash;
+}
+
+bool syncToDisk(QFile& file) {
+    if (!file.flush()) return false;
+#if defined(Q_OS_WIN)
+    return _commit(file.handle()) == 0;
+#elif defined(Q_OS_LINUX)
+    return ::fdatasync(file.handle()) == 0;
+#else
+    return ::fsync(file.handle()) == 0;
+#endif
+}
+
+// Appends text as UTF-16, padded so that what follows stays 8-byte aligned
+// for mapped readers.
+void appendText(std::vector<char>& payload, const QString& text) {
+    const size_t offset = payload.size();
+    const size_t bytes = static_cast<size_t>(text.size()) * sizeof(char16_t);
+    payload.resize((offset + bytes + 7) & ~size_t(7));
+    std::memcpy(payload.data() + offset, text.utf16(), bytes);
+}
+
+void appendLine(std::vector<char>& payload, const ReceiptItem& item) {
+    const QString name = item.name().left(0xFFFF);
+    LineHeader line{};
+    line.price = item.price().amount();
+    line.barcode = item.barcode();
+    line.quantity = item.quantity();
+    line.nameLength = static_cast<uint16_t>(name.size());
+    line.unit = static_cast<uint8_t>(item.unit());
+
+    const size_t offset = payload.size();
+    payload.resize(offset + sizeof(line));
+    std::memcpy(payload.data() + offset, &line, sizeof(line));
+    appendText(payload, name);
+}
+
+// Reads the line at offset and moves past it; false if it runs off the payload.
+bool readLine(const char* payload, size_t payloadSize, size_t& offset, ReceiptItem& item) {
+    if (offset + sizeof(LineHeader) > payloadSize) return false;
+    LineHeader line;
+    std::memcpy(&line, payload + offset, sizeof(line));
+    const size_t nameBytes = line.nameLength * sizeof(char16_t);
+    if (nameBytes > payloadSize - offset - sizeof(line)) return false;
+
+    const auto* name = reinterpret_cast<const char16_t*>(payload + offset + sizeof(line));
+    item = ReceiptItem(QString::fromUtf16(name, line.nameLength), Money(line.price), line.quantity, line.barcode,
+                       static_cast<QuantityUnit>(line.unit));
+    offset += (sizeof(line) + nameBytes + 7) & ~size_t(7);
+    return true;
+}
+
+// Maps a segment read-only and visits its receipts, and its voids if voided is
+// set, up to the first torn or corrupted record. False if the segment cannot
+// be read at all.
+bool forEachRecord(const QString& path, const std::function<void(const ReceiptHeader&, const char*)>& sale,
+                   const std::function<void(const VoidHeader&, const char*)>& voided = {}) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    const qint64 size = file.size();
+    if (size < static_cast<qint64>(sizeof(SegmentHeader))) return true;
+    const uchar* data = file.map(0, size);
+    if (!data) return false;
+
+    SegmentHeader segment;
+    std::memcpy(&segment, data, sizeof(segment));
+    const size_t saleHeaderSize = receiptHeaderSize(segment.version);
+
+    size_t offset = sizeof(SegmentHeader);
+    const size_t end = static_cast<size_t>(size);
+    while (offset + sizeof(RecordPrefix) <= end) {
+        RecordPrefix prefix;
+        std::memcpy(&prefix, data + offset, sizeof(prefix));
+        size_t headerSize = 0;
+        if (prefix.magic == ReceiptMagic) {
+            headerSize = saleHeaderSize;
+        } else if (prefix.magic == VoidMagic && segment.version >= 5) {
+            headerSize = sizeof(VoidHeader);
+        } else {
+            break;
+        }
+        if (headerSize > end - offset || prefix.payloadSize > end - offset - headerSize) break;
+        const char* payload = reinterpret_cast<const char*>(data + offset + headerSize);
+        if (checksum(payload, prefix.payloadSize) != prefix.checksum) break;
+
+        if (prefix.magic == ReceiptMagic) {
+            ReceiptHeader header{};
+            std::memcpy(&header, data + offset, headerSize);
+            if (sale) sale(header, payload);
+        } else if (voided) {
+            VoidHeader header;
+            std::memcpy(&header, data + offset, headerSize);
+            voided(header, payload);
+        }
+        offset += headerSize + prefix.payloadSize;
+    }
+
+    file.unmap(const_cast<uchar*>(data));
+    return true;
+}
+
+// The sale id of the last receipt in the newest non-empty segment of paths.
+uint64_t newestSaleId(const QStringList& paths) {
+    for (auto path = paths.crbegin(); path != paths.crend(); ++path) {
+        bool found = false;
+        uint64_t saleId = 0;
+        forEachRecord(*path, [&](const ReceiptHeader& header, const char*) {
+            found = true;
+            saleId = header.saleId;
+        });
+        if (found) return saleId;
+    }
+    return 0;
+}
+
+}
+
+SalesLedger::SalesLedger(qint64 maxSegmentBytes)
+    : m_maxSegmentBytes(maxSegmentBytes), m_segmentSequence(0), m_lastSaleId(0), m_sync(true) {}
+
+SalesLedger::~SalesLedger() {
+    close();
+}
+
+bool SalesLedger::open(const QString& directory, bool sync) {
+    close();
+    if (!QDir().mkpath(directory)) return false;
+    m_directory = directory;
+    m_sync = sync;
+    m_lastSaleId = newestSaleId(segmentPaths(QString("sales-*.seg")));
+    return loadTotals(QDate::currentDate());
+}
+
+void SalesLedger::close() {
+    m_segment.close();
+    m_totalsFile.close();
+    m_segmentDate = QDate();
+    m_segmentSequence = 0;
+    m_lastSaleId = 0;
+    m_directory.clear();
+}
+
+bool SalesLedger::isOpen() const {
+    return !m_directory.isEmpty();
+}
+
+QString SalesLedger::segmentPath(const QDate& date, int sequence) const {
+    return QDir(m_directory).filePath(QString("sales-%1-%2.seg")
+        .arg(date.toString("yyyyMMdd"))
+        .arg(sequence, 4, 10, QChar('0')));
+}
+
+QString SalesLedger::totalsPath(const QDate& date) const {
+    return QDir(m_directory).filePath(QString("totals-%1.bin").arg(date.toString("yyyyMMdd")));
+}
+
+QStringList SalesLedger::segmentPaths(const QDate& date) const {
+    return segmentPaths(QString("sales-%1-*.seg").arg(date.toString("yyyyMMdd")));
+}
+
+// Segment names sort by day and then sequence, so paths come oldest first.
+QStringList SalesLedger::segmentPaths(const QString& pattern) const {
+    QStringList paths;
+    for (const QString& name : QDir(m_directory).entryList(QStringList() << pattern, QDir::Files, QDir::Name)) {
+        paths << QDir(m_directory).filePath(name);
+    }
+    return paths;
+}
+
+bool SalesLedger::rollSegment(const QDate& date) {
+    m_segment.close();
+
+    if (date != m_segmentDate) {
+        m_segmentDate = date;
+        m_segmentSequence = static_cast<int>(segmentPaths(date).size());
+    }
+
+    m_segment.setFileName(segmentPath(date, ++m_segmentSequence));
+    if (!m_segment.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+
+    SegmentHeader header{};
+    std::memcpy(header.magic, SegmentMagic, sizeof(SegmentMagic));
+    header.version = SegmentVersion;
+    header.sequence = static_cast<uint32_t>(m_segmentSequence);
+    header.julianDay = date.toJulianDay();
+    header.createdMs = QDateTime::currentMSecsSinceEpoch();
+    return m_segment.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header);
+}
+
+// A sidecar counts only if it ends at the day's newest sale: one that missed
+// an update, or comes from before sale ids, is rebuilt from the segments.
+bool SalesLedger::readTotals(const QDate& date, QFile& file, DailyTotals& totals) const {
+    return file.read(reinterpret_cast<char*>(&totals), sizeof(totals)) == sizeof(totals)
+        && totals.julianDay == date.toJulianDay()
+        && totals.lastSaleId == newestSaleId(segmentPaths(date));
+}
+
+bool SalesLedger::loadTotals(const QDate& date) {
+    m_totalsFile.close();
+    m_totalsFile.setFileName(totalsPath(date));
+    if (!m_totalsFile.open(QIODevice::ReadWrite)) return false;
+
+    DailyTotals totals;
+    if (readTotals(date, m_totalsFile, totals)) {
+        m_today = totals;
+        return true;
+    }
+
+    m_today = recomputeDailyTotals(date);
+    return storeTotals();
+}
+
+bool SalesLedger::storeTotals() {
+    return m_totalsFile.seek(0)
+        && m_totalsFile.write(reinterpret_cast<const char*>(&m_today), sizeof(m_today)) == sizeof(m_today)
+        && commit(m_totalsFile);
+}
+
+// Mapped readers see flushed data either way; only syncing makes it durable.
+bool SalesLedger::commit(QFile& file) {
+    return m_sync ? syncToDisk(file) : file.flush();
+}
+
+bool SalesLedger::appendSale(const std::vector<ReceiptItem>& items, Money tendered, Money discount,
+                             RoundingMode weightRounding, uint64_t saleId) {
+    if (!isOpen()) return false;
+
+    const QDate today = QDate::currentDate();
+    if (m_today.julianDay != today.toJulianDay() && !loadTotals(today)) return false;
+
+    std::vector<char> payload;
+    ReceiptHeader header{};
+    Money gross(0);
+    uint64_t itemCount = 0;
+    for (const auto& item : items) {
+        appendLine(payload, item);
+        gross += item.total(weightRounding);
+        itemCount += static_cast<uint64_t>(item.itemCount());
+    }
+
+    header.magic = ReceiptMagic;
+    header.lineCount = static_cast<uint32_t>(items.size());
+    header.payloadSize = static_cast<uint32_t>(payload.size());
+    header.checksum = checksum(payload.data(), payload.size());
+    header.receiptNumber = m_today.receiptCount + 1;
+    header.timestampMs = QDateTime::currentMSecsSinceEpoch();
+    header.gross = gross.amount();
+    header.discount = discount.amount();
+    header.tendered = tendered.amount();
+    header.change = (tendered - (gross - discount)).amount();
+    header.saleId = saleId;
+
+    if (!writeRecord(today, reinterpret_cast<const char*>(&header), sizeof(header), payload)) return false;
+
+    m_lastSaleId = saleId;
+    m_today.receiptCount += 1;
+    m_today.itemCount += itemCount;
+    m_today.gross = addSaturated(m_today.gross, header.gross);
+    m_today.discount = addSaturated(m_today.discount, header.discount);
+    m_today.tendered = addSaturated(m_today.tendered, header.tendered);
+    m_today.change = addSaturated(m_today.change, header.change);
+    m_today.lastSaleId = saleId;
+    // The sale is recorded now; a sidecar that misses it is stale against the
+    // segments and rebuilt when the ledger is next opened.
+    storeTotals();
+    return true;
+}
+
+bool SalesLedger::appendVoid(const VoidRecord& record) {
+    if (!isOpen()) return false;
+
+    std::vector<char> payload;
+    const QString supervisor = record.supervisor.left(0xFFFF);
+    appendText(payload, supervisor);
+    if (record.row >= 0) appendLine(payload, record.item);
+
+    VoidHeader header{};
+    header.magic = VoidMagic;
+    header.lineCount = record.row >= 0 ? 1 : 0;
+    header.payloadSize = static_cast<uint32_t>(payload.size());
+    header.checksum = checksum(payload.data(), payload.size());
+    header.timestampMs = record.timestampMs;
+    header.saleId = record.saleId;
+    header.subtotal = record.subtotal.amount();
+    header.itemCount = record.itemCount;
+    header.receiptLines = record.lineCount;
+    header.row = record.row;
+    header.supervisorLength = static_cast<uint16_t>(supervisor.size());
+    header.kind = static_cast<uint8_t>(record.kind);
+    return writeRecord(QDate::currentDate(), reinterpret_cast<const char*>(&header), sizeof(header), payload);
+}
+
+// A failed write is cut off again, so a retry does not follow a torn record
+// that would hide it from readers, nor store the record twice.
+bool SalesLedger::writeRecord(const QDate& date, const char* header, size_t headerSize,
+                              const std::vector<char>& payload) {
+    const qint64 recordSize = static_cast<qint64>(headerSize + payload.size());
+    if (!m_segment.isOpen() || date != m_segmentDate || m_segment.size() + recordSize > m_maxSegmentBytes) {
+        if (!rollSegment(date)) return false;
+    }
+
+    const qint64 start = m_segment.pos();
+    if (m_segment.write(header, static_cast<qint64>(headerSize)) != static_cast<qint64>(headerSize)
+        || (!payload.empty() && m_segment.write(payload.data(), static_cast<qint64>(payload.size())) != static_cast<qint64>(payload.size()))
+        || !commit(m_segment)) {
+        m_segment.resize(start);
+        m_segment.seek(start);
+        return false;
+    }
+    return true;
+}
+
+uint64_t SalesLedger::lastSaleId() const {
+    return m_lastSaleId;
+}
+
+DailyTotals SalesLedger::dailyTotals(const QDate& date) const {
+    if (date.toJulianDay() == m_today.julianDay) return m_today;
+
+    QFile file(totalsPath(date));
+    DailyTotals totals;
+    if (file.open(QIODevice::ReadOnly) && readTotals(date, file, totals)) return totals;
+    return recomputeDailyTotals(date);
+}
+
+bool SalesLedger::forEachSale(const QDate& date, const std::function<void(const LedgerSale&)>& visitor) const {
+    for (const QString& path : segmentPaths(date)) {
+        const bool readable = forEachRecord(path, [&visitor](const ReceiptHeader& header, const char* payload) {
+            LedgerSale sale;
+            sale.receiptNumber = header.receiptNumber;
+            sale.saleId = header.saleId;
+            sale.timestampMs = header.timestampMs;
+            sale.gross = Money(header.gross);
+            sale.discount = Money(header.discount);
+            sale.tendered = Money(header.tendered);
+            sale.change = Money(header.change);
+            sale.items.reserve(header.lineCount);
+
+            size_t lineOffset = 0;
+            ReceiptItem item;
+            for (uint32_t i = 0; i < header.lineCount && readLine(payload, header.payloadSize, lineOffset, item); ++i) {
+                sale.items.push_back(item);
+            }
+
+            visitor(sale);
+        });
+        if (!readable) return false;
+    }
+    return true;
+}
+
+bool SalesLedger::forEachVoid(const QDate& date, const std::function<void(const VoidRecord&)>& visitor) const {
+    for (const QString& path : segmentPaths(date)) {
+        const bool readable = forEachRecord(path, nullptr, [&visitor](const VoidHeader& header, const char* payload) {
+            const size_t supervisorBytes = header.supervisorLength * sizeof(char16_t);
+            if (supervisorBytes > header.payloadSize) return;
+
+            VoidRecord record;
+            record.kind = static_cast<VoidKind>(header.kind);
+            record.saleId = header.saleId;
+            record.timestampMs = header.timestampMs;
+            record.supervisor = QString::fromUtf16(reinterpret_cast<const char16_t*>(payload), header.supervisorLength);
+            record.lineCount = header.receiptLines;
+            record.subtotal = Money(header.subtotal);
+            record.itemCount = header.itemCount;
+
+            size_t lineOffset = (supervisorBytes + 7) & ~size_t(7);
+            if (header.lineCount > 0 && readLine(payload, header.payloadSize, lineOffset, record.item)) {
+                record.row = header.row;
+            }
+            visitor(record);
+        });
+        if (!readable) return false;
+    }
+    return true;
+}
+
+DailyTotals SalesLedger::recomputeDailyTotals(const QDate& date) const {
+    // Gathered into columns first so the sums run through the batch kernels.
+    std::vector<int64_t> gross;
+    std::vector<int64_t> discount;
+    std::vector<int64_t> tendered;
+    std::vector<int64_t> change;
+    std::vector<int64_t> items;
+    uint64_t lastSaleId = 0;
+    forEachSale(date, [&](const LedgerSale& sale) {
+        int64_t quantity = 0;
+        for (const auto& item : sale.items) {
+            quantity += item.itemCount();
+        }
+        gross.push_back(sale.gross.amount());
+        discount.push_back(sale.discount.amount());
+        tendered.push_back(sale.tendered.amount());
+        change.push_back(sale.change.amount());
+        items.push_back(quantity);
+        lastSaleId = sale.saleId;
+    });
+
+    DailyTotals totals;
+    totals.julianDay = date.toJulianDay();
+    totals.receiptCount = gross.size();
+    totals.lastSaleId = lastSaleId;
+
+    int64_t itemCount = 0;
+    bool exact = MoneyKernels::sum(items.data(), items.size(), itemCount);
+    totals.itemCount = static_cast<uint64_t>(itemCount);
+    exact = MoneyKernels::sum(gross.data(), gross.size(), totals.gross) && exact;
+    exact = MoneyKernels::sum(discount.data(), discount.size(), totals.discount) && exact;
+    exact = MoneyKernels::sum(tendered.data(), tendered.size(), totals.tendered) && exact;
+    exact = MoneyKernels::sum(change.data(), change.size(), totals.change) && exact;
+    if (!exact) {
+        qWarning("Sales ledger totals for %s exceed the kopeck range and are saturated",
+                 qPrintable(date.toString("yyyy-MM-dd")));
+    }
+    return totals;
+}
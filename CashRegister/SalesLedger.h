@@ -0,0 +1,128 @@
+#pragma once
+
+#include <QDate>
+#include <QFile>
+#include <QString>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "money.h"
+#include "Receipt.h"
+
+struct DailyTotals {
+    int64_t julianDay = 0;
+    uint64_t receiptCount = 0;
+    uint64_t itemCount = 0;
+    // Line totals; the amount paid for them is gross - discount.
+    int64_t gross = 0;
+    int64_t discount = 0;
+    int64_t tendered = 0;
+    int64_t change = 0;
+    // The day's newest sale, which the sidecar is checked against on open.
+    uint64_t lastSaleId = 0;
+};
+
+struct LedgerSale {
+    uint64_t receiptNumber = 0;
+    uint64_t saleId = 0;
+    int64_t timestampMs = 0;
+    Money gross;
+    Money discount;
+    Money tendered;
+    Money change;
+    std::vector<ReceiptItem> items;
+};
+
+enum class VoidKind {
+    Line,
+    Receipt
+};
+
+// An audited void: the line or receipt taken off, who authorised it and the
+// receipt's totals just before. Plain data, so keeping one holds on to none
+// of the receipt's memory.
+struct VoidRecord {
+    VoidKind kind = VoidKind::Line;
+    uint64_t saleId = 0;
+    int64_t timestampMs = 0;
+    QString supervisor;
+    // The voided line's row and contents; -1 and empty for a whole receipt.
+    int row = -1;
+    ReceiptItem item;
+    int lineCount = 0;
+    Money subtotal;
+    int64_t itemCount = 0;
+};
+
+// Append-only store of approved receipts and audited voids. Both go into size-
+// and day-bounded segment files (fixed header, fixed record header,
+// variable-length lines) that are never modified once rolled over, so readers
+// can map them read-only.
+// Each day's totals are kept in a small sidecar file updated with every sale
+// and rebuilt from the segments when it does not end at the day's newest sale.
+class SalesLedger {
+public:
+    static constexpr qint64 DefaultSegmentBytes = 16 * 1024 * 1024;
+
+    explicit SalesLedger(qint64 maxSegmentBytes = DefaultSegmentBytes);
+    ~SalesLedger();
+
+    SalesLedger(const SalesLedger&) = delete;
+    SalesLedger& operator=(const SalesLedger&) = delete;
+
+    // With sync false records and totals are written but never synced, so a
+    // power cut may lose them. Meant for load tests.
+    bool open(const QString& directory, bool sync = true);
+    void close();
+    [[nodiscard]] bool isOpen() const;
+
+    // The stored gross is the sum of line totals, with the promotions' discount
+    // beside it; weightRounding must match the receipt's so that gross less
+    // discount is the amount the customer paid. saleId is
+    // stored with the sale so a register can tell after a crash whether it was
+    // recorded (see lastSaleId()). Returns true once the sale is on disk, even
+    // if the sidecar could not be updated; a failed write leaves no trace.
+    bool appendSale(const std::vector<ReceiptItem>& items, Money tendered, Money discount = Money(0),
+                    RoundingMode weightRounding = RoundingMode::HalfUp, uint64_t saleId = 0);
+
+    // Records a void between the sales; totals do not count it. Returns true
+    // once it is on disk.
+    bool appendVoid(const VoidRecord& record);
+
+    // The id of the newest recorded sale, 0 if there is none or it has none.
+    [[nodiscard]] uint64_t lastSaleId() const;
+
+    [[nodiscard]] DailyTotals dailyTotals(const QDate& date) const;
+
+    // Maps every segment of the given day read-only and visits its sales.
+    bool forEachSale(const QDate& date, const std::function<void(const LedgerSale&)>& visitor) const;
+
+    // Visits the given day's voids, oldest first.
+    bool forEachVoid(const QDate& date, const std::function<void(const VoidRecord&)>& visitor) const;
+
+    // Rebuilds a day's totals by scanning its segments; used when the sidecar
+    // is missing or damaged.
+    [[nodiscard]] DailyTotals recomputeDailyTotals(const QDate& date) const;
+
+private:
+    [[nodiscard]] QString segmentPath(const QDate& date, int sequence) const;
+    [[nodiscard]] QString totalsPath(const QDate& date) const;
+    [[nodiscard]] QStringList segmentPaths(const QDate& date) const;
+    [[nodiscard]] QStringList segmentPaths(const QString& pattern) const;
+    [[nodiscard]] bool readTotals(const QDate& date, QFile& file, DailyTotals& totals) const;
+    bool rollSegment(const QDate& date);
+    bool writeRecord(const QDate& date, const char* header, size_t headerSize, const std::vector<char>& payload);
+    bool loadTotals(const QDate& date);
+    bool storeTotals();
+    bool commit(QFile& file);
+
+    QString m_directory;
+    qint64 m_maxSegmentBytes;
+    QFile m_segment;
+    QFile m_totalsFile;
+    QDate m_segmentDate;
+    int m_segmentSequence;
+    DailyTotals m_today;
+    uint64_t m_lastSaleId;
+    bool m_sync;
+};
@@ -0,0 +1,48 @@
+#include "SpscByteRing.h"
+#include <algorithm>
+#include <cstring>
+
+SpscByteRing::SpscByteRing(size_t capacityPow2)
+    : m_buffer(capacityPow2), m_mask(capacityPow2 - 1) {}
+
+bool SpscByteRing::tryPush(const void* first, size_t firstSize, const void* second, size_t secondSize) {
+    const size_t size = firstSize + secondSize;
+    const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+    const uint64_t head = m_head.load(std::memory_order_acquire);
+    if (size > m_buffer.size() - static_cast<size_t>(tail - head)) return false;
+
+    copyIn(tail, first, firstSize);
+    if (secondSize > 0) copyIn(tail + firstSize, second, secondSize);
+    m_tail.store(tail + size, std::memory_order_release);
+    return true;
+}
+
+size_t SpscByteRing::drain(std::vector<char>& out) {
+    const uint64_t head = m_head.load(std::memory_order_relaxed);
+    const uint64_t tail = m_tail.load(std::memory_order_acquire);
+    const size_t size = static_cast<size_t>(tail - head);
+    if (size == 0) return 0;
+
+    const size_t offset = static_cast<size_t>(head & m_mask);
+    const size_t firstPart = std::min(size, m_buffer.size() - offset);
+    out.insert(out.end(), m_buffer.data() + offset, m_buffer.data() + offset + firstPart);
+    out.insert(out.end(), m_buffer.data(), m_buffer.data() + (size - firstPart));
+
+    m_head.store(tail, std::memory_order_release);
+    return size;
+}
+
+size_t SpscByteRing::available() const {
+    return static_cast<size_t>(m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire));
+}
+
+size_t SpscByteRing::capacity() const {
+    return m_buffer.size();
+}
+
+void SpscByteRing::copyIn(uint64_t position, const void* data, size_t size) {
+    const size_t offset = static_cast<size_t>(position & m_mask);
+    const size_t firstPart = std::min(size, m_buffer.size() - offset);
+    std::memcpy(m_buffer.data() + offset, data, firstPart);
+    std::memcpy(m_buffer.data(), static_cast<const char*>(data) + firstPart, size - firstPart);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Lock-free single-producer/single-consumer byte ring. A push publishes a whole
+// record at once, so the consumer always drains complete records.
+class SpscByteRing {
+public:
+    explicit SpscByteRing(size_t capacityPow2);
+
+    SpscByteRing(const SpscByteRing&) = delete;
+    SpscByteRing& operator=(const SpscByteRing&) = delete;
+
+    // Producer side. Fails without blocking when the ring lacks space.
+    bool tryPush(const void* first, size_t firstSize, const void* second = nullptr, size_t secondSize = 0);
+
+    // Consumer side. Appends everything published so far to out.
+    size_t drain(std::vector<char>& out);
+
+    [[nodiscard]] size_t available() const;
+    [[nodiscard]] size_t capacity() const;
+
+private:
+    void copyIn(uint64_t position, const void* data, size_t size);
+
+    std::vector<char> m_buffer;
+    const size_t m_mask;
+    alignas(64) std::atomic<uint64_t> m_head{0};
+    alignas(64) std::atomic<uint64_t> m_tail{0};
+};
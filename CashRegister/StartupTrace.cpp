@@ -0,0 +1,110 @@
+#include "StartupTrace.h"
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QTextStream>
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    int64_t start;
+    // -1 for an instant.
+    int64_t duration;
+};
+
+struct TraceState {
+    QString filePath;
+    QElapsedTimer clock;
+    std::vector<TraceEvent> events;
+    bool enabled = false;
+};
+
+TraceState& state() {
+    static TraceState trace;
+    return trace;
+}
+
+}
+
+void StartupTrace::begin(const QString& filePath) {
+    TraceState& trace = state();
+    if (filePath.isEmpty() || trace.enabled) return;
+    trace.filePath = filePath;
+    trace.events.reserve(32);
+    trace.clock.start();
+    trace.enabled = true;
+}
+
+bool StartupTrace::isEnabled() {
+    return state().enabled;
+}
+
+int64_t StartupTrace::elapsed() {
+    const TraceState& trace = state();
+    return trace.enabled ? trace.clock.nsecsElapsed() : 0;
+}
+
+void StartupTrace::mark(const char* name) {
+    if (isEnabled()) record(name, elapsed(), -1);
+}
+
+void StartupTrace::record(const char* name, int64_t start, int64_t duration) {
+    state().events.push_back({ name, start, duration });
+}
+
+// Phases are written as complete ("X") events and marks as global instants,
+// all on one thread, with timestamps in microseconds as the format requires.
+bool StartupTrace::finish() {
+    TraceState& trace = state();
+    if (!trace.enabled) return false;
+    trace.enabled = false;
+
+    // Phases are recorded when they end; list everything by when it began.
+    std::stable_sort(trace.events.begin(), trace.events.end(), [](const TraceEvent& a, const TraceEvent& b) {
+        return a.start < b.start;
+    });
+
+    QJsonArray events;
+    QTextStream out(stderr);
+    for (const TraceEvent& event : trace.events) {
+        const QString name = QString::fromLatin1(event.name);
+        QJsonObject json;
+        json["name"] = name;
+        json["ts"] = static_cast<double>(event.start) / 1000.0;
+        json["pid"] = 1;
+        json["tid"] = 1;
+        if (event.duration < 0) {
+            json["ph"] = "i";
+            json["s"] = "g";
+            out << QString("startup: %1 at %2 ms\n").arg(name).arg(event.start / 1e6, 0, 'f', 2);
+        } else {
+            json["ph"] = "X";
+            json["dur"] = static_cast<double>(event.duration) / 1000.0;
+            out << QString("startup: %1 %2 ms\n").arg(name).arg(event.duration / 1e6, 0, 'f', 2);
+        }
+        events.append(json);
+    }
+
+    QJsonObject root;
+    root["traceEvents"] = events;
+    root["displayTimeUnit"] = "ms";
+
+    QSaveFile file(trace.filePath);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+StartupTrace::Phase::Phase(const char* name)
+    : m_name(name), m_start(StartupTrace::isEnabled() ? StartupTrace::elapsed() : -1) {}
+
+StartupTrace::Phase::~Phase() {
+    if (m_start >= 0 && StartupTrace::isEnabled()) {
+        StartupTrace::record(m_name, m_start, StartupTrace::elapsed() - m_start);
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QString>
+#include <cstdint>
+
+// Timeline of the register's start-up, from main() to the first painted frame
+// and the first idle turn of the event loop. Tracing is off unless begin() is
+// given a path, and every call is then a single branch. finish() writes the
+// timeline in Chrome's trace event format (chrome://tracing, Perfetto) and a
+// one-line-per-phase summary to stderr.
+//
+// Start-up is single-threaded, so the trace is only used from the GUI thread.
+class StartupTrace {
+public:
+    static void begin(const QString& filePath);
+    [[nodiscard]] static bool isEnabled();
+
+    // Nanoseconds since begin().
+    [[nodiscard]] static int64_t elapsed();
+
+    // An instant in the timeline, e.g. "firstPaint".
+    static void mark(const char* name);
+
+    // Writes the timeline once; later calls do nothing.
+    static bool finish();
+
+    // Records the enclosing block as a named phase.
+    class Phase {
+    public:
+        explicit Phase(const char* name);
+        ~Phase();
+
+        Phase(const Phase&) = delete;
+        Phase& operator=(const Phase&) = delete;
+
+    private:
+        const char* m_name;
+        int64_t m_start;
+    };
+
+private:
+    static void record(const char* name, int64_t start, int64_t duration);
+};
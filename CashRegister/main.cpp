@@ -1,10 +1,138 @@
 #include "CashRegisterWindow.h"
+#include "LaneHost.h"
+#include "StartupTrace.h"
 #include <QtWidgets/QApplication>
+#include <QDir>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// Replays a semantic macro into an offscreen window at full speed and prints
+// throughput plus per-action latency. Journal and ledger go to a scratch
+// directory unless explicitly configured, so runs never touch real sales.
+int runHeadlessReplay(const QString& macroPath, int repeat) {
+    std::vector<ActionRecord> records;
+    if (!loadActionMacro(macroPath, records)) {
+        QTextStream(stderr) << "Cannot read action macro " << macroPath << "\n";
+        return 1;
+    }
+
+    QTemporaryDir scratch;
+    if (!qEnvironmentVariableIsSet("CASHREGISTER_JOURNAL")) {
+        qputenv("CASHREGISTER_JOURNAL", scratch.filePath("receipt.journal").toLocal8Bit());
+    }
+    if (!qEnvironmentVariableIsSet("CASHREGISTER_LEDGER")) {
+        qputenv("CASHREGISTER_LEDGER", scratch.filePath("ledger").toLocal8Bit());
+    }
+
+    CashRegisterWindow window;
+    window.setConfirmationsEnabled(false);
+    window.show();
+
+    const ActionReplayReport report = replayActions(records, repeat, [&window](const ActionRecord& record) {
+        window.applyAction(record);
+    });
+    QTextStream(stdout) << report.toText();
+    return 0;
+}
+
+// Replays the macro on every lane of a simulated multi-lane store at once, as
+// a stress test of the headless engine; each lane journals and records its
+// sales in its own scratch directory, as storage allows.
+int runLanes(const QString& macroPath, int repeat, int lanes, int threads, LaneHost::Storage storage) {
+    std::vector<ActionRecord> records;
+    if (!loadActionMacro(macroPath, records)) {
+        QTextStream(stderr) << "Cannot read action macro " << macroPath << "\n";
+        return 1;
+    }
+
+    QString catalogPath = qEnvironmentVariable("CASHREGISTER_CATALOG");
+    if (catalogPath.isEmpty()) {
+        catalogPath = QDir(QCoreApplication::applicationDirPath()).filePath("catalog.bin");
+    }
+    ProductCatalog catalog;
+    catalog.open(catalogPath);
+
+    PromotionEngine promotions;
+    const QString promotionsPath = qEnvironmentVariable("CASHREGISTER_PROMOTIONS");
+    QString error;
+    if (!promotionsPath.isEmpty() && !promotions.load(promotionsPath, &error)) {
+        QTextStream(stderr) << "Promotions: " << error << "\n";
+    }
+
+    QTemporaryDir scratch;
+    LaneHost host(lanes, &catalog, &promotions);
+    host.setThreadCount(threads);
+    if (!host.open(scratch.path(), storage)) {
+        QTextStream(stderr) << "Cannot open lane journals in " << scratch.path() << "\n";
+        return 1;
+    }
+
+    const ActionReplayReport report = host.run(records, repeat);
+    static const char* const storageNames[] = { "durable", "nosync", "memory" };
+    QTextStream(stdout) << QString("lanes: %1, threads: %2, storage: %3\n")
+                               .arg(host.laneCount()).arg(host.threadCount())
+                               .arg(storageNames[static_cast<int>(storage)])
+                        << report.toText();
+    return 0;
+}
+
+}
 
 int main(int argc, char *argv[])
 {
+    // CashRegister --replay actions.cra [--repeat N]
+    //              [--lanes N [--threads N] [--storage durable|nosync|memory]]
+    // CashRegister --trace-startup startup.json
+    const char* replayPath = nullptr;
+    const char* tracePath = nullptr;
+    int repeat = 1;
+    int lanes = 0;
+    int threads = 0;
+    LaneHost::Storage storage = LaneHost::Storage::Durable;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::strcmp(argv[i], "--replay") == 0) replayPath = argv[++i];
+        else if (std::strcmp(argv[i], "--repeat") == 0) repeat = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--lanes") == 0) lanes = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--threads") == 0) threads = std::max(0, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--trace-startup") == 0) tracePath = argv[++i];
+        else if (std::strcmp(argv[i], "--storage") == 0) {
+            ++i;
+            if (std::strcmp(argv[i], "nosync") == 0) storage = LaneHost::Storage::NoSync;
+            else if (std::strcmp(argv[i], "memory") == 0) storage = LaneHost::Storage::Memory;
+        }
+    }
+
+    // The timeline runs from here to the first idle event loop after the
+    // window is painted; CASHREGISTER_STARTUP_TRACE enables it as well.
+    if (!replayPath) {
+        StartupTrace::begin(tracePath ? QString::fromLocal8Bit(tracePath)
+                                      : qEnvironmentVariable("CASHREGISTER_STARTUP_TRACE"));
+    }
+
+    // Lanes are headless and need no GUI at all.
+    if (replayPath && lanes > 0) {
+        QCoreApplication app(argc, argv);
+        return runLanes(QString::fromLocal8Bit(replayPath), repeat, lanes, threads, storage);
+    }
+
+    if (replayPath && !qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
     QApplication app(argc, argv);
+    StartupTrace::mark("QApplication");
+    if (replayPath) {
+        return runHeadlessReplay(QString::fromLocal8Bit(replayPath), repeat);
+    }
+
     CashRegisterWindow window;
+    StartupTrace::mark("windowBuilt");
     window.show();
+    StartupTrace::mark("shown");
     return app.exec();
 }
@@ -1,90 +1,57 @@
 #include "money.h"
-#include <cmath>
-
-Money::Money(int64_t amountInKopecks)
-    : m_amount(amountInKopecks) {}
-
-int64_t Money::amount() const {
-    return m_amount;
-}
-
-Money Money::operator+(const Money& other) const {
-    return Money(m_amount + other.m_amount);
-}
-
-Money Money::operator-(const Money& other) const {
-    return Money(m_amount - other.m_amount);
-}
-
-Money& Money::operator+=(const Money& other) {
-    m_amount += other.m_amount;
-    return *this;
-}
-
-Money& Money::operator-=(const Money& other) {
-    m_amount -= other.m_amount;
-    return *this;
-}
-
-bool Money::operator==(const Money& other) const {
-    return m_amount == other.m_amount;
-}
-
-bool Money::operator!=(const Money& other) const {
-    return m_amount != other.m_amount;
-}
-
-bool Money::operator<(const Money& other) const {
-    return m_amount < other.m_amount;
-}
-
-bool Money::operator<=(const Money& other) const {
-    return m_amount <= other.m_amount;
-}
-
-bool Money::operator>(const Money& other) const {
-    return m_amount > other.m_amount;
-}
-
-bool Money::operator>=(const Money& other) const {
-    return m_amount >= other.m_amount;
-}
-
-QString Money::toString() const {
-    double displayAmount = static_cast<double>(m_amount) / 100.0;
-    return QString::number(displayAmount, 'f', 2) + " ₴";
-}
-
-Money Money::fromString(const QString& str) {
-    QString cleanStr = str;
-    cleanStr.replace(',', '.');
-    bool ok = false;
-    double val = cleanStr.toDouble(&ok);
-    if (!ok) return Money(0);
-    return Money(static_cast<int64_t>(std::round(val * 100.0)));
-}
-
-Money operator"" _UAH(long double amount) {
-    int64_t kopecks = static_cast<int64_t>(std::round(amount * 100.0));
-    return Money(kopecks);
-}
-
-Money operator"" _UAH(unsigned long long amountInKopecks) {
-    return Money(static_cast<int64_t>(amountInKopecks));
-}
-
-Money Money::operator*(int multiplier) const {
-    return Money(m_amount * multiplier);
-}
-
-Money Money::operator*(double multiplier) const {
-    return Money(static_cast<int64_t>(std::round(m_amount * multiplier)));
-}
-
-Money operator*(int multiplier, const Money& money) {
-    return money * multiplier;
-}
-
-Money operator*(double multiplier, const Money& money) {
-    return money * multiplier;
+#include <QLocale>
+
+MoneyFormat MoneyFormat::fromLocale(const QLocale& locale) {
+    MoneyFormat fmt;
+    const QString decimal = locale.decimalPoint();
+    const QString group = locale.groupSeparator();
+    if (decimal.size() == 1) fmt.decimalSeparator = decimal.at(0).unicode();
+    if (group.size() == 1) fmt.groupSeparator = group.at(0).unicode();
+    return fmt;
+}
+
+int MoneyDetail::format(int64_t amount, char16_t* buffer, int capacity, const MoneyFormat& fmt) {
+    // Digits are produced right to left into a scratch buffer; uint64_t keeps
+    // INT64_MIN representable.
+    char16_t scratch[Money::MaxFormattedLength];
+    int pos = Money::MaxFormattedLength;
+
+    const bool negative = amount < 0;
+    uint64_t value = negative ? 0 - static_cast<uint64_t>(amount) : static_cast<uint64_t>(amount);
+
+    scratch[--pos] = static_cast<char16_t>(u'0' + value % 10);
+    value /= 10;
+    scratch[--pos] = static_cast<char16_t>(u'0' + value % 10);
+    value /= 10;
+    scratch[--pos] = fmt.decimalSeparator;
+
+    int digits = 0;
+    do {
+        if (fmt.groupSeparator != 0 && digits > 0 && digits % 3 == 0) {
+            scratch[--pos] = fmt.groupSeparator;
+        }
+        scratch[--pos] = static_cast<char16_t>(u'0' + value % 10);
+        value /= 10;
+        ++digits;
+    } while (value != 0);
+
+    if (negative) scratch[--pos] = u'-';
+
+    const int numberLength = Money::MaxFormattedLength - pos;
+    int suffixLength = 0;
+    if (fmt.suffix) {
+        while (fmt.suffix[suffixLength] != 0) ++suffixLength;
+    }
+
+    if (numberLength + suffixLength > capacity) return 0;
+
+    for (int i = 0; i < numberLength; ++i) buffer[i] = scratch[pos + i];
+    for (int i = 0; i < suffixLength; ++i) buffer[numberLength + i] = fmt.suffix[i];
+    return numberLength + suffixLength;
+}
+
+QString MoneyDetail::toString(int64_t amount, const MoneyFormat& fmt) {
+    char16_t buffer[Money::MaxFormattedLength];
+    const int length = format(amount, buffer, Money::MaxFormattedLength, fmt);
+    return QString(reinterpret_cast<const QChar*>(buffer), length);
 }
@@ -1,35 +1,427 @@
 #pragma once
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <vector>
 #include <QString>
 
-class Money {
+class QLocale;
+
+struct MoneyFormat {
+    char16_t decimalSeparator = u'.';
+    char16_t groupSeparator = 0;
+    const char16_t* suffix = u" ₴";
+
+    static MoneyFormat fromLocale(const QLocale& locale);
+};
+
+enum class RoundingMode {
+    HalfUp,
+    HalfEven,
+    TowardZero,
+    AwayFromZero
+};
+
+enum class ParseStatus {
+    Ok,
+    Empty,
+    Invalid,
+    Overflow
+};
+
+// Currency tags. Amounts of different currencies are distinct types; the tag
+// only supplies the default display suffix (all currencies use two minor digits).
+struct Hryvnia {
+    static constexpr const char16_t* suffix = u" ₴";
+};
+
+// Overflow policies. Each receives the two's-complement wrapped result and the
+// sign the exact result would have had.
+struct WrapOverflow {
+    static constexpr int64_t overflow(int64_t wrapped, bool) { return wrapped; }
+};
+
+struct SaturateOverflow {
+    static constexpr int64_t overflow(int64_t, bool positive) {
+        return positive ? std::numeric_limits<int64_t>::max() : std::numeric_limits<int64_t>::min();
+    }
+};
+
+// Aborts at runtime; in a constant expression the overflow is a compile error.
+struct TrapOverflow {
+    static int64_t overflow(int64_t, bool) { std::abort(); }
+};
+
+namespace MoneyDetail {
+
+constexpr int64_t wrap(uint64_t value) {
+    return static_cast<int64_t>(value);
+}
+
+template <typename Policy>
+constexpr int64_t add(int64_t a, int64_t b) {
+    const int64_t result = wrap(static_cast<uint64_t>(a) + static_cast<uint64_t>(b));
+    // Overflow iff both operands share a sign the result does not.
+    if ((a < 0) == (b < 0) && (result < 0) != (a < 0)) return Policy::overflow(result, a >= 0);
+    return result;
+}
+
+template <typename Policy>
+constexpr int64_t subtract(int64_t a, int64_t b) {
+    const int64_t result = wrap(static_cast<uint64_t>(a) - static_cast<uint64_t>(b));
+    if ((a < 0) != (b < 0) && (result < 0) != (a < 0)) return Policy::overflow(result, a >= 0);
+    return result;
+}
+
+template <typename Policy>
+constexpr int64_t multiply(int64_t a, int64_t b) {
+    const int64_t result = wrap(static_cast<uint64_t>(a) * static_cast<uint64_t>(b));
+    const bool overflow = (b == -1 && a == std::numeric_limits<int64_t>::min())
+        || (b != 0 && b != -1 && result / b != a);
+    if (overflow) return Policy::overflow(result, (a < 0) == (b < 0));
+    return result;
+}
+
+// Rounds a non-negative quotient up by one with mode, given the remainder of
+// a division by denominator; ties are judged on the magnitude, as in
+// parseDecimal.
+constexpr bool roundsAway(bool odd, uint64_t remainder, uint64_t denominator, RoundingMode mode) {
+    const uint64_t twice = 2 * remainder;
+    switch (mode) {
+    case RoundingMode::HalfUp: return twice >= denominator;
+    case RoundingMode::HalfEven: return twice > denominator || (twice == denominator && odd);
+    case RoundingMode::TowardZero: return false;
+    case RoundingMode::AwayFromZero: return remainder != 0;
+    }
+    return false;
+}
+
+// a * b / denominator rounded once with mode, on a 128-bit product built from
+// two 64-bit words. This is the path on compilers without a 128-bit integer
+// (MSVC), and stays constexpr there. denominator must be positive.
+template <typename Policy>
+constexpr int64_t mulDivWide(int64_t a, int64_t b, int64_t denominator, RoundingMode mode) {
+    const bool negative = (a < 0) != (b < 0);
+    const uint64_t x = a < 0 ? 0 - static_cast<uint64_t>(a) : static_cast<uint64_t>(a);
+    const uint64_t y = b < 0 ? 0 - static_cast<uint64_t>(b) : static_cast<uint64_t>(b);
+
+    // Schoolbook product of 32-bit halves.
+    const uint64_t xl = x & 0xFFFFFFFFu, xh = x >> 32;
+    const uint64_t yl = y & 0xFFFFFFFFu, yh = y >> 32;
+    const uint64_t ll = xl * yl, lh = xl * yh, hl = xh * yl, hh = xh * yh;
+    const uint64_t middle = (ll >> 32) + (lh & 0xFFFFFFFFu) + (hl & 0xFFFFFFFFu);
+    const uint64_t low = (middle << 32) | (ll & 0xFFFFFFFFu);
+    const uint64_t high = hh + (lh >> 32) + (hl >> 32) + (middle >> 32);
+
+    // The high word divides directly; the remainder and the low word are
+    // divided bit by bit, the remainder staying below denominator < 2^63.
+    const uint64_t d = static_cast<uint64_t>(denominator);
+    uint64_t quotientHigh = high / d;
+    uint64_t remainder = high % d;
+    uint64_t quotient = 0;
+    for (int bit = 63; bit >= 0; --bit) {
+        remainder = (remainder << 1) | ((low >> bit) & 1u);
+        quotient <<= 1;
+        if (remainder >= d) {
+            remainder -= d;
+            quotient |= 1u;
+        }
+    }
+
+    if (roundsAway((quotient & 1u) != 0, remainder, d, mode) && ++quotient == 0) ++quotientHigh;
+
+    const uint64_t limit = static_cast<uint64_t>(std::numeric_limits<int64_t>::max()) + (negative ? 1u : 0u);
+    const uint64_t magnitude = negative ? 0 - quotient : quotient;
+    if (quotientHigh != 0 || quotient > limit) return Policy::overflow(wrap(magnitude), !negative);
+    return wrap(magnitude);
+}
+
+#if defined(__SIZEOF_INT128__)
+__extension__ typedef __int128 Int128;
+
+template <typename Policy>
+constexpr int64_t mulDiv(int64_t a, int64_t b, int64_t denominator, RoundingMode mode) {
+    const Int128 numerator = static_cast<Int128>(a) * b;
+    Int128 quotient = numerator / denominator;
+    const Int128 remainder = numerator % denominator;
+    const auto magnitude = static_cast<uint64_t>(remainder < 0 ? -remainder : remainder);
+    if (roundsAway((quotient % 2) != 0, magnitude, static_cast<uint64_t>(denominator), mode)) {
+        quotient += numerator < 0 ? -1 : 1;
+    }
+
+    if (quotient > std::numeric_limits<int64_t>::max() || quotient < std::numeric_limits<int64_t>::min()) {
+        return Policy::overflow(wrap(static_cast<uint64_t>(quotient)), quotient > 0);
+    }
+    return static_cast<int64_t>(quotient);
+}
+#else
+template <typename Policy>
+constexpr int64_t mulDiv(int64_t a, int64_t b, int64_t denominator, RoundingMode mode) {
+    return mulDivWide<Policy>(a, b, denominator, mode);
+}
+#endif
+
+template <typename Char>
+constexpr bool isSpace(Char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Exact decimal to minor units; constexpr so the _UAH literal can use it.
+// Accepts an optional sign, '.' or ',' as the decimal separator, any number of
+// fractional digits and, when allowDigitSeparators is set, C++14 ' separators.
+template <typename Char>
+constexpr ParseStatus parseDecimal(const Char* p, const Char* end, int64_t& out, RoundingMode mode,
+                                   bool allowDigitSeparators = false) {
+    while (p != end && isSpace(*p)) ++p;
+    while (p != end && isSpace(*(end - 1))) --end;
+    if (p == end) return ParseStatus::Empty;
+
+    bool negative = false;
+    if (*p == '-' || *p == '+') {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    // The magnitude limit for a negative value is one larger than INT64_MAX.
+    const uint64_t limit = static_cast<uint64_t>(std::numeric_limits<int64_t>::max()) + (negative ? 1u : 0u);
+    uint64_t magnitude = 0;
+    bool overflow = false;
+    int digits = 0;
+
+    auto push = [&](unsigned digit) {
+        if (magnitude > (limit - digit) / 10) overflow = true;
+        else magnitude = magnitude * 10 + digit;
+    };
+    auto skipSeparator = [&]() {
+        if (allowDigitSeparators && p != end && *p == '\'') ++p;
+    };
+
+    for (; p != end && *p >= '0' && *p <= '9'; skipSeparator()) {
+        push(static_cast<unsigned>(*p - '0'));
+        ++digits;
+        ++p;
+    }
+
+    int fractionDigits = 0;
+    unsigned firstDropped = 0;
+    bool sticky = false;
+    if (p != end && (*p == '.' || *p == ',')) {
+        ++p;
+        for (; p != end && *p >= '0' && *p <= '9'; skipSeparator()) {
+            const unsigned digit = static_cast<unsigned>(*p - '0');
+            if (fractionDigits < 2) push(digit);
+            else if (fractionDigits == 2) firstDropped = digit;
+            else if (digit != 0) sticky = true;
+            ++fractionDigits;
+            ++digits;
+            ++p;
+        }
+    }
+
+    if (p != end || digits == 0) return ParseStatus::Invalid;
+
+    for (; fractionDigits < 2; ++fractionDigits) push(0);
+
+    bool roundUp = false;
+    switch (mode) {
+    case RoundingMode::HalfUp:
+        roundUp = firstDropped >= 5;
+        break;
+    case RoundingMode::HalfEven:
+        roundUp = firstDropped > 5 || (firstDropped == 5 && (sticky || (magnitude & 1u)));
+        break;
+    case RoundingMode::TowardZero:
+        break;
+    case RoundingMode::AwayFromZero:
+        roundUp = firstDropped != 0 || sticky;
+        break;
+    }
+    if (roundUp) {
+        if (magnitude < limit) ++magnitude;
+        else overflow = true;
+    }
+
+    if (overflow) return ParseStatus::Overflow;
+
+    out = negative ? wrap(0 - magnitude) : wrap(magnitude);
+    return ParseStatus::Ok;
+}
+
+// Non-template formatting shared by every BasicMoney instantiation (money.cpp).
+int format(int64_t amount, char16_t* buffer, int capacity, const MoneyFormat& fmt);
+QString toString(int64_t amount, const MoneyFormat& fmt);
+
+}
+
+// Amount in minor units (kopecks for Hryvnia). Everything except formatting is
+// constexpr and inline; Policy decides what +, - and * do on int64 overflow.
+template <typename Currency, typename Policy = WrapOverflow>
+class BasicMoney {
 private:
     int64_t m_amount;
 
 public:
-    explicit Money(int64_t amountInKopecks = 0);
+    static constexpr int MaxFormattedLength = 64;
+
+    constexpr explicit BasicMoney(int64_t amountInKopecks = 0)
+        : m_amount(amountInKopecks) {}
+
+    // Switches overflow policy within the same currency.
+    template <typename OtherPolicy>
+    constexpr explicit BasicMoney(const BasicMoney<Currency, OtherPolicy>& other)
+        : m_amount(other.amount()) {}
+
+    [[nodiscard]] constexpr int64_t amount() const { return m_amount; }
 
-    [[nodiscard]] int64_t amount() const;
+    constexpr BasicMoney operator+(const BasicMoney& other) const {
+        return BasicMoney(MoneyDetail::add<Policy>(m_amount, other.m_amount));
+    }
+    constexpr BasicMoney operator-(const BasicMoney& other) const {
+        return BasicMoney(MoneyDetail::subtract<Policy>(m_amount, other.m_amount));
+    }
+    constexpr BasicMoney operator*(int multiplier) const {
+        return BasicMoney(MoneyDetail::multiply<Policy>(m_amount, multiplier));
+    }
+    // amount * numerator / denominator through a 128-bit intermediate, rounded
+    // once with mode; prices per kilogram times grams use denominator 1000.
+    constexpr BasicMoney mulDiv(int64_t numerator, int64_t denominator,
+                                RoundingMode mode = RoundingMode::HalfUp) const {
+        return BasicMoney(MoneyDetail::mulDiv<Policy>(m_amount, numerator, denominator, mode));
+    }
+    BasicMoney operator*(double multiplier) const {
+        return BasicMoney(static_cast<int64_t>(std::round(m_amount * multiplier)));
+    }
+    constexpr BasicMoney& operator+=(const BasicMoney& other) {
+        m_amount = MoneyDetail::add<Policy>(m_amount, other.m_amount);
+        return *this;
+    }
+    constexpr BasicMoney& operator-=(const BasicMoney& other) {
+        m_amount = MoneyDetail::subtract<Policy>(m_amount, other.m_amount);
+        return *this;
+    }
 
-    Money operator+(const Money& other) const;
-    Money operator-(const Money& other) const;
-    Money operator*(int multiplier) const;
-    Money operator*(double multiplier) const;
-    Money& operator+=(const Money& other);
-    Money& operator-=(const Money& other);
+    constexpr bool operator==(const BasicMoney& other) const { return m_amount == other.m_amount; }
+    constexpr bool operator!=(const BasicMoney& other) const { return m_amount != other.m_amount; }
+    constexpr bool operator<(const BasicMoney& other) const { return m_amount < other.m_amount; }
+    constexpr bool operator<=(const BasicMoney& other) const { return m_amount <= other.m_amount; }
+    constexpr bool operator>(const BasicMoney& other) const { return m_amount > other.m_amount; }
+    constexpr bool operator>=(const BasicMoney& other) const { return m_amount >= other.m_amount; }
 
-    bool operator==(const Money& other) const;
-    bool operator!=(const Money& other) const;
-    bool operator<(const Money& other) const;
-    bool operator<=(const Money& other) const;
-    bool operator>(const Money& other) const;
-    bool operator>=(const Money& other) const;
+    static MoneyFormat defaultFormat() {
+        MoneyFormat fmt;
+        fmt.suffix = Currency::suffix;
+        return fmt;
+    }
 
-    [[nodiscard]] QString toString() const;
-    static Money fromString(const QString& str);
+    // Writes the amount into buffer without heap allocation and returns the
+    // number of UTF-16 units written, or 0 if capacity is too small.
+    int format(char16_t* buffer, int capacity, const MoneyFormat& fmt = defaultFormat()) const {
+        return MoneyDetail::format(m_amount, buffer, capacity, fmt);
+    }
+
+    [[nodiscard]] QString toString() const { return MoneyDetail::toString(m_amount, defaultFormat()); }
+    [[nodiscard]] QString toString(const MoneyFormat& fmt) const { return MoneyDetail::toString(m_amount, fmt); }
+
+    static BasicMoney fromString(const QString& str) {
+        BasicMoney result(0);
+        // QString::utf16() is const ushort* in Qt 6; the view gives char16_t.
+        const char16_t* begin = QStringView(str).utf16();
+        parse(begin, begin + str.size(), result);
+        return result;
+    }
+
+    // Exact decimal parsing: accepts an optional sign, '.' or ',' as the
+    // decimal separator and any number of fractional digits, which are rounded
+    // to kopecks with the given mode. out is left untouched on failure.
+    static constexpr ParseStatus parse(const char16_t* begin, const char16_t* end, BasicMoney& out,
+                                       RoundingMode mode = RoundingMode::HalfUp) {
+        int64_t kopecks = 0;
+        const ParseStatus status = MoneyDetail::parseDecimal(begin, end, kopecks, mode);
+        if (status == ParseStatus::Ok) out = BasicMoney(kopecks);
+        return status;
+    }
+    static constexpr ParseStatus parse(const char* begin, const char* end, BasicMoney& out,
+                                       RoundingMode mode = RoundingMode::HalfUp) {
+        int64_t kopecks = 0;
+        const ParseStatus status = MoneyDetail::parseDecimal(begin, end, kopecks, mode);
+        if (status == ParseStatus::Ok) out = BasicMoney(kopecks);
+        return status;
+    }
+
+    // Parses a newline-separated UTF-8 column (e.g. a mapped price list) and
+    // appends one value per line to out. Lines that fail to parse are stored
+    // as zero and their indices appended to failedLines if provided.
+    static size_t parseColumn(const char* data, size_t size, std::vector<BasicMoney>& out,
+                              RoundingMode mode = RoundingMode::HalfUp,
+                              std::vector<size_t>* failedLines = nullptr) {
+        const char* p = data;
+        const char* const end = data + size;
+
+        size_t lines = 0;
+        for (const char* q = p; q != end; ++lines) {
+            const void* nl = std::memchr(q, '\n', static_cast<size_t>(end - q));
+            q = nl ? static_cast<const char*>(nl) + 1 : end;
+        }
+        out.reserve(out.size() + lines);
+
+        size_t parsed = 0;
+        for (size_t line = 0; p != end; ++line) {
+            const void* nl = std::memchr(p, '\n', static_cast<size_t>(end - p));
+            const char* lineEnd = nl ? static_cast<const char*>(nl) : end;
+
+            int64_t kopecks = 0;
+            if (MoneyDetail::parseDecimal(p, lineEnd, kopecks, mode) == ParseStatus::Ok) {
+                ++parsed;
+            } else {
+                kopecks = 0;
+                if (failedLines) failedLines->push_back(line);
+            }
+            out.emplace_back(kopecks);
+
+            p = nl ? lineEnd + 1 : end;
+        }
+        return parsed;
+    }
 };
 
-Money operator"" _UAH(long double amount);
-Money operator"" _UAH(unsigned long long amountInKopecks);
-Money operator*(int multiplier, const Money& money);
-Money operator*(double multiplier, const Money& money);
+template <typename Currency, typename Policy>
+constexpr BasicMoney<Currency, Policy> operator*(int multiplier, const BasicMoney<Currency, Policy>& money) {
+    return money * multiplier;
+}
+
+template <typename Currency, typename Policy>
+BasicMoney<Currency, Policy> operator*(double multiplier, const BasicMoney<Currency, Policy>& money) {
+    return money * multiplier;
+}
+
+using Money = BasicMoney<Hryvnia>;
+using SaturatingMoney = BasicMoney<Hryvnia, SaturateOverflow>;
+using CheckedMoney = BasicMoney<Hryvnia, TrapOverflow>;
+
+namespace MoneyDetail {
+
+template <char... Chars>
+constexpr int64_t literalKopecks() {
+    constexpr char text[] = { Chars... };
+    int64_t kopecks = 0;
+    const ParseStatus status = parseDecimal(text, text + sizeof...(Chars), kopecks, RoundingMode::HalfUp, true);
+    // Not a constant expression, so a malformed or overflowing literal fails to compile.
+    if (status != ParseStatus::Ok) std::abort();
+    return kopecks;
+}
+
+}
+
+// 65.50_UAH is exact and folded at compile time; 6550_UAH is in kopecks.
+template <char... Chars>
+constexpr Money operator"" _UAH() {
+    constexpr int64_t kopecks = MoneyDetail::literalKopecks<Chars...>();
+    return Money(kopecks);
+}
+
+constexpr Money operator"" _UAH(unsigned long long amountInKopecks) {
+    return Money(static_cast<int64_t>(amountInKopecks));
+}
@@ -14,3 +14,9 @@ if(QT_VERSION VERSION_LESS 6.0)
         endif()
     endmacro()
 endif()
+
+if(QT_VERSION VERSION_LESS 6.2)
+    macro(qt_add_library)
+        add_library(${ARGV})
+    endmacro()
+endif()